@@ -1 +1 @@
-scp storageVersion.txt  build/storage.bin root@85.215.168.155:~/firmware/OTA/
+scp manifest.txt storageVersion.txt  build/storage.bin root@85.215.168.155:~/firmware/OTA/
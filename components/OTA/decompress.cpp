@@ -0,0 +1,156 @@
+/*
+ * decompress.cpp
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: dig
+ *
+ *  streaming decompression between the download and the flash writer
+ *  decoded data is collected in the history window and passed to dec->write each time the window fills
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_log.h"
+
+#include "decompress.h"
+
+static const char *TAG = "decompress";
+
+typedef enum { HS_TAG, HS_LITERAL, HS_INDEX, HS_COUNT } hsState_t;
+
+static esp_err_t flushWindow(decompress_t *dec) {
+	esp_err_t err = ESP_OK;
+	if (dec->head > 0)
+		err = dec->write(dec->writeCtx, dec->window, dec->head);
+	dec->head = 0;
+	return err;
+}
+
+static esp_err_t putByte(decompress_t *dec, uint8_t c) {
+	dec->window[dec->head++] = c;
+	dec->produced++;
+	if (dec->head == dec->windowSize)
+		return flushWindow(dec);
+	return ESP_OK;
+}
+
+// takes nrBits from the accumulator, MSB first
+static uint32_t getBits(decompress_t *dec, int nrBits) {
+	dec->nrBits -= nrBits;
+	return (dec->bits >> dec->nrBits) & ((1 << nrBits) - 1);
+}
+
+static esp_err_t hsBegin(decompress_t *dec) {
+	dec->windowSize = 1 << CONFIG_OTA_HEATSHRINK_WINDOW_BITS;
+	dec->window = (uint8_t *)calloc(1, dec->windowSize); // heatshrink starts with a zeroed history
+	if (dec->window == NULL) {
+		ESP_LOGE(TAG, "No memory for window");
+		return ESP_ERR_NO_MEM;
+	}
+	dec->state = HS_TAG;
+	return ESP_OK;
+}
+
+static esp_err_t hsWrite(decompress_t *dec, const uint8_t *data, int len) {
+	esp_err_t err = ESP_OK;
+
+	for (int n = 0; (n < len) && (err == ESP_OK); n++) {
+		dec->bits = (dec->bits << 8) | data[n];
+		dec->nrBits += 8;
+		bool more = true;
+		while (more && (err == ESP_OK)) {
+			switch (dec->state) {
+			case HS_TAG:
+				if ((more = (dec->nrBits >= 1)))
+					dec->state = getBits(dec, 1) ? HS_LITERAL : HS_INDEX;
+				break;
+
+			case HS_LITERAL:
+				if ((more = (dec->nrBits >= 8))) {
+					err = putByte(dec, (uint8_t)getBits(dec, 8));
+					dec->state = HS_TAG;
+				}
+				break;
+
+			case HS_INDEX:
+				if ((more = (dec->nrBits >= CONFIG_OTA_HEATSHRINK_WINDOW_BITS))) {
+					dec->index = getBits(dec, CONFIG_OTA_HEATSHRINK_WINDOW_BITS) + 1;
+					dec->state = HS_COUNT;
+				}
+				break;
+
+			case HS_COUNT:
+				if ((more = (dec->nrBits >= CONFIG_OTA_HEATSHRINK_LOOKAHEAD_BITS))) {
+					uint32_t count = getBits(dec, CONFIG_OTA_HEATSHRINK_LOOKAHEAD_BITS) + 1;
+					while (count-- && (err == ESP_OK))
+						err = putByte(dec, dec->window[(dec->head - dec->index) & (dec->windowSize - 1)]);
+					dec->state = HS_TAG;
+				}
+				break;
+			}
+		}
+	}
+	return err;
+}
+
+// the bits left are padding of the last byte
+static esp_err_t hsEnd(decompress_t *dec) {
+	if ((dec->nrBits >= 8) || ((dec->state != HS_TAG) && (dec->state != HS_INDEX))) {
+		ESP_LOGE(TAG, "Compressed data truncated");
+		return ESP_ERR_INVALID_SIZE;
+	}
+	return ESP_OK;
+}
+
+static const decoder_t decoders[] = {
+	{".hs", hsBegin, hsWrite, hsEnd},
+};
+
+#define NUM_DECODERS (sizeof(decoders) / sizeof(decoders[0]))
+
+// returns the decoder for fileName, NULL if the file is not compressed
+const decoder_t *decompressFind(const char *fileName) {
+	int nameLen = strlen(fileName);
+	for (int n = 0; n < NUM_DECODERS; n++) {
+		int extLen = strlen(decoders[n].extension);
+		if ((nameLen > extLen) && (strcmp(fileName + nameLen - extLen, decoders[n].extension) == 0))
+			return &decoders[n];
+	}
+	return NULL;
+}
+
+// returns the compression extension of fileName, or an empty string
+const char *decompressExtension(const char *fileName) {
+	const decoder_t *decoder = decompressFind(fileName);
+	return decoder ? decoder->extension : "";
+}
+
+esp_err_t decompressBegin(decompress_t *dec, const decoder_t *decoder, updateWriteFunc_t write, void *writeCtx) {
+	memset(dec, 0, sizeof(decompress_t));
+	dec->decoder = decoder;
+	dec->write = write;
+	dec->writeCtx = writeCtx;
+	return decoder->begin(dec);
+}
+
+esp_err_t decompressWrite(void *ctx, const uint8_t *data, int len) {
+	decompress_t *dec = (decompress_t *)ctx;
+	return dec->decoder->write(dec, data, len);
+}
+
+// checks the stream is complete, passes the last data on and frees the decoder
+esp_err_t decompressEnd(decompress_t *dec) {
+	esp_err_t err = dec->decoder->end(dec);
+	if (err == ESP_OK)
+		err = flushWindow(dec);
+	if (err == ESP_OK)
+		ESP_LOGI(TAG, "Decompressed %d bytes", (int)dec->produced);
+	decompressAbort(dec);
+	return err;
+}
+
+void decompressAbort(decompress_t *dec) {
+	free(dec->window);
+	dec->window = NULL;
+}
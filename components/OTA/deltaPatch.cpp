@@ -0,0 +1,287 @@
+/*
+ * deltaPatch.cpp
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: dig
+ *
+ *  rebuilds the new firmware image from a patch and the image in the running partition
+ *  data is fed in blocks as it comes from the server, the result is passed to patch->write
+ */
+
+#include <inttypes.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "mbedtls/sha256.h"
+
+#include "deltaPatch.h"
+
+static const char *TAG = "deltaPatch";
+
+typedef enum {
+	ST_MAGIC,
+	ST_VERSION,
+	ST_SRCSIZE,
+	ST_TGTSIZE,
+	ST_SRCHASH,
+	ST_OP,
+	ST_DIFF_OFFSET,
+	ST_DIFF_LEN,
+	ST_DIFF_EQUAL,
+	ST_DIFF_CHANGED,
+	ST_DIFF_DATA,
+	ST_ADD_LEN,
+	ST_ADD_DATA,
+	ST_DONE
+} deltaState_t;
+
+static esp_err_t flushOut(deltaPatch_t *patch) {
+	esp_err_t err = ESP_OK;
+	if (patch->outLen > 0) {
+		err = patch->write(patch->writeCtx, patch->outBuf, patch->outLen);
+		patch->outLen = 0;
+	}
+	return err;
+}
+
+static esp_err_t putOut(deltaPatch_t *patch, uint8_t c) {
+	patch->outBuf[patch->outLen++] = c;
+	patch->produced++;
+	if (patch->outLen == DELTA_OUTBUFSIZE)
+		return flushOut(patch);
+	return ESP_OK;
+}
+
+static esp_err_t getSource(deltaPatch_t *patch, uint32_t offset, uint8_t *c) {
+	if ((offset < patch->srcBufOffset) || (offset >= patch->srcBufOffset + patch->srcBufLen)) {
+		patch->srcBufOffset = offset;
+		patch->srcBufLen = patch->sourceSize - offset;
+		if (patch->srcBufLen > DELTA_SRCBUFSIZE)
+			patch->srcBufLen = DELTA_SRCBUFSIZE;
+		esp_err_t err = esp_partition_read(patch->source, offset, patch->srcBuf, patch->srcBufLen);
+		if (err != ESP_OK) {
+			patch->srcBufLen = 0;
+			ESP_LOGE(TAG, "Reading source failed (%s)", esp_err_to_name(err));
+			return err;
+		}
+	}
+	*c = patch->srcBuf[offset - patch->srcBufOffset];
+	return ESP_OK;
+}
+
+// check the running partition holds the image the patch was made from
+static esp_err_t checkSource(deltaPatch_t *patch) {
+	mbedtls_sha256_context ctx;
+	uint8_t hash[32];
+	esp_err_t err = ESP_OK;
+
+	if (patch->sourceSize > patch->source->size) {
+		ESP_LOGE(TAG, "Patch source size %" PRIu32 " larger than partition", patch->sourceSize);
+		return ESP_ERR_INVALID_SIZE;
+	}
+	mbedtls_sha256_init(&ctx);
+	mbedtls_sha256_starts(&ctx, 0);
+	for (uint32_t offset = 0; (offset < patch->sourceSize) && (err == ESP_OK); offset += DELTA_SRCBUFSIZE) {
+		uint32_t len = patch->sourceSize - offset;
+		if (len > DELTA_SRCBUFSIZE)
+			len = DELTA_SRCBUFSIZE;
+		err = esp_partition_read(patch->source, offset, patch->srcBuf, len);
+		if (err == ESP_OK)
+			mbedtls_sha256_update(&ctx, patch->srcBuf, len);
+	}
+	mbedtls_sha256_finish(&ctx, hash);
+	mbedtls_sha256_free(&ctx);
+	patch->srcBufLen = 0; // srcBuf used as scratch
+
+	if (err != ESP_OK)
+		ESP_LOGE(TAG, "Reading source failed (%s)", esp_err_to_name(err));
+	else if (memcmp(hash, patch->sourceHash, sizeof(hash)) != 0) {
+		ESP_LOGE(TAG, "Patch does not match running firmware");
+		err = ESP_ERR_INVALID_VERSION;
+	}
+	return err;
+}
+
+// collects an unsigned LEB128 number, returns true when complete
+static bool getVarint(deltaPatch_t *patch, uint8_t c, esp_err_t *err) {
+	if (patch->shift > 28) {
+		ESP_LOGE(TAG, "Invalid number in patch");
+		*err = ESP_ERR_INVALID_RESPONSE;
+		return false;
+	}
+	patch->value |= (uint32_t)(c & 0x7F) << patch->shift;
+	patch->shift += 7;
+	return (c & 0x80) == 0;
+}
+
+static uint32_t takeVarint(deltaPatch_t *patch) {
+	uint32_t value = patch->value;
+	patch->value = 0;
+	patch->shift = 0;
+	return value;
+}
+
+// next op, or done when the whole target is produced
+static int nextOp(deltaPatch_t *patch) {
+	return (patch->produced == patch->targetSize) ? ST_DONE : ST_OP;
+}
+
+esp_err_t deltaPatchBegin(deltaPatch_t *patch, const esp_partition_t *source, updateWriteFunc_t write, void *writeCtx) {
+	memset(patch, 0, sizeof(deltaPatch_t));
+	patch->source = source;
+	patch->write = write;
+	patch->writeCtx = writeCtx;
+	patch->state = ST_MAGIC;
+	return ESP_OK;
+}
+
+esp_err_t deltaPatchWrite(deltaPatch_t *patch, const uint8_t *data, int len) {
+	esp_err_t err = ESP_OK;
+	uint8_t src;
+
+	for (int n = 0; (n < len) && (err == ESP_OK); n++) {
+		uint8_t c = data[n];
+		switch (patch->state) {
+		case ST_MAGIC:
+			if (c != DELTA_MAGIC[patch->hdrIdx++]) {
+				ESP_LOGE(TAG, "Not a delta patch");
+				err = ESP_ERR_INVALID_RESPONSE;
+			} else if (patch->hdrIdx == strlen(DELTA_MAGIC))
+				patch->state = ST_VERSION;
+			break;
+
+		case ST_VERSION:
+			if (c != DELTA_VERSION) {
+				ESP_LOGE(TAG, "Unsupported patch version %d", c);
+				err = ESP_ERR_INVALID_VERSION;
+			} else
+				patch->state = ST_SRCSIZE;
+			break;
+
+		case ST_SRCSIZE:
+			if (getVarint(patch, c, &err)) {
+				patch->sourceSize = takeVarint(patch);
+				patch->state = ST_TGTSIZE;
+			}
+			break;
+
+		case ST_TGTSIZE:
+			if (getVarint(patch, c, &err)) {
+				patch->targetSize = takeVarint(patch);
+				patch->hdrIdx = 0;
+				patch->state = ST_SRCHASH;
+			}
+			break;
+
+		case ST_SRCHASH:
+			patch->sourceHash[patch->hdrIdx++] = c;
+			if (patch->hdrIdx == sizeof(patch->sourceHash)) {
+				ESP_LOGI(TAG, "Patch %" PRIu32 " -> %" PRIu32 " bytes", patch->sourceSize, patch->targetSize);
+				err = checkSource(patch);
+				patch->state = nextOp(patch);
+			}
+			break;
+
+		case ST_OP:
+			if (c == DELTA_OP_DIFF)
+				patch->state = ST_DIFF_OFFSET;
+			else if (c == DELTA_OP_ADD)
+				patch->state = ST_ADD_LEN;
+			else {
+				ESP_LOGE(TAG, "Invalid op %d", c);
+				err = ESP_ERR_INVALID_RESPONSE;
+			}
+			break;
+
+		case ST_DIFF_OFFSET:
+			if (getVarint(patch, c, &err)) {
+				patch->srcOffset = takeVarint(patch);
+				patch->state = ST_DIFF_LEN;
+			}
+			break;
+
+		case ST_DIFF_LEN:
+			if (getVarint(patch, c, &err)) {
+				patch->remaining = takeVarint(patch);
+				if ((patch->srcOffset > patch->sourceSize) || (patch->remaining > patch->sourceSize - patch->srcOffset) ||
+					(patch->remaining > patch->targetSize - patch->produced)) {
+					ESP_LOGE(TAG, "Diff out of range");
+					err = ESP_ERR_INVALID_SIZE;
+				} else
+					patch->state = (patch->remaining > 0) ? ST_DIFF_EQUAL : nextOp(patch);
+			}
+			break;
+
+		case ST_DIFF_EQUAL:
+			if (getVarint(patch, c, &err)) {
+				uint32_t equal = takeVarint(patch);
+				if (equal > patch->remaining) {
+					ESP_LOGE(TAG, "Diff run out of range");
+					err = ESP_ERR_INVALID_SIZE;
+					break;
+				}
+				patch->remaining -= equal;
+				while (equal-- && (err == ESP_OK)) {
+					err = getSource(patch, patch->srcOffset++, &src);
+					if (err == ESP_OK)
+						err = putOut(patch, src);
+				}
+				patch->state = (patch->remaining > 0) ? ST_DIFF_CHANGED : nextOp(patch);
+			}
+			break;
+
+		case ST_DIFF_CHANGED:
+			if (getVarint(patch, c, &err)) {
+				patch->runLen = takeVarint(patch);
+				if ((patch->runLen == 0) || (patch->runLen > patch->remaining)) {
+					ESP_LOGE(TAG, "Diff run out of range");
+					err = ESP_ERR_INVALID_SIZE;
+				} else {
+					patch->remaining -= patch->runLen;
+					patch->state = ST_DIFF_DATA;
+				}
+			}
+			break;
+
+		case ST_DIFF_DATA:
+			err = getSource(patch, patch->srcOffset++, &src);
+			if (err == ESP_OK)
+				err = putOut(patch, (uint8_t)(src + c));
+			if (--patch->runLen == 0)
+				patch->state = (patch->remaining > 0) ? ST_DIFF_EQUAL : nextOp(patch);
+			break;
+
+		case ST_ADD_LEN:
+			if (getVarint(patch, c, &err)) {
+				patch->runLen = takeVarint(patch);
+				if (patch->runLen > patch->targetSize - patch->produced) {
+					ESP_LOGE(TAG, "Add out of range");
+					err = ESP_ERR_INVALID_SIZE;
+				} else
+					patch->state = (patch->runLen > 0) ? ST_ADD_DATA : nextOp(patch);
+			}
+			break;
+
+		case ST_ADD_DATA:
+			err = putOut(patch, c);
+			if (--patch->runLen == 0)
+				patch->state = nextOp(patch);
+			break;
+
+		case ST_DONE:
+		default:
+			ESP_LOGE(TAG, "Data after end of patch");
+			err = ESP_ERR_INVALID_SIZE;
+			break;
+		}
+	}
+	return err;
+}
+
+esp_err_t deltaPatchEnd(deltaPatch_t *patch) {
+	if (patch->state != ST_DONE) {
+		ESP_LOGE(TAG, "Patch incomplete, %" PRIu32 " of %" PRIu32 " bytes", patch->produced, patch->targetSize);
+		return ESP_ERR_INVALID_SIZE;
+	}
+	return flushOut(patch);
+}
@@ -0,0 +1,99 @@
+/*
+ * eraseAhead.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: dig
+ */
+
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "spi_flash_mmap.h"
+
+#include "eraseAhead.h"
+
+static const char *TAG = "eraseAhead";
+
+#ifndef CONFIG_OTA_ERASE_AHEAD_SECTORS
+#define CONFIG_OTA_ERASE_AHEAD_SECTORS 16
+#endif
+
+#define ERASE_TIMEOUT (5000 / portTICK_PERIOD_MS)
+
+static void eraseAheadTask(void *pvParameter) {
+	eraseAhead_t *erase = (eraseAhead_t *)pvParameter;
+
+	while (!erase->stop && (erase->erasedTo < erase->partition->size) && (erase->err == ESP_OK)) {
+		if (erase->erasedTo >= erase->needed + CONFIG_OTA_ERASE_AHEAD_SECTORS * SPI_FLASH_SEC_SIZE) {
+			xSemaphoreTake(erase->wake, ERASE_TIMEOUT); // far enough ahead
+			continue;
+		}
+		erase->err = esp_partition_erase_range(erase->partition, erase->erasedTo, SPI_FLASH_SEC_SIZE);
+		if (erase->err == ESP_OK)
+			erase->erasedTo += SPI_FLASH_SEC_SIZE;
+		else
+			ESP_LOGE(TAG, "Erase at 0x%x failed (%s)", erase->erasedTo, esp_err_to_name(erase->err));
+		xSemaphoreGive(erase->progress);
+	}
+	erase->running = false;
+	xSemaphoreGive(erase->progress);
+	xSemaphoreGive(erase->done);
+	vTaskDelete(NULL);
+}
+
+// starts erasing partition at from (sector aligned), the part before is kept
+esp_err_t eraseAheadBegin(eraseAhead_t *erase, const esp_partition_t *partition, size_t from) {
+	memset(erase, 0, sizeof(eraseAhead_t));
+	erase->partition = partition;
+	erase->erasedTo = from;
+	erase->needed = from;
+	erase->wake = xSemaphoreCreateBinary();
+	erase->progress = xSemaphoreCreateBinary();
+	erase->done = xSemaphoreCreateBinary();
+	erase->running = true;
+	if (!erase->wake || !erase->progress || !erase->done ||
+		(xTaskCreate(&eraseAheadTask, "eraseAheadTask", 3072, erase, 5, &erase->task) != pdPASS)) {
+		erase->task = NULL;
+		erase->running = false;
+		eraseAheadEnd(erase);
+		return ESP_ERR_NO_MEM;
+	}
+	return ESP_OK;
+}
+
+// returns when the partition is erased up to end
+esp_err_t eraseAheadWait(eraseAhead_t *erase, size_t end) {
+	if (end > erase->needed) {
+		erase->needed = end;
+		xSemaphoreGive(erase->wake);
+	}
+	if (erase->erasedTo >= end)
+		return ESP_OK;
+
+	int64_t startTime = esp_timer_get_time();
+	while ((erase->erasedTo < end) && erase->running)
+		xSemaphoreTake(erase->progress, ERASE_TIMEOUT);
+	erase->stallUs += esp_timer_get_time() - startTime;
+	if (erase->erasedTo >= end)
+		return ESP_OK;
+	return (erase->err != ESP_OK) ? erase->err : ESP_ERR_INVALID_SIZE;
+}
+
+// stops the eraser, waits for the sector it is busy with
+void eraseAheadEnd(eraseAhead_t *erase) {
+	erase->stop = true;
+	if (erase->wake)
+		xSemaphoreGive(erase->wake);
+	if (erase->task)
+		xSemaphoreTake(erase->done, portMAX_DELAY); // last thing the eraser touches
+	erase->task = NULL;
+	if (erase->wake)
+		vSemaphoreDelete(erase->wake);
+	if (erase->progress)
+		vSemaphoreDelete(erase->progress);
+	if (erase->done)
+		vSemaphoreDelete(erase->done);
+	erase->wake = erase->progress = erase->done = NULL;
+	erase->running = false;
+}
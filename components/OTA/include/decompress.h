@@ -0,0 +1,58 @@
+/*
+ * decompress.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: dig
+ *
+ *  streaming decoders for compressed update images
+ *  the decoder is selected by the extension of the downloaded file, eg storage.bin.hs
+ *
+ *  .hs	heatshrink (LZSS) as made by compressImage.py or the heatshrink tool with
+ *  	-w CONFIG_OTA_HEATSHRINK_WINDOW_BITS -l CONFIG_OTA_HEATSHRINK_LOOKAHEAD_BITS
+ *  	RAM used is the window, 1 << CONFIG_OTA_HEATSHRINK_WINDOW_BITS bytes
+ */
+
+#ifndef COMPONENTS_OTA_INCLUDE_DECOMPRESS_H_
+#define COMPONENTS_OTA_INCLUDE_DECOMPRESS_H_
+
+#include "sdkconfig.h"
+#include "updateTask.h"
+
+#ifndef CONFIG_OTA_HEATSHRINK_WINDOW_BITS
+#define CONFIG_OTA_HEATSHRINK_WINDOW_BITS 10
+#endif
+#ifndef CONFIG_OTA_HEATSHRINK_LOOKAHEAD_BITS
+#define CONFIG_OTA_HEATSHRINK_LOOKAHEAD_BITS 5
+#endif
+
+typedef struct decompress_s decompress_t;
+
+typedef struct {
+	const char *extension; // file extension selecting this decoder
+	esp_err_t (*begin)(decompress_t *dec);
+	esp_err_t (*write)(decompress_t *dec, const uint8_t *data, int len);
+	esp_err_t (*end)(decompress_t *dec);
+} decoder_t;
+
+struct decompress_s {
+	const decoder_t *decoder;
+	updateWriteFunc_t write; // receives the decompressed data
+	void *writeCtx;
+	uint8_t *window; // history, also used as output buffer
+	uint32_t windowSize;
+	uint32_t head; // next write position in window
+	int state;
+	uint32_t bits; // bit accumulator
+	int nrBits;
+	uint32_t index; // backreference distance
+	size_t produced;
+};
+
+const decoder_t *decompressFind(const char *fileName);
+const char *decompressExtension(const char *fileName);
+esp_err_t decompressBegin(decompress_t *dec, const decoder_t *decoder, updateWriteFunc_t write, void *writeCtx);
+esp_err_t decompressWrite(void *ctx, const uint8_t *data, int len);
+esp_err_t decompressEnd(decompress_t *dec);
+void decompressAbort(decompress_t *dec);
+
+#endif /* COMPONENTS_OTA_INCLUDE_DECOMPRESS_H_ */
@@ -0,0 +1,56 @@
+/*
+ * deltaPatch.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: dig
+ *
+ *  Streaming applier for firmware delta patches made by makeDelta.py
+ *
+ *  patch format, all numbers unsigned LEB128 varints:
+ *  header:	"DOTA" version(1 byte) sourceSize targetSize sha256(source, 32 bytes)
+ *  ops until targetSize bytes are produced:
+ *  	DELTA_OP_DIFF 	srcOffset len { equal [changed changedbytes] } ,  target = source + changedbyte
+ *  	DELTA_OP_ADD 	len bytes , literal target bytes
+ */
+
+#ifndef COMPONENTS_OTA_INCLUDE_DELTAPATCH_H_
+#define COMPONENTS_OTA_INCLUDE_DELTAPATCH_H_
+
+#include "esp_partition.h"
+#include "updateTask.h"
+
+#define DELTA_MAGIC "DOTA"
+#define DELTA_VERSION 1
+#define DELTA_OP_DIFF 1
+#define DELTA_OP_ADD 2
+
+#define DELTA_SRCBUFSIZE 256
+#define DELTA_OUTBUFSIZE 1024
+
+typedef struct {
+	const esp_partition_t *source; // running partition
+	updateWriteFunc_t write;	   // receives the reconstructed image
+	void *writeCtx;
+	int state;
+	uint32_t value; // varint being read
+	int shift;
+	int hdrIdx;
+	uint32_t sourceSize;
+	uint32_t targetSize;
+	uint32_t produced;
+	uint32_t srcOffset;
+	uint32_t remaining; // bytes left in op
+	uint32_t runLen;	// bytes left in changed run or literal
+	uint8_t sourceHash[32];
+	uint8_t srcBuf[DELTA_SRCBUFSIZE];
+	uint32_t srcBufOffset;
+	uint32_t srcBufLen;
+	uint8_t outBuf[DELTA_OUTBUFSIZE];
+	int outLen;
+} deltaPatch_t;
+
+esp_err_t deltaPatchBegin(deltaPatch_t *patch, const esp_partition_t *source, updateWriteFunc_t write, void *writeCtx);
+esp_err_t deltaPatchWrite(deltaPatch_t *patch, const uint8_t *data, int len);
+esp_err_t deltaPatchEnd(deltaPatch_t *patch);
+
+#endif /* COMPONENTS_OTA_INCLUDE_DELTAPATCH_H_ */
@@ -0,0 +1,37 @@
+/*
+ * eraseAhead.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: dig
+ *
+ *  erases a partition in a task of its own, CONFIG_OTA_ERASE_AHEAD_SECTORS sectors ahead of the writer
+ *  started before the connection is set up, so the writer only waits when the flash can not keep up
+ */
+
+#ifndef COMPONENTS_OTA_INCLUDE_ERASEAHEAD_H_
+#define COMPONENTS_OTA_INCLUDE_ERASEAHEAD_H_
+
+#include "esp_partition.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+typedef struct {
+	const esp_partition_t *partition;
+	volatile size_t erasedTo; // erased up to here
+	volatile size_t needed;	  // writer waits for this
+	volatile bool stop;
+	volatile bool running;
+	volatile esp_err_t err;
+	SemaphoreHandle_t wake;		// writer -> eraser: needed moved
+	SemaphoreHandle_t progress; // eraser -> writer: sector erased or eraser ended
+	SemaphoreHandle_t done;
+	TaskHandle_t task;
+	int64_t stallUs; // time the writer waited
+} eraseAhead_t;
+
+esp_err_t eraseAheadBegin(eraseAhead_t *erase, const esp_partition_t *partition, size_t from);
+esp_err_t eraseAheadWait(eraseAhead_t *erase, size_t end);
+void eraseAheadEnd(eraseAhead_t *erase);
+
+#endif /* COMPONENTS_OTA_INCLUDE_ERASEAHEAD_H_ */
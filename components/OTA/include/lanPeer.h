@@ -0,0 +1,22 @@
+/*
+ * lanPeer.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: dig
+ *
+ *  firmware from a device on the lan that already runs the new version
+ *  each device advertises _ota._tcp via mdns, txt fw=<running version> path=LAN_PEER_FIRMWARE_PATH,
+ *  and serves its running firmware there from the file server
+ *  an image from a peer is only used when the manifest has its sha256
+ */
+
+#ifndef COMPONENTS_OTA_INCLUDE_LANPEER_H_
+#define COMPONENTS_OTA_INCLUDE_LANPEER_H_
+
+#define LAN_PEER_SERVICE "_ota"
+#define LAN_PEER_PROTO "_tcp"
+#define LAN_PEER_FIRMWARE_PATH "/ota/firmware.bin"
+
+bool lanPeerFind(const char *version, char *url, int size);
+
+#endif /* COMPONENTS_OTA_INCLUDE_LANPEER_H_ */
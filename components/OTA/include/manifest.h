@@ -0,0 +1,62 @@
+/*
+ * manifest.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: dig
+ *
+ *  update manifest, one file on the server describing the firmware and the storage image
+ *  lines key=value, made by makeManifest.py:
+ *
+ *  firmware.version=1.1
+ *  firmware.file=ESP32_OTAtemplate.bin		image to download, extension selects decompression
+ *  firmware.size=1234567					size of the image as flashed
+ *  firmware.sha256=<64 hex digits>			hash of the image as flashed
+ *  firmware.signature=<hex>				optional, signature of version, file and sha256 with the update key (makeManifest.py --key)
+ *  firmware.delta=1.0 1.0.1				running versions a delta patch is available for
+ *  firmware.tree=<64 hex digits>			optional, root of the chunk hashes in <file>.tree (merkle.h)
+ *  storage.version=1.2
+ *  storage.file=storage.bin
+ *  storage.size=458752
+ *  storage.sha256=<64 hex digits>
+ *  storage.tree=<64 hex digits>			optional, as firmware.tree
+ *  storage.files=<64 hex digits>			optional, hash of the file list for an update per file (storageFiles.h)
+ */
+
+#ifndef COMPONENTS_OTA_INCLUDE_MANIFEST_H_
+#define COMPONENTS_OTA_INCLUDE_MANIFEST_H_
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "updateSpiffsTask.h"
+
+#define MANIFEST_FILENAME "manifest.txt"
+#define MANIFEST_MAXSIZE 3072
+#define MANIFEST_FILENAME_SZ 48
+#define MANIFEST_DELTA_SZ 64
+#define MANIFEST_SIGNATURE_SZ 512 // RSA 4096
+
+typedef struct {
+	char version[MAX_STORAGEVERSIONSIZE];
+	char fileName[MANIFEST_FILENAME_SZ];
+	uint32_t size; // 0: unknown
+	uint8_t sha256[32];
+	bool hasSha256;
+	uint8_t signature[MANIFEST_SIGNATURE_SZ];
+	int signatureLen; // 0: not signed
+	char deltaFrom[MANIFEST_DELTA_SZ]; // "*": unknown, try a patch
+	uint8_t treeRoot[32];
+	bool hasTree;
+	uint8_t filesHash[32];
+	bool hasFiles;
+} manifestEntry_t;
+
+typedef struct {
+	manifestEntry_t firmware;
+	manifestEntry_t storage;
+} updateManifest_t;
+
+esp_err_t getManifest(updateManifest_t *manifest);
+bool manifestHasDelta(const manifestEntry_t *entry, const char *fromVersion);
+int manifestParseHex(const char *hex, uint8_t *dest, int maxLen);
+
+#endif /* COMPONENTS_OTA_INCLUDE_MANIFEST_H_ */
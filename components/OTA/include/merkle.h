@@ -0,0 +1,44 @@
+/*
+ * merkle.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: dig
+ *
+ *  chunk verification with a hash tree
+ *  the image (as flashed) is split in MERKLE_CHUNKSIZE chunks, leaf i = sha256(chunk i)
+ *  a node = sha256(left | right), an odd node at the end of a level moves up unchanged
+ *  the root is in the manifest (firmware.tree=, storage.tree=), the leaves are in <file>.tree on the server, made by makeManifest.py --tree
+ *
+ *  each chunk is checked before it is passed on to the writer, a bad chunk stops the download at that chunk
+ */
+
+#ifndef COMPONENTS_OTA_INCLUDE_MERKLE_H_
+#define COMPONENTS_OTA_INCLUDE_MERKLE_H_
+
+#include "esp_partition.h"
+#include "manifest.h"
+#include "updateTask.h"
+#include "verify.h"
+
+#define MERKLE_CHUNKSIZE 4096 // one flash sector
+#define MERKLE_TREE_EXT ".tree"
+
+typedef struct {
+	uint8_t *leaves; // nrLeaves hashes
+	int nrLeaves;
+	int chunk;	  // next chunk to check
+	uint8_t *buf; // chunk being received
+	int bufLen;
+	bool failed; // a chunk did not match
+	updateWriteFunc_t write;
+	void *writeCtx;
+} merkle_t;
+
+esp_err_t merkleLoad(merkle_t *merkle, const manifestEntry_t *entry);
+void merkleBegin(merkle_t *merkle, size_t offset, updateWriteFunc_t write, void *writeCtx);
+esp_err_t merkleWrite(void *ctx, const uint8_t *data, int len);
+esp_err_t merkleEnd(merkle_t *merkle);
+size_t merkleCheckFlash(merkle_t *merkle, const esp_partition_t *partition, size_t len, imageVerify_t *verify);
+void merkleFree(merkle_t *merkle);
+
+#endif /* COMPONENTS_OTA_INCLUDE_MERKLE_H_ */
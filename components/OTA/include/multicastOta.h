@@ -0,0 +1,40 @@
+/*
+ * multicastOta.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: dig
+ *
+ *  firmware for a whole fleet in one transfer: a sender (multicastImage.py) sends the image to a udp multicast group
+ *  in numbered blocks, after every group of blocks a repair packet, the xor of these blocks
+ *  each device writes the blocks as they come into the update partition, in any order, and keeps a bitmap of the blocks it has
+ *  one block lost in a group is rebuilt from the repair packet, the sender repeats the image so a device can also wait for the next round
+ *  blocks still missing when the sender stops are fetched from the server with a range request
+ */
+
+#ifndef COMPONENTS_OTA_INCLUDE_MULTICASTOTA_H_
+#define COMPONENTS_OTA_INCLUDE_MULTICASTOTA_H_
+
+#include <stdint.h>
+#include "esp_partition.h"
+#include "manifest.h"
+
+#define MCAST_MAGIC 0x4D41544F // "OTAM"
+#define MCAST_BLOCKSIZE 1024   // data in a packet, fits one ethernet frame
+#define MCAST_ID_SIZE 8		   // first bytes of the sha256 of the image
+
+typedef enum { MCAST_DATA = 0, MCAST_REPAIR = 1 } mcastType_t;
+
+// all fields little endian, followed by MCAST_BLOCKSIZE bytes (the last data block may be shorter)
+typedef struct __attribute__((packed)) {
+	uint32_t magic;
+	uint8_t imageId[MCAST_ID_SIZE];
+	uint32_t imageSize;
+	uint32_t index;	   // block, or group for a repair packet
+	uint8_t type;	   // mcastType_t
+	uint8_t groupSize; // blocks per repair group
+	uint16_t reserved;
+} mcastHeader_t;
+
+esp_err_t multicastReceive(const manifestEntry_t *entry, const esp_partition_t *partition, char *gapURL, size_t *length);
+
+#endif /* COMPONENTS_OTA_INCLUDE_MULTICASTOTA_H_ */
@@ -0,0 +1,46 @@
+/*
+ * otaBenchmark.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: dig
+ *
+ *  dry run of a firmware update: the full download pipeline for the firmware in the manifest,
+ *  the boot partition is never changed
+ *  start: /cgi-bin/otaBenchmark?start (?start&flash also erases and writes the update partition)
+ *         or CONFIG_OTA_BENCHMARK_AT_START
+ *  /cgi-bin/otaBenchmark returns the report of the last run
+ */
+
+#ifndef COMPONENTS_OTA_INCLUDE_OTABENCHMARK_H_
+#define COMPONENTS_OTA_INCLUDE_OTABENCHMARK_H_
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "httpsReadFile.h"
+
+#define OTA_BENCH_BINS 10 // time between blocks < 1, 2, 4 .. 256 ms, >= 256 ms
+
+typedef enum { BENCH_IDLE, BENCH_REQUESTED, BENCH_RUNNING, BENCH_DONE } otaBenchState_t;
+
+typedef struct {
+	volatile otaBenchState_t state;
+	bool flash; // erase and write the update partition
+	esp_err_t result;
+	httpsTiming_t connect; // the connection of the download
+	httpsProbe_t probe;	   // dns and tcp connect probed before
+	int64_t downloadUs; // request until the last block
+	uint32_t bytes;		// received
+	uint32_t blocks;
+	uint32_t histogram[OTA_BENCH_BINS];
+	int64_t flashUs;	  // writing, eraseStallUs included
+	int64_t eraseStallUs; // waiting for the erase ahead
+	int64_t writeStallUs; // download waiting for the writer
+} otaBenchmark_t;
+
+extern otaBenchmark_t otaBenchmark;
+
+bool otaBenchmarkStart(bool flash);
+void otaBenchmarkBlock(otaBenchmark_t *bench, int64_t us);
+int otaBenchmarkReport(char *buf, int size);
+
+#endif /* COMPONENTS_OTA_INCLUDE_OTABENCHMARK_H_ */
@@ -0,0 +1,35 @@
+/*
+ * sectorWriter.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: dig
+ *
+ *  collects image data into whole flash sectors, each sector is written with one aligned write
+ *  without eraseAhead a sector that is already in flash as it should be is neither erased nor written,
+ *  with eraseAhead the sectors are erased by it and only written
+ */
+
+#ifndef COMPONENTS_OTA_INCLUDE_SECTORWRITER_H_
+#define COMPONENTS_OTA_INCLUDE_SECTORWRITER_H_
+
+#include <stdint.h>
+#include "esp_partition.h"
+#include "eraseAhead.h"
+
+typedef struct {
+	const esp_partition_t *partition;
+	size_t offset; // of the sector in buf
+	uint8_t *buf;
+	int bufLen;
+	eraseAhead_t *erase; // NULL: compare, erase changed sectors
+	uint32_t written;	 // sectors
+	uint32_t skipped;	 // sectors unchanged
+} sectorWriter_t;
+
+esp_err_t sectorWriterBegin(sectorWriter_t *writer, const esp_partition_t *partition, size_t offset, eraseAhead_t *erase);
+esp_err_t sectorWriterWrite(void *ctx, const uint8_t *data, int len);
+esp_err_t sectorWriterEnd(sectorWriter_t *writer);
+esp_err_t sectorWriterClearRest(sectorWriter_t *writer);
+void sectorWriterAbort(sectorWriter_t *writer);
+
+#endif /* COMPONENTS_OTA_INCLUDE_SECTORWRITER_H_ */
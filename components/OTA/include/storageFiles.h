@@ -0,0 +1,28 @@
+/*
+ * storageFiles.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: dig
+ *
+ *  storage update per file instead of the whole image
+ *  the manifest has storage.files=<sha256 of STORAGE_FILES_LIST>, made by makeManifest.py --files spiffs_image
+ *  STORAGE_FILES_LIST on the server has a line per file: <sha256> <size> <path>
+ *  the files themselves are on the server in STORAGE_FILES_DIR/<path>
+ *  only new and changed files are downloaded, files in the previous list that are gone are deleted,
+ *  other files on /spiffs (eg uploaded ones) are left alone
+ *  the first time, without a previous list on /spiffs, every file not in the list is deleted
+ */
+
+#ifndef COMPONENTS_OTA_INCLUDE_STORAGEFILES_H_
+#define COMPONENTS_OTA_INCLUDE_STORAGEFILES_H_
+
+#include "esp_err.h"
+#include "manifest.h"
+
+#define STORAGE_FILES_LIST "files.txt"
+#define STORAGE_FILES_DIR "files"
+#define STORAGE_FILES_MAXSIZE 4096 // list, about 50 files
+
+esp_err_t storageFilesUpdate(const manifestEntry_t *entry);
+
+#endif /* COMPONENTS_OTA_INCLUDE_STORAGEFILES_H_ */
@@ -11,6 +11,7 @@
 
 
 void updateFirmwareTask(void *pvParameter);
+void otaBenchmarkTask(void *pvParameter);
 
 
 #endif /* COMPONENTS_OTA_INCLUDE_UPDATEFIRMWARETASK_H_ */
@@ -9,14 +9,19 @@
 #define COMPONENTS_OTA_INCLUDE_UPDATETASK_H_
 
 #include "esp_err.h"
+#include "httpsReadFile.h"
 #define BINARY_INFO_FILENAME "firmWareVersion.txt"
 #define SPIFFS_INFO_FILENAME "storageVersion.txt"
+#define DELTA_FILENAME_FMT "delta_%s_%s.bin" // patch from running version to new version
 
 #define UPDATETIMEOUT (24 * 60 * 60) //seconds 
 
 #define BUFFSIZE 		1024 // buffer size for http
 
-esp_err_t getNewVersion (char * infoFileName , char * newVersion);
+// receives (part of) an image, used to chain the stages of an update
+typedef esp_err_t (*updateWriteFunc_t)(void *ctx, const uint8_t *data, int len);
+
+esp_err_t getNewVersion (char * infoFileName , char * newVersion, httpsValidator_t *validator);
 void updateTask(void *pvParameter);
 
 extern volatile bool getNewVersionTaskFinished;
@@ -0,0 +1,31 @@
+/*
+ * verify.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: dig
+ *
+ *  checks an image against the sha256 of its manifest entry while it is written
+ *  with CONFIG_OTA_SIGNED_MANIFEST version, file name and sha256 must be signed with the update key (server_certs/update_key_pub.pem)
+ */
+
+#ifndef COMPONENTS_OTA_INCLUDE_VERIFY_H_
+#define COMPONENTS_OTA_INCLUDE_VERIFY_H_
+
+#include "esp_partition.h"
+#include "mbedtls/sha256.h"
+#include "manifest.h"
+
+typedef struct {
+	const manifestEntry_t *entry;
+	mbedtls_sha256_context ctx;
+	bool active; // entry has a sha256, ctx in use
+} imageVerify_t;
+
+esp_err_t verifySignature(const manifestEntry_t *entry);
+void verifyBegin(imageVerify_t *verify, const manifestEntry_t *entry);
+esp_err_t verifyResume(imageVerify_t *verify, const esp_partition_t *partition, size_t len);
+void verifyUpdate(imageVerify_t *verify, const uint8_t *data, int len);
+esp_err_t verifyEnd(imageVerify_t *verify);
+void verifyAbort(imageVerify_t *verify);
+
+#endif /* COMPONENTS_OTA_INCLUDE_VERIFY_H_ */
@@ -0,0 +1,42 @@
+/*
+ * writeBehind.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: dig
+ *
+ *  runs the write chain of an update in a task of its own over CONFIG_OTA_WRITE_BEHIND_BLOCKS blocks,
+ *  the download reads into the next block while the previous ones are written
+ *  writeBehindGet a free block, read into it, writeBehindPut it, writeBehindEnd
+ */
+
+#ifndef COMPONENTS_OTA_INCLUDE_WRITEBEHIND_H_
+#define COMPONENTS_OTA_INCLUDE_WRITEBEHIND_H_
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "updateTask.h"
+
+#ifndef CONFIG_OTA_WRITE_BEHIND_BLOCKS
+#define CONFIG_OTA_WRITE_BEHIND_BLOCKS 4
+#endif
+
+typedef struct {
+	updateWriteFunc_t write; // first stage of the chain, runs in the writer task
+	void *writeCtx;
+	uint8_t *blocks;
+	QueueHandle_t free;	  // writer -> reader: blocks to read into
+	QueueHandle_t filled; // reader -> writer: writeBehindBlock_t, data NULL ends the writer
+	SemaphoreHandle_t done;
+	TaskHandle_t task;
+	volatile esp_err_t err; // first error of the chain, later blocks are dropped
+	int64_t stallUs;		// time the reader waited for a free block
+} writeBehind_t;
+
+esp_err_t writeBehindBegin(writeBehind_t *behind, updateWriteFunc_t write, void *writeCtx);
+uint8_t *writeBehindGet(writeBehind_t *behind);
+void writeBehindPut(writeBehind_t *behind, uint8_t *block, int len);
+esp_err_t writeBehindEnd(writeBehind_t *behind);
+
+#endif /* COMPONENTS_OTA_INCLUDE_WRITEBEHIND_H_ */
@@ -0,0 +1,49 @@
+/*
+ * lanPeer.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: dig
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "mdns.h"
+
+#include "lanPeer.h"
+
+static const char *TAG = "lanPeer";
+
+#define QUERY_TIMEOUT 2000 // ms
+#define MAX_PEERS 8
+
+// url of the firmware of a peer running version, false if there is none
+bool lanPeerFind(const char *version, char *url, int size) {
+	mdns_result_t *results = NULL;
+	bool found = false;
+
+	if ((mdns_query_ptr(LAN_PEER_SERVICE, LAN_PEER_PROTO, QUERY_TIMEOUT, MAX_PEERS, &results) != ESP_OK) || (results == NULL))
+		return false;
+	for (mdns_result_t *r = results; r && !found; r = r->next) {
+		const char *fw = NULL;
+		const char *path = LAN_PEER_FIRMWARE_PATH;
+		for (size_t n = 0; n < r->txt_count; n++) {
+			if (strcmp(r->txt[n].key, "fw") == 0)
+				fw = r->txt[n].value;
+			else if ((strcmp(r->txt[n].key, "path") == 0) && r->txt[n].value)
+				path = r->txt[n].value;
+		}
+		if ((fw == NULL) || (strcmp(fw, version) != 0))
+			continue;
+		for (mdns_ip_addr_t *a = r->addr; a && !found; a = a->next) {
+			if (a->addr.type == ESP_IPADDR_TYPE_V4) {
+				snprintf(url, size, "http://" IPSTR ":%u%s", IP2STR(&a->addr.u_addr.ip4), r->port, path);
+				ESP_LOGI(TAG, "%s runs %s", r->hostname ? r->hostname : url, version);
+				found = true;
+			}
+		}
+	}
+	mdns_query_results_free(results);
+	return found;
+}
@@ -0,0 +1,164 @@
+/*
+ * manifest.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: dig
+ *
+ *  reads the update manifest, falls back to the version files when the server has no manifest
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_log.h"
+
+#include "httpsReadFile.h"
+#include "manifest.h"
+#include "updateTask.h"
+#include "wifiConnect.h"
+
+static const char *TAG = "manifest";
+
+static char manifestBuf[MANIFEST_MAXSIZE];
+static httpsValidator_t manifestValidator;
+static httpsValidator_t versionValidators[2]; // firmware, storage version file
+static bool noManifest; // the server answered 404, only the version files are read until restart
+
+static char *trim(char *s) {
+	while ((*s == ' ') || (*s == '\t'))
+		s++;
+	char *end = s + strlen(s);
+	while ((end > s) && ((end[-1] == ' ') || (end[-1] == '\t') || (end[-1] == '\r')))
+		*--end = 0;
+	return s;
+}
+
+// returns the number of bytes, -1 if not valid
+int manifestParseHex(const char *hex, uint8_t *dest, int maxLen) {
+	int len = strlen(hex) / 2;
+	if ((strlen(hex) & 1) || (len > maxLen))
+		return -1;
+	for (int n = 0; n < len; n++) {
+		char byte[3] = {hex[2 * n], hex[2 * n + 1], 0};
+		char *end;
+		dest[n] = (uint8_t)strtoul(byte, &end, 16);
+		if (*end != 0)
+			return -1;
+	}
+	return len;
+}
+
+static void setEntry(manifestEntry_t *entry, const char *field, const char *value) {
+	if (strcmp(field, "version") == 0)
+		strncpy(entry->version, value, sizeof(entry->version) - 1);
+	else if (strcmp(field, "file") == 0)
+		strncpy(entry->fileName, value, sizeof(entry->fileName) - 1);
+	else if (strcmp(field, "size") == 0)
+		entry->size = strtoul(value, NULL, 10);
+	else if (strcmp(field, "sha256") == 0) {
+		entry->hasSha256 = manifestParseHex(value, entry->sha256, sizeof(entry->sha256)) == sizeof(entry->sha256);
+		if (!entry->hasSha256)
+			ESP_LOGE(TAG, "Invalid sha256");
+	} else if (strcmp(field, "signature") == 0) {
+		entry->signatureLen = manifestParseHex(value, entry->signature, sizeof(entry->signature));
+		if (entry->signatureLen < 0) {
+			ESP_LOGE(TAG, "Invalid signature");
+			entry->signatureLen = 0;
+		}
+	} else if (strcmp(field, "delta") == 0)
+		strncpy(entry->deltaFrom, value, sizeof(entry->deltaFrom) - 1);
+	else if (strcmp(field, "tree") == 0) {
+		entry->hasTree = manifestParseHex(value, entry->treeRoot, sizeof(entry->treeRoot)) == sizeof(entry->treeRoot);
+		if (!entry->hasTree)
+			ESP_LOGE(TAG, "Invalid tree root");
+	} else if (strcmp(field, "files") == 0) {
+		entry->hasFiles = manifestParseHex(value, entry->filesHash, sizeof(entry->filesHash)) == sizeof(entry->filesHash);
+		if (!entry->hasFiles)
+			ESP_LOGE(TAG, "Invalid files hash");
+	} else
+		ESP_LOGW(TAG, "Unknown field %s", field);
+}
+
+// clears all but the version, the version is kept when its file is not modified
+static void setDefaults(manifestEntry_t *entry, const char *fileName) {
+	char version[MAX_STORAGEVERSIONSIZE];
+	strcpy(version, entry->version);
+	memset(entry, 0, sizeof(manifestEntry_t));
+	strcpy(entry->version, version);
+	strncpy(entry->fileName, fileName, MANIFEST_FILENAME_SZ - 1);
+}
+
+static void parseManifest(char *text, updateManifest_t *manifest) {
+	char *save;
+	for (char *line = strtok_r(text, "\n", &save); line; line = strtok_r(NULL, "\n", &save)) {
+		line = trim(line);
+		char *value = strchr(line, '=');
+		if ((line[0] == '#') || (value == NULL))
+			continue;
+		*value++ = 0;
+		char *key = trim(line);
+		value = trim(value);
+		if (strncmp(key, "firmware.", 9) == 0)
+			setEntry(&manifest->firmware, key + 9, value);
+		else if (strncmp(key, "storage.", 8) == 0)
+			setEntry(&manifest->storage, key + 8, value);
+		else
+			ESP_LOGW(TAG, "Unknown key %s", key);
+	}
+}
+
+// gets the manifest from the upgrade url, one request for both update decisions
+// without a manifest on the server the version files are read
+// requests are conditional, manifest is left as it is (from the previous call) when the server reports not modified
+// a server without a manifest is not asked for it again, a poll stays at the two requests for the version files
+esp_err_t getManifest(updateManifest_t *manifest) {
+	char url[SERVER_URL_MAX_SZ];
+	int len = -1;
+
+	if (!noManifest) {
+		snprintf(url, sizeof(url), "%s/%s", wifiSettings.upgradeURL, MANIFEST_FILENAME);
+		len = httpsReadFile(url, manifestBuf, MANIFEST_MAXSIZE - 1, &manifestValidator);
+		if (len == HTTPS_NOT_MODIFIED)
+			return ESP_OK;
+		if (len == HTTPS_NOT_FOUND) {
+			ESP_LOGI(TAG, "No manifest on the server, reading version files until restart");
+			noManifest = true;
+		}
+	}
+	if (len > 0) {
+		manifestBuf[len] = 0;
+		memset(manifest, 0, sizeof(updateManifest_t));
+		setDefaults(&manifest->firmware, wifiSettings.upgradeFileName);
+		setDefaults(&manifest->storage, CONFIG_SPIFFS_UPGRADE_FILENAME);
+		parseManifest(manifestBuf, manifest);
+		memset(versionValidators, 0, sizeof(versionValidators)); // versions now come from the manifest
+		return ESP_OK;
+	}
+
+	if (!noManifest)
+		ESP_LOGI(TAG, "No manifest, reading version files");
+	setDefaults(&manifest->firmware, wifiSettings.upgradeFileName);
+	setDefaults(&manifest->storage, CONFIG_SPIFFS_UPGRADE_FILENAME);
+	getNewVersion(BINARY_INFO_FILENAME, manifest->firmware.version, &versionValidators[0]);
+	getNewVersion(SPIFFS_INFO_FILENAME, manifest->storage.version, &versionValidators[1]);
+	strcpy(manifest->firmware.deltaFrom, "*");
+	if ((manifest->firmware.version[0] == 0) && (manifest->storage.version[0] == 0))
+		return ESP_FAIL;
+	return ESP_OK;
+}
+
+// true if the server has a patch from fromVersion to this entry
+bool manifestHasDelta(const manifestEntry_t *entry, const char *fromVersion) {
+	char list[MANIFEST_DELTA_SZ];
+	char *save;
+
+	if (strcmp(entry->deltaFrom, "*") == 0)
+		return true;
+	strcpy(list, entry->deltaFrom);
+	for (char *version = strtok_r(list, " ,", &save); version; version = strtok_r(NULL, " ,", &save)) {
+		if (strcmp(version, fromVersion) == 0)
+			return true;
+	}
+	return false;
+}
@@ -0,0 +1,170 @@
+/*
+ * merkle.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: dig
+ *
+ *  the leaves are checked against the root from the manifest once, then every chunk against its leaf
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "mbedtls/sha256.h"
+
+#include "httpsReadFile.h"
+#include "merkle.h"
+#include "wifiConnect.h"
+
+static const char *TAG = "merkle";
+
+#define HASH_SZ 32
+
+// reduces the leaves to the root, levels are computed in place in a copy
+static esp_err_t merkleRoot(const uint8_t *leaves, int nrLeaves, uint8_t *root) {
+	uint8_t *work = (uint8_t *)malloc(nrLeaves * HASH_SZ);
+	if (work == NULL)
+		return ESP_ERR_NO_MEM;
+	memcpy(work, leaves, nrLeaves * HASH_SZ);
+	for (int n = nrLeaves; n > 1; n = (n + 1) / 2) {
+		for (int i = 0; i < n / 2; i++)
+			mbedtls_sha256(work + 2 * i * HASH_SZ, 2 * HASH_SZ, work + i * HASH_SZ, 0);
+		if (n & 1)
+			memmove(work + (n / 2) * HASH_SZ, work + (n - 1) * HASH_SZ, HASH_SZ);
+	}
+	memcpy(root, work, HASH_SZ);
+	free(work);
+	return ESP_OK;
+}
+
+// gets <file>.tree, checks it against the root in the manifest
+// without a tree in the manifest merkle stays unused (leaves NULL)
+esp_err_t merkleLoad(merkle_t *merkle, const manifestEntry_t *entry) {
+	char url[SERVER_URL_MAX_SZ];
+	uint8_t root[HASH_SZ];
+	int len;
+
+	memset(merkle, 0, sizeof(merkle_t));
+	if (!entry->hasTree)
+		return ESP_OK;
+	if (entry->size == 0) {
+		ESP_LOGE(TAG, "Tree without image size");
+		return ESP_ERR_INVALID_SIZE;
+	}
+	merkle->nrLeaves = (entry->size + MERKLE_CHUNKSIZE - 1) / MERKLE_CHUNKSIZE;
+	merkle->leaves = (uint8_t *)malloc(merkle->nrLeaves * HASH_SZ);
+	merkle->buf = (uint8_t *)malloc(MERKLE_CHUNKSIZE);
+	if ((merkle->leaves == NULL) || (merkle->buf == NULL)) {
+		merkleFree(merkle);
+		return ESP_ERR_NO_MEM;
+	}
+
+	snprintf(url, sizeof(url), "%s/%s" MERKLE_TREE_EXT, wifiSettings.upgradeURL, entry->fileName);
+	len = httpsReadFile(url, (char *)merkle->leaves, merkle->nrLeaves * HASH_SZ);
+	if (len != merkle->nrLeaves * HASH_SZ) {
+		ESP_LOGE(TAG, "Reading %s failed (%d of %d bytes)", url, len, merkle->nrLeaves * HASH_SZ);
+		merkleFree(merkle);
+		return ESP_FAIL;
+	}
+	esp_err_t err = merkleRoot(merkle->leaves, merkle->nrLeaves, root);
+	if ((err == ESP_OK) && (memcmp(root, entry->treeRoot, HASH_SZ) != 0)) {
+		ESP_LOGE(TAG, "%s does not match manifest", url);
+		err = ESP_ERR_INVALID_CRC;
+	}
+	if (err != ESP_OK) {
+		merkleFree(merkle);
+		return err;
+	}
+	ESP_LOGI(TAG, "%d chunks", merkle->nrLeaves);
+	return ESP_OK;
+}
+
+// offset: start of the data that follows, chunk aligned
+void merkleBegin(merkle_t *merkle, size_t offset, updateWriteFunc_t write, void *writeCtx) {
+	merkle->chunk = offset / MERKLE_CHUNKSIZE;
+	merkle->bufLen = 0;
+	merkle->failed = false;
+	merkle->write = write;
+	merkle->writeCtx = writeCtx;
+}
+
+static bool chunkOk(merkle_t *merkle, const uint8_t *data, int len, int chunk) {
+	uint8_t hash[HASH_SZ];
+
+	if (chunk >= merkle->nrLeaves)
+		return false;
+	mbedtls_sha256(data, len, hash, 0);
+	return memcmp(hash, merkle->leaves + chunk * HASH_SZ, HASH_SZ) == 0;
+}
+
+// passes the buffered chunk to the writer if it matches its leaf
+static esp_err_t flushChunk(merkle_t *merkle) {
+	if (!chunkOk(merkle, merkle->buf, merkle->bufLen, merkle->chunk)) {
+		ESP_LOGE(TAG, "Chunk %d corrupt", merkle->chunk);
+		merkle->failed = true;
+		return ESP_ERR_INVALID_CRC;
+	}
+	esp_err_t err = merkle->write(merkle->writeCtx, merkle->buf, merkle->bufLen);
+	merkle->chunk++;
+	merkle->bufLen = 0;
+	return err;
+}
+
+// updateWriteFunc_t, ctx is the merkle_t
+esp_err_t merkleWrite(void *ctx, const uint8_t *data, int len) {
+	merkle_t *merkle = (merkle_t *)ctx;
+	esp_err_t err = ESP_OK;
+
+	while ((len > 0) && (err == ESP_OK)) {
+		int n = MERKLE_CHUNKSIZE - merkle->bufLen;
+		if (n > len)
+			n = len;
+		memcpy(merkle->buf + merkle->bufLen, data, n);
+		merkle->bufLen += n;
+		data += n;
+		len -= n;
+		if (merkle->bufLen == MERKLE_CHUNKSIZE)
+			err = flushChunk(merkle);
+	}
+	return err;
+}
+
+// checks the last (short) chunk and that no chunk is missing
+esp_err_t merkleEnd(merkle_t *merkle) {
+	esp_err_t err = ESP_OK;
+
+	if (merkle->bufLen > 0)
+		err = flushChunk(merkle);
+	if ((err == ESP_OK) && (merkle->chunk != merkle->nrLeaves)) {
+		ESP_LOGE(TAG, "Image truncated at chunk %d of %d", merkle->chunk, merkle->nrLeaves);
+		err = ESP_ERR_INVALID_SIZE;
+	}
+	return err;
+}
+
+// checks the chunks of a resumed download that are already in flash, feeding verify on the way
+// returns the length that is good, the download continues from there
+size_t merkleCheckFlash(merkle_t *merkle, const esp_partition_t *partition, size_t len, imageVerify_t *verify) {
+	size_t offset;
+
+	for (offset = 0; offset < len; offset += MERKLE_CHUNKSIZE) {
+		int n = (len - offset > MERKLE_CHUNKSIZE) ? MERKLE_CHUNKSIZE : len - offset;
+		if (esp_partition_read(partition, offset, merkle->buf, n) != ESP_OK)
+			break;
+		if (!chunkOk(merkle, merkle->buf, n, offset / MERKLE_CHUNKSIZE)) {
+			ESP_LOGW(TAG, "Chunk %d in flash corrupt", offset / MERKLE_CHUNKSIZE);
+			break;
+		}
+		verifyUpdate(verify, merkle->buf, n);
+	}
+	return offset < len ? offset : len;
+}
+
+void merkleFree(merkle_t *merkle) {
+	free(merkle->leaves);
+	free(merkle->buf);
+	merkle->leaves = NULL;
+	merkle->buf = NULL;
+}
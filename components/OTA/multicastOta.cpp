@@ -0,0 +1,250 @@
+/*
+ * multicastOta.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: dig
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "lwip/sockets.h"
+#include "spi_flash_mmap.h"
+
+#include "httpsReadFile.h"
+#include "multicastOta.h"
+#include "verify.h"
+
+static const char *TAG = "multicastOta";
+
+#ifndef CONFIG_OTA_MULTICAST_GROUP
+#define CONFIG_OTA_MULTICAST_GROUP "239.255.0.77"
+#endif
+#ifndef CONFIG_OTA_MULTICAST_PORT
+#define CONFIG_OTA_MULTICAST_PORT 5077
+#endif
+#ifndef CONFIG_OTA_MULTICAST_LISTEN
+#define CONFIG_OTA_MULTICAST_LISTEN 10
+#endif
+
+#define IDLE_TIMEOUT 5000 // ms without a block of the image: the sender stopped
+#define BLOCKS_PER_SECTOR (SPI_FLASH_SEC_SIZE / MCAST_BLOCKSIZE)
+
+typedef struct {
+	const esp_partition_t *partition;
+	uint32_t imageSize;
+	uint32_t nrBlocks;
+	uint32_t missing;
+	uint32_t repaired;
+	uint8_t *have;	 // bitmap of the blocks in flash
+	uint8_t *erased; // bitmap of the sectors erased
+	uint8_t *buf;	 // MCAST_BLOCKSIZE
+} mcastImage_t;
+
+static bool hasBlock(mcastImage_t *image, uint32_t n) {
+	return image->have[n / 8] & (1 << (n % 8));
+}
+
+static int blockLen(mcastImage_t *image, uint32_t n) {
+	return (n == image->nrBlocks - 1) ? image->imageSize - n * MCAST_BLOCKSIZE : MCAST_BLOCKSIZE;
+}
+
+// a sector is erased when its first block comes in, before any block of it is written
+static esp_err_t writeBlock(mcastImage_t *image, uint32_t n, const uint8_t *data) {
+	uint32_t sector = n / BLOCKS_PER_SECTOR;
+	esp_err_t err = ESP_OK;
+
+	if (!(image->erased[sector / 8] & (1 << (sector % 8)))) {
+		err = esp_partition_erase_range(image->partition, sector * SPI_FLASH_SEC_SIZE, SPI_FLASH_SEC_SIZE);
+		if (err == ESP_OK)
+			image->erased[sector / 8] |= 1 << (sector % 8);
+	}
+	if (err == ESP_OK)
+		err = esp_partition_write(image->partition, n * MCAST_BLOCKSIZE, data, blockLen(image, n));
+	if (err != ESP_OK) {
+		ESP_LOGE(TAG, "Writing block %lu failed (%s)", (unsigned long)n, esp_err_to_name(err));
+		return err;
+	}
+	image->have[n / 8] |= 1 << (n % 8);
+	image->missing--;
+	return ESP_OK;
+}
+
+// rebuilds the one block missing in group: repair xor the other blocks, read back from flash
+static esp_err_t repairGroup(mcastImage_t *image, uint32_t group, int groupSize, uint8_t *repair) {
+	uint32_t first = group * groupSize;
+	uint32_t end = (first + groupSize < image->nrBlocks) ? first + groupSize : image->nrBlocks;
+	uint32_t lost = end;
+
+	for (uint32_t n = first; n < end; n++) {
+		if (!hasBlock(image, n)) {
+			if (lost != end)
+				return ESP_OK; // more than one lost, wait for the next round
+			lost = n;
+		}
+	}
+	if (lost == end)
+		return ESP_OK;
+	for (uint32_t n = first; n < end; n++) {
+		if (n == lost)
+			continue;
+		int len = blockLen(image, n);
+		esp_err_t err = esp_partition_read(image->partition, n * MCAST_BLOCKSIZE, image->buf, len);
+		if (err != ESP_OK)
+			return err;
+		for (int i = 0; i < len; i++) // a short block counts as padded with zeros
+			repair[i] ^= image->buf[i];
+	}
+	image->repaired++;
+	return writeBlock(image, lost, repair);
+}
+
+static int openSocket(void) {
+	struct sockaddr_in addr = {};
+	struct ip_mreq mreq = {};
+	struct timeval tv = { .tv_sec = 1, .tv_usec = 0 };
+
+	int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (sock < 0)
+		return -1;
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(CONFIG_OTA_MULTICAST_PORT);
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	mreq.imr_multiaddr.s_addr = inet_addr(CONFIG_OTA_MULTICAST_GROUP);
+	mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+	if ((bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) ||
+		(setsockopt(sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0) ||
+		(setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) < 0)) {
+		ESP_LOGE(TAG, "Cannot join " CONFIG_OTA_MULTICAST_GROUP ":%d (errno %d)", CONFIG_OTA_MULTICAST_PORT, errno);
+		close(sock);
+		return -1;
+	}
+	return sock;
+}
+
+// receives blocks of the image of entry until all are in or the sender stops
+static esp_err_t receiveBlocks(mcastImage_t *image, const manifestEntry_t *entry, int sock, uint8_t *packet) {
+	mcastHeader_t *header = (mcastHeader_t *)packet;
+	uint8_t *data = packet + sizeof(mcastHeader_t);
+	int64_t lastBlock = esp_timer_get_time();
+	int64_t timeout = CONFIG_OTA_MULTICAST_LISTEN * 1000000LL; // for the first block
+	esp_err_t err = ESP_OK;
+
+	while ((err == ESP_OK) && ((image->nrBlocks == 0) || (image->missing > 0))) {
+		int len = recv(sock, packet, sizeof(mcastHeader_t) + MCAST_BLOCKSIZE, 0);
+		if ((len < (int)sizeof(mcastHeader_t)) || (header->magic != MCAST_MAGIC) || (memcmp(header->imageId, entry->sha256, MCAST_ID_SIZE) != 0)) {
+			if (esp_timer_get_time() - lastBlock > timeout)
+				break;
+			continue;
+		}
+		lastBlock = esp_timer_get_time();
+		timeout = IDLE_TIMEOUT * 1000LL;
+		len -= sizeof(mcastHeader_t);
+
+		if (image->nrBlocks == 0) { // first packet of the image
+			if ((header->imageSize == 0) || (header->imageSize > image->partition->size) || (entry->size && (header->imageSize != entry->size))) {
+				ESP_LOGE(TAG, "Image size %lu does not fit", (unsigned long)header->imageSize);
+				return ESP_ERR_INVALID_SIZE;
+			}
+			image->imageSize = header->imageSize;
+			image->nrBlocks = (image->imageSize + MCAST_BLOCKSIZE - 1) / MCAST_BLOCKSIZE;
+			image->missing = image->nrBlocks;
+			image->have = (uint8_t *)calloc((image->nrBlocks + 7) / 8, 1);
+			image->erased = (uint8_t *)calloc((image->nrBlocks / BLOCKS_PER_SECTOR + 8) / 8, 1);
+			if (!image->have || !image->erased)
+				return ESP_ERR_NO_MEM;
+			ESP_LOGI(TAG, "Receiving %lu blocks", (unsigned long)image->nrBlocks);
+		}
+		if (header->imageSize != image->imageSize)
+			continue;
+		if (header->type == MCAST_DATA) {
+			if ((header->index < image->nrBlocks) && !hasBlock(image, header->index) && (len == blockLen(image, header->index)))
+				err = writeBlock(image, header->index, data);
+		} else if ((header->type == MCAST_REPAIR) && (header->groupSize > 0) && (len == MCAST_BLOCKSIZE))
+			err = repairGroup(image, header->index, header->groupSize, data);
+	}
+	return err;
+}
+
+// gets the blocks still missing from url (the image as flashed), one request from the first missing block on
+static esp_err_t fillGaps(mcastImage_t *image, char *url) {
+	httpsReader_t reader;
+	esp_err_t err;
+	uint32_t offset;
+	uint32_t n = 0;
+
+	while (hasBlock(image, n))
+		n++;
+	ESP_LOGI(TAG, "%lu blocks missing, from %s", (unsigned long)image->missing, url);
+	err = httpsReaderOpen(&reader, url, n * MCAST_BLOCKSIZE);
+	offset = reader.rangeStart; // the server may send the whole file
+	// read block by block straight into the block buffer
+	while ((err == ESP_OK) && (image->missing > 0) && (offset < image->imageSize)) {
+		n = offset / MCAST_BLOCKSIZE;
+		int inBlock = offset % MCAST_BLOCKSIZE;
+		int len = httpsReaderRead(&reader, image->buf + inBlock, blockLen(image, n) - inBlock);
+		if (len <= 0) {
+			err = (len < 0) ? ESP_FAIL : ESP_ERR_INVALID_SIZE; // missing > 0
+			break;
+		}
+		offset += len;
+		if ((inBlock + len == blockLen(image, n)) && !hasBlock(image, n))
+			err = writeBlock(image, n, image->buf);
+	}
+	httpsReaderClose(&reader);
+	return err;
+}
+
+// writes the image of entry from the multicast sender into partition, gapURL: the same image on the server
+// length: size of the image written
+// ESP_ERR_NOT_FOUND: no sender for this image
+esp_err_t multicastReceive(const manifestEntry_t *entry, const esp_partition_t *partition, char *gapURL, size_t *length) {
+	mcastImage_t image = {};
+	imageVerify_t verify;
+	esp_err_t err;
+
+	if (!entry->hasSha256)
+		return ESP_ERR_NOT_FOUND; // the image can not be identified nor checked
+	int sock = openSocket();
+	if (sock < 0)
+		return ESP_FAIL;
+	uint8_t *packet = (uint8_t *)malloc(sizeof(mcastHeader_t) + MCAST_BLOCKSIZE);
+	image.buf = (uint8_t *)malloc(MCAST_BLOCKSIZE);
+	image.partition = partition;
+
+	int64_t startTime = esp_timer_get_time();
+	if (!packet || !image.buf)
+		err = ESP_ERR_NO_MEM;
+	else
+		err = receiveBlocks(&image, entry, sock, packet);
+	close(sock);
+	free(packet);
+
+	if ((err == ESP_OK) && (image.nrBlocks == 0)) {
+		ESP_LOGI(TAG, "No sender");
+		err = ESP_ERR_NOT_FOUND;
+	}
+	if (err == ESP_OK) {
+		ESP_LOGI(TAG, "%lu of %lu blocks received (%lu repaired) in %lld ms", (unsigned long)(image.nrBlocks - image.missing),
+				 (unsigned long)image.nrBlocks, (unsigned long)image.repaired, (esp_timer_get_time() - startTime) / 1000);
+		if (image.missing > 0)
+			err = fillGaps(&image, gapURL);
+	}
+	if (err == ESP_OK) { // all blocks are in flash, check them as a whole
+		verifyBegin(&verify, entry);
+		err = verifyResume(&verify, partition, image.imageSize);
+		if (err == ESP_OK)
+			err = verifyEnd(&verify);
+		else
+			verifyAbort(&verify);
+	}
+	if (err == ESP_OK)
+		*length = image.imageSize;
+	free(image.have);
+	free(image.erased);
+	free(image.buf);
+	return err;
+}
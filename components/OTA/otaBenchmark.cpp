@@ -0,0 +1,67 @@
+/*
+ * otaBenchmark.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: dig
+ *
+ *  results of the ota benchmark, the run itself is otaBenchmarkTask in updateFirmWareTask.cpp
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "otaBenchmark.h"
+
+otaBenchmark_t otaBenchmark;
+
+static const char *stateNames[] = {"idle", "requested", "running", "done"};
+
+// the update task starts the run at its next poll, false if a run is pending
+bool otaBenchmarkStart(bool flash) {
+	if ((otaBenchmark.state == BENCH_REQUESTED) || (otaBenchmark.state == BENCH_RUNNING))
+		return false;
+	memset(&otaBenchmark, 0, sizeof(otaBenchmark));
+	otaBenchmark.flash = flash;
+	otaBenchmark.state = BENCH_REQUESTED;
+	return true;
+}
+
+// us: time waited for this block
+void otaBenchmarkBlock(otaBenchmark_t *bench, int64_t us) {
+	int bin = 0;
+	for (int64_t ms = us / 1000; (ms > 0) && (bin < OTA_BENCH_BINS - 1); ms >>= 1)
+		bin++;
+	bench->histogram[bin]++;
+	bench->blocks++;
+}
+
+static int ms(char *buf, int size, const char *name, int64_t us) {
+	return snprintf(buf, size, "%s=%lld.%03lld ms\n", name, us / 1000, us % 1000);
+}
+
+// key=value lines
+int otaBenchmarkReport(char *buf, int size) {
+	const otaBenchmark_t *bench = &otaBenchmark;
+	int len = snprintf(buf, size, "state=%s\n", stateNames[bench->state]);
+
+	if (bench->state != BENCH_DONE)
+		return len;
+	len += snprintf(buf + len, size - len, "result=%s\nflash=%d\n", esp_err_to_name(bench->result), bench->flash);
+	len += ms(buf + len, size - len, "dns_probe", bench->probe.dnsUs);
+	len += ms(buf + len, size - len, "tcp_probe", bench->probe.tcpUs);
+	len += ms(buf + len, size - len, "connect", bench->connect.connectUs);
+	len += ms(buf + len, size - len, "request", bench->connect.requestUs);
+	len += ms(buf + len, size - len, "ttfb", bench->connect.ttfbUs);
+	len += ms(buf + len, size - len, "download", bench->downloadUs);
+	len += snprintf(buf + len, size - len, "bytes=%lu\nbytes/s=%lld\nblocks=%lu\n", (unsigned long)bench->bytes,
+					bench->downloadUs ? (int64_t)bench->bytes * 1000000 / bench->downloadUs : 0, (unsigned long)bench->blocks);
+	for (int bin = 0; bin < OTA_BENCH_BINS - 1; bin++)
+		len += snprintf(buf + len, size - len, "block<%dms=%lu\n", 1 << bin, (unsigned long)bench->histogram[bin]);
+	len += snprintf(buf + len, size - len, "block>=%dms=%lu\n", 1 << (OTA_BENCH_BINS - 2), (unsigned long)bench->histogram[OTA_BENCH_BINS - 1]);
+	len += ms(buf + len, size - len, "write_stall", bench->writeStallUs);
+	if (bench->flash) {
+		len += ms(buf + len, size - len, "flash_time", bench->flashUs);
+		len += ms(buf + len, size - len, "erase_stall", bench->eraseStallUs);
+	}
+	return len;
+}
@@ -0,0 +1,130 @@
+/*
+ * sectorWriter.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: dig
+ *
+ *  the flash is compared directly, reading a sector back costs less than hashing it and the new data
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "spi_flash_mmap.h"
+
+#include "sectorWriter.h"
+
+static const char *TAG = "sectorWriter";
+
+#define COMPARE_SZ 256
+
+// true if flash at offset holds data (len bytes), data NULL: erased
+static bool flashEquals(const esp_partition_t *partition, size_t offset, const uint8_t *data, int len) {
+	uint8_t buf[COMPARE_SZ];
+
+	for (int n = 0; n < len; n += COMPARE_SZ) {
+		int size = (len - n > COMPARE_SZ) ? COMPARE_SZ : len - n;
+		if (esp_partition_read(partition, offset + n, buf, size) != ESP_OK)
+			return false;
+		if (data ? (memcmp(buf, data + n, size) != 0) : (buf[0] != 0xFF || memcmp(buf, buf + 1, size - 1) != 0))
+			return false;
+	}
+	return true;
+}
+
+// writes a whole sector of data
+static esp_err_t writeSector(sectorWriter_t *writer, const uint8_t *data) {
+	esp_err_t err;
+
+	if (writer->offset + SPI_FLASH_SEC_SIZE > writer->partition->size) {
+		ESP_LOGE(TAG, "Image too large for partition");
+		return ESP_ERR_INVALID_SIZE;
+	}
+	if (!writer->erase && flashEquals(writer->partition, writer->offset, data, SPI_FLASH_SEC_SIZE)) {
+		writer->skipped++;
+		writer->offset += SPI_FLASH_SEC_SIZE;
+		return ESP_OK;
+	}
+	if (writer->erase)
+		err = eraseAheadWait(writer->erase, writer->offset + SPI_FLASH_SEC_SIZE);
+	else
+		err = esp_partition_erase_range(writer->partition, writer->offset, SPI_FLASH_SEC_SIZE);
+	if (err == ESP_OK)
+		err = esp_partition_write(writer->partition, writer->offset, data, SPI_FLASH_SEC_SIZE);
+	if (err != ESP_OK)
+		ESP_LOGE(TAG, "Writing sector at 0x%x failed (%s)", writer->offset, esp_err_to_name(err));
+	writer->written++;
+	writer->offset += SPI_FLASH_SEC_SIZE;
+	return err;
+}
+
+// writes the sector in buf, the last one padded with erased bytes
+static esp_err_t flushSector(sectorWriter_t *writer) {
+	memset(writer->buf + writer->bufLen, 0xFF, SPI_FLASH_SEC_SIZE - writer->bufLen);
+	writer->bufLen = 0;
+	return writeSector(writer, writer->buf);
+}
+
+// offset: sector aligned start in partition
+// erase: the eraser of the partition, started at offset, NULL to compare sectors
+esp_err_t sectorWriterBegin(sectorWriter_t *writer, const esp_partition_t *partition, size_t offset, eraseAhead_t *erase) {
+	memset(writer, 0, sizeof(sectorWriter_t));
+	writer->partition = partition;
+	writer->offset = offset;
+	writer->erase = erase;
+	writer->buf = (uint8_t *)malloc(SPI_FLASH_SEC_SIZE);
+	return writer->buf ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+// updateWriteFunc_t, ctx is the sectorWriter_t
+esp_err_t sectorWriterWrite(void *ctx, const uint8_t *data, int len) {
+	sectorWriter_t *writer = (sectorWriter_t *)ctx;
+	esp_err_t err = ESP_OK;
+
+	while ((len > 0) && (err == ESP_OK)) {
+		if ((writer->bufLen == 0) && (len >= SPI_FLASH_SEC_SIZE)) { // whole sector, no copy
+			err = writeSector(writer, data);
+			data += SPI_FLASH_SEC_SIZE;
+			len -= SPI_FLASH_SEC_SIZE;
+			continue;
+		}
+		int n = SPI_FLASH_SEC_SIZE - writer->bufLen;
+		if (n > len)
+			n = len;
+		memcpy(writer->buf + writer->bufLen, data, n);
+		writer->bufLen += n;
+		data += n;
+		len -= n;
+		if (writer->bufLen == SPI_FLASH_SEC_SIZE)
+			err = flushSector(writer);
+	}
+	return err;
+}
+
+// writes the last sector
+esp_err_t sectorWriterEnd(sectorWriter_t *writer) {
+	esp_err_t err = ESP_OK;
+
+	if (writer->bufLen > 0)
+		err = flushSector(writer);
+	ESP_LOGI(TAG, "%lu sectors written, %lu unchanged", (unsigned long)writer->written, (unsigned long)writer->skipped);
+	sectorWriterAbort(writer);
+	return err;
+}
+
+// erases the sectors after the image that are not erased yet, after sectorWriterEnd
+esp_err_t sectorWriterClearRest(sectorWriter_t *writer) {
+	esp_err_t err = ESP_OK;
+
+	for (size_t offset = writer->offset; (offset < writer->partition->size) && (err == ESP_OK); offset += SPI_FLASH_SEC_SIZE) {
+		if (!flashEquals(writer->partition, offset, NULL, SPI_FLASH_SEC_SIZE))
+			err = esp_partition_erase_range(writer->partition, offset, SPI_FLASH_SEC_SIZE);
+	}
+	return err;
+}
+
+void sectorWriterAbort(sectorWriter_t *writer) {
+	free(writer->buf);
+	writer->buf = NULL;
+}
@@ -0,0 +1,281 @@
+/*
+ * storageFiles.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: dig
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "esp_log.h"
+#include "mbedtls/sha256.h"
+
+#include "httpsReadFile.h"
+#include "storageFiles.h"
+#include "storageIndex.h"
+#include "storagePartition.h"
+#include "wifiConnect.h"
+
+static const char *TAG = "storageFiles";
+
+#define LOCAL_LIST STORAGE_BASE_PATH "/" STORAGE_FILES_LIST // list of the files now on storage
+#define MAX_FILES 64
+#define PATH_SZ 64
+#define FILE_BUFSIZE 1024
+#define TMP_EXT "~" // download next to the file, renamed when complete
+
+typedef struct {
+	uint8_t sha256[32];
+	uint32_t size;
+	const char *path; // in the list, without leading '/'
+} fileEntry_t;
+
+// list lines: <sha256> <size> <path>, text is modified
+// returns the number of files
+static int parseList(char *text, fileEntry_t *files) {
+	char *save;
+	int nr = 0;
+
+	for (char *line = strtok_r(text, "\n", &save); line && (nr < MAX_FILES); line = strtok_r(NULL, "\n", &save)) {
+		char *fields;
+		char *hex = strtok_r(line, " \t\r", &fields);
+		char *size = strtok_r(NULL, " \t\r", &fields);
+		char *path = strtok_r(NULL, " \t\r", &fields);
+		if (!hex || !size || !path || (hex[0] == '#'))
+			continue;
+		if (manifestParseHex(hex, files[nr].sha256, sizeof(files[nr].sha256)) != sizeof(files[nr].sha256)) {
+			ESP_LOGE(TAG, "Invalid hash for %s", path);
+			continue;
+		}
+		while (*path == '/')
+			path++;
+		files[nr].size = strtoul(size, NULL, 10);
+		files[nr].path = path;
+		nr++;
+	}
+	return nr;
+}
+
+// true if the file on storage has size and hash of file
+static bool fileMatches(const char *filepath, const fileEntry_t *file, uint8_t *buf) {
+	struct stat file_stat;
+	mbedtls_sha256_context ctx;
+	uint8_t hash[32];
+	size_t len;
+
+	if ((stat(filepath, &file_stat) != 0) || (file_stat.st_size != file->size))
+		return false;
+	FILE *fd = fopen(filepath, "r");
+	if (!fd)
+		return false;
+	mbedtls_sha256_init(&ctx);
+	mbedtls_sha256_starts(&ctx, 0);
+	while ((len = fread(buf, 1, FILE_BUFSIZE, fd)) > 0)
+		mbedtls_sha256_update(&ctx, buf, len);
+	mbedtls_sha256_finish(&ctx, hash);
+	mbedtls_sha256_free(&ctx);
+	fclose(fd);
+	return memcmp(hash, file->sha256, sizeof(hash)) == 0;
+}
+
+typedef struct {
+	FILE *fd;
+	mbedtls_sha256_context sha256;
+	uint32_t size;
+} fileSink_t;
+
+static esp_err_t writeFile(void *ctx, const uint8_t *data, int len) {
+	fileSink_t *sink = (fileSink_t *)ctx;
+
+	if (fwrite(data, 1, len, sink->fd) != (size_t)len)
+		return ESP_FAIL;
+	mbedtls_sha256_update(&sink->sha256, data, len);
+	sink->size += len;
+	return ESP_OK;
+}
+
+// downloads file into filepath through buf, the file is replaced when the new one is complete and verified
+static esp_err_t downloadFile(const fileEntry_t *file, const char *filepath, uint8_t *buf) {
+	char url[SERVER_URL_MAX_SZ];
+	char tmpPath[PATH_SZ + sizeof(TMP_EXT)];
+	httpsReader_t reader;
+	fileSink_t sink = {};
+	uint8_t hash[32];
+	esp_err_t err;
+
+	snprintf(url, sizeof(url), "%s/" STORAGE_FILES_DIR "/%s", wifiSettings.upgradeURL, file->path);
+	snprintf(tmpPath, sizeof(tmpPath), "%s" TMP_EXT, filepath);
+	sink.fd = fopen(tmpPath, "w");
+	if (!sink.fd) {
+		ESP_LOGE(TAG, "Cannot create %s", tmpPath);
+		return ESP_FAIL;
+	}
+	mbedtls_sha256_init(&sink.sha256);
+	mbedtls_sha256_starts(&sink.sha256, 0);
+	err = httpsReaderOpen(&reader, url, 0);
+	if (err == ESP_OK) {
+		err = httpsReaderSink(&reader, buf, FILE_BUFSIZE, writeFile, &sink);
+		if (err != ESP_OK)
+			ESP_LOGE(TAG, "Reading %s failed", url);
+	}
+	httpsReaderClose(&reader);
+	mbedtls_sha256_finish(&sink.sha256, hash);
+	mbedtls_sha256_free(&sink.sha256);
+	fclose(sink.fd);
+
+	if ((err == ESP_OK) && ((sink.size != file->size) || (memcmp(hash, file->sha256, sizeof(hash)) != 0))) {
+		ESP_LOGE(TAG, "%s does not match the list", url);
+		err = ESP_ERR_INVALID_CRC;
+	}
+	if (err == ESP_OK) {
+		storageLock();
+		unlink(filepath);
+		if (rename(tmpPath, filepath) != 0)
+			err = ESP_FAIL;
+		storageIndexUpdate(filepath);
+		storageUnlock();
+	}
+	if (err != ESP_OK)
+		unlink(tmpPath);
+	return err;
+}
+
+// reads the list of the files on storage, returns the number of files
+static int readLocalList(char *text, fileEntry_t *files) {
+	FILE *fd = fopen(LOCAL_LIST, "r");
+	if (!fd)
+		return 0;
+	size_t len = fread(text, 1, STORAGE_FILES_MAXSIZE - 1, fd);
+	fclose(fd);
+	text[len] = 0;
+	return parseList(text, files);
+}
+
+static esp_err_t writeLocalList(const char *text, int len) {
+	esp_err_t err = ESP_OK;
+
+	storageLock();
+	FILE *fd = fopen(LOCAL_LIST, "w");
+	if (!fd || (fwrite(text, 1, len, fd) != (size_t)len))
+		err = ESP_FAIL;
+	if (fd)
+		fclose(fd);
+	storageIndexUpdate(LOCAL_LIST);
+	storageUnlock();
+	return err;
+}
+
+static void removeFile(const char *filepath) {
+	storageLock();
+	unlink(filepath);
+	storageIndexRemove(filepath);
+	storageUnlock();
+}
+
+// without a local list: the files on storage that are not in files, paths is a buffer of STORAGE_FILES_MAXSIZE
+// downloads (and uploads) in progress, <file>~, are left alone
+static int removeUnlisted(const fileEntry_t *files, int nrFiles, char *paths) {
+	int removed = 0;
+	int nrPaths = storageIndexPaths(paths, STORAGE_FILES_MAXSIZE);
+	const char *filepath = paths;
+
+	for (int n = 0; n < nrPaths; n++, filepath += strlen(filepath) + 1) {
+		const char *path = filepath + sizeof(STORAGE_BASE_PATH); // behind the '/'
+		size_t len = strlen(path);
+		int i;
+		if ((strcmp(filepath, LOCAL_LIST) == 0) || ((len >= sizeof(TMP_EXT) - 1) && (strcmp(path + len - (sizeof(TMP_EXT) - 1), TMP_EXT) == 0)))
+			continue;
+		for (i = 0; (i < nrFiles) && (strcmp(path, files[i].path) != 0); i++)
+			;
+		if (i == nrFiles) {
+			ESP_LOGI(TAG, "Removing %s", path);
+			removeFile(filepath);
+			removed++;
+		}
+	}
+	return removed;
+}
+
+// updates the files on storage to the list of entry
+esp_err_t storageFilesUpdate(const manifestEntry_t *entry) {
+	char url[SERVER_URL_MAX_SZ];
+	char filepath[PATH_SZ];
+	uint8_t hash[32];
+	esp_err_t err = ESP_OK;
+	int downloaded = 0, unchanged = 0, removed = 0;
+	uint32_t bytes = 0;
+
+	char *list = (char *)malloc(STORAGE_FILES_MAXSIZE);
+	char *text = (char *)malloc(STORAGE_FILES_MAXSIZE); // list as received, parsing modifies list
+	char *oldList = (char *)malloc(STORAGE_FILES_MAXSIZE);
+	fileEntry_t *files = (fileEntry_t *)malloc(MAX_FILES * sizeof(fileEntry_t));
+	fileEntry_t *oldFiles = (fileEntry_t *)malloc(MAX_FILES * sizeof(fileEntry_t));
+	uint8_t *buf = (uint8_t *)malloc(FILE_BUFSIZE);
+	if (!list || !text || !oldList || !files || !oldFiles || !buf)
+		err = ESP_ERR_NO_MEM;
+
+	int len = 0;
+	if (err == ESP_OK) {
+		snprintf(url, sizeof(url), "%s/%s", wifiSettings.upgradeURL, STORAGE_FILES_LIST);
+		len = httpsReadFile(url, text, STORAGE_FILES_MAXSIZE - 1);
+		if (len <= 0) {
+			ESP_LOGE(TAG, "Reading %s failed", url);
+			err = ESP_FAIL;
+		}
+	}
+	if (err == ESP_OK) {
+		mbedtls_sha256((const unsigned char *)text, len, hash, 0);
+		if (memcmp(hash, entry->filesHash, sizeof(hash)) != 0) {
+			ESP_LOGE(TAG, "%s does not match the manifest", url);
+			err = ESP_ERR_INVALID_CRC;
+		}
+	}
+	if (err == ESP_OK) {
+		memcpy(list, text, len);
+		list[len] = 0;
+		int nrFiles = parseList(list, files);
+		int nrOldFiles = readLocalList(oldList, oldFiles);
+
+		for (int n = 0; (n < nrFiles) && (err == ESP_OK); n++) {
+			snprintf(filepath, sizeof(filepath), STORAGE_BASE_PATH "/%s", files[n].path);
+			if (fileMatches(filepath, &files[n], buf))
+				unchanged++;
+			else {
+				ESP_LOGI(TAG, "Downloading %s", files[n].path);
+				err = downloadFile(&files[n], filepath, buf);
+				downloaded++;
+				bytes += files[n].size;
+			}
+		}
+		// files of the previous version that are gone
+		for (int n = 0; (n < nrOldFiles) && (err == ESP_OK); n++) {
+			int i;
+			for (i = 0; (i < nrFiles) && (strcmp(oldFiles[n].path, files[i].path) != 0); i++)
+				;
+			if (i == nrFiles) {
+				snprintf(filepath, sizeof(filepath), STORAGE_BASE_PATH "/%s", oldFiles[n].path);
+				removeFile(filepath);
+				removed++;
+			}
+		}
+		// first update per file: which files of the storage image are gone is not known, all unlisted ones go
+		if ((err == ESP_OK) && (nrOldFiles == 0))
+			removed = removeUnlisted(files, nrFiles, oldList);
+	}
+	if (err == ESP_OK)
+		err = writeLocalList(text, len);
+	if (err == ESP_OK)
+		ESP_LOGI(TAG, "%d files downloaded (%lu bytes), %d unchanged, %d removed", downloaded, (unsigned long)bytes, unchanged, removed);
+
+	free(list);
+	free(text);
+	free(oldList);
+	free(files);
+	free(oldFiles);
+	free(buf);
+	return err;
+}
@@ -6,6 +6,7 @@
  */
 
 #include <inttypes.h>
+#include <stdio.h>
 #include <string.h>
 
 #include "esp_app_format.h"
@@ -13,49 +14,378 @@
 #include "esp_log.h"
 #include "esp_ota_ops.h"
 #include "esp_partition.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include "spi_flash_mmap.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "updateTask.h"
+#include "updateFirmWareTask.h"
 
+#include "decompress.h"
+#include "deltaPatch.h"
+#include "eraseAhead.h"
 #include "httpsReadFile.h"
+#include "lanPeer.h"
+#include "manifest.h"
+#include "merkle.h"
+#include "multicastOta.h"
+#include "otaBenchmark.h"
+#include "sectorWriter.h"
 #include "settings.h"
+#include "verify.h"
 #include "wifiConnect.h"
+#include "writeBehind.h"
 
-//#define DOWNLOAD_ONLY
+#define PROGRESS_NAMESPACE "ota"
+#define PROGRESS_KEY "progress"
 
-static uint8_t ota_write_data[BUFFSIZE];
+#ifndef CONFIG_OTA_RESUME
+#define CONFIG_OTA_RESUME 0
+#endif
+#ifndef CONFIG_OTA_CHUNK_RETRIES
+#define CONFIG_OTA_CHUNK_RETRIES 0
+#endif
 
 static const char *TAG = "updateFirmwareTask";
 
-void updateFirmwareTask(void *pvParameter) {
+#if CONFIG_OTA_DELTA_UPDATES
+static deltaPatch_t patch;
+#endif
+static decompress_t decompress;
+static merkle_t merkle;
+
+// download progress of the full image, kept in nvs to resume an interrupted download
+typedef struct {
+	char version[MAX_STORAGEVERSIONSIZE]; // version being downloaded
+	uint32_t length;					  // size of the image on the server
+	uint32_t address;					  // update partition
+	uint32_t committed;					  // bytes in flash, multiple of a sector
+} otaProgress_t;
+
+typedef struct {
+	const esp_partition_t *update_partition;
+	bool image_header_was_checked;
+	size_t binary_file_length; // bytes written to the partition
+	eraseAhead_t erase;		   // erases the partition ahead of the data
+	sectorWriter_t sectors;	   // writes whole sectors behind the erase
+	otaProgress_t *progress;   // NULL: download can not be resumed
+	const manifestEntry_t *entry;
+	imageVerify_t verify;
+	merkle_t *merkle; // NULL: no chunk hashes
+	bool flash;		  // false: download only (benchmark)
+	otaBenchmark_t *bench; // NULL: no statistics
+} imageWriter_t;
+
+static bool loadProgress(otaProgress_t *progress) {
+	nvs_handle_t handle;
+	size_t len = sizeof(otaProgress_t);
+	esp_err_t err = nvs_open(PROGRESS_NAMESPACE, NVS_READONLY, &handle);
+	if (err == ESP_OK) {
+		err = nvs_get_blob(handle, PROGRESS_KEY, progress, &len);
+		nvs_close(handle);
+	}
+	return (err == ESP_OK) && (len == sizeof(otaProgress_t));
+}
+
+static void saveProgress(const otaProgress_t *progress) {
+	nvs_handle_t handle;
+	esp_err_t err = nvs_open(PROGRESS_NAMESPACE, NVS_READWRITE, &handle);
+	if (err == ESP_OK) {
+		if (progress)
+			err = nvs_set_blob(handle, PROGRESS_KEY, progress, sizeof(otaProgress_t));
+		else
+			err = nvs_erase_key(handle, PROGRESS_KEY);
+		if ((err == ESP_OK) || (err == ESP_ERR_NVS_NOT_FOUND))
+			err = nvs_commit(handle);
+		nvs_close(handle);
+	}
+	if (err != ESP_OK)
+		ESP_LOGE(TAG, "Error (%s) saving progress", esp_err_to_name(err));
+}
+
+// the sectors written so far survive a reset, remember them
+static void commitProgress(imageWriter_t *writer, bool always) {
+	uint32_t committed = writer->binary_file_length & ~(SPI_FLASH_SEC_SIZE - 1);
+	if (always ? (committed != writer->progress->committed)
+			   : (committed >= writer->progress->committed + CONFIG_OTA_RESUME_COMMIT_SECTORS * SPI_FLASH_SEC_SIZE)) {
+		writer->progress->committed = committed;
+		saveProgress(writer->progress);
+	}
+}
+
+// checks the header of the new image, then writes the image to the update partition
+// the partition is erased ahead of the data from where the download starts, so a resumed download keeps the sectors written before
+// data is written per sector, binary_file_length rounded down to a sector is in flash
+static esp_err_t writeImage(void *ctx, const uint8_t *data, int data_read) {
+	imageWriter_t *writer = (imageWriter_t *)ctx;
+	esp_err_t err = ESP_OK;
+
+	if ((writer->image_header_was_checked == false) && (writer->binary_file_length > 0))
+		writer->image_header_was_checked = true; // resumed, checked in an earlier attempt
+
+	if (writer->image_header_was_checked == false) {
+		esp_app_desc_t new_app_info;
+		if (data_read > sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t) + sizeof(esp_app_desc_t)) {
+			memcpy(&new_app_info, &data[sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t)], sizeof(esp_app_desc_t));
+			ESP_LOGI(TAG, "New firmware version: %s", new_app_info.version);
+			ESP_LOGI(TAG, "New firmware project: %s", new_app_info.project_name);
+
+			esp_app_desc_t running_app_info;
+			if (esp_ota_get_partition_description(writer->update_partition, &running_app_info) == ESP_OK) {
+				ESP_LOGI(TAG, "Project name: %s", running_app_info.project_name);
+				ESP_LOGI(TAG, "Old internal firmware version: %s",
+						 running_app_info.version); // internal firmware version, not used here
+			} else
+				ESP_LOGI(TAG, "Cannot read info running app");
+
+			if (memcmp(new_app_info.version, running_app_info.version, sizeof(new_app_info.version)) == 0) {
+				ESP_LOGW(TAG, "Current running internal version is the same as a new."); // internal firmware version, not used here
+			}
+			writer->image_header_was_checked = true;
+		} else {
+			ESP_LOGE(TAG, "received failed");
+			err = !ESP_OK;
+		}
+	} // end if (image_header_was_checked == false)
+
+	if ((err == ESP_OK) && (writer->binary_file_length + data_read > writer->update_partition->size)) {
+		ESP_LOGE(TAG, "Image too large for partition");
+		err = ESP_ERR_INVALID_SIZE;
+	}
+	if ((err == ESP_OK) && writer->flash) {
+		int64_t startTime = esp_timer_get_time();
+		err = sectorWriterWrite(&writer->sectors, data, data_read);
+		if (err != ESP_OK) {
+			ESP_LOGE(TAG, "Error ota write (%s)", esp_err_to_name(err));
+		}
+		if (writer->bench)
+			writer->bench->flashUs += esp_timer_get_time() - startTime;
+	}
+	if (err == ESP_OK) {
+		verifyUpdate(&writer->verify, data, data_read);
+		writer->binary_file_length += data_read;
+		//			ESP_LOGD(TAG, "Written image length %d", binary_file_length);
+		if (writer->progress)
+			commitProgress(writer, false);
+	}
+	return err;
+}
+
+// called before the first block, checks the server sends the part of the image we are missing
+static esp_err_t startProgress(imageWriter_t *writer, const httpsReader_t *reader) {
+	otaProgress_t *progress = writer->progress;
+
+	if (reader->rangeStart != writer->binary_file_length) { // server sends the whole file
+		writer->binary_file_length = 0;
+		if (writer->flash) {
+			int64_t stallUs = writer->erase.stallUs;
+			sectorWriterAbort(&writer->sectors);
+			eraseAheadEnd(&writer->erase);
+			if ((eraseAheadBegin(&writer->erase, writer->update_partition, 0) != ESP_OK) ||
+				(sectorWriterBegin(&writer->sectors, writer->update_partition, 0, &writer->erase) != ESP_OK))
+				return ESP_ERR_NO_MEM;
+			writer->erase.stallUs = stallUs;
+		}
+		progress->committed = 0;
+		verifyAbort(&writer->verify);
+		verifyBegin(&writer->verify, writer->entry);
+		if (writer->merkle)
+			merkleBegin(writer->merkle, 0, writer->merkle->write, writer->merkle->writeCtx);
+	}
+	if (reader->contentLength <= 0) {
+		ESP_LOGW(TAG, "Image size unknown, download can not be resumed");
+		writer->progress = NULL;
+	} else if ((progress->committed > 0) && (progress->length != reader->contentLength)) {
+		ESP_LOGW(TAG, "Image on server changed");
+		return ESP_ERR_INVALID_STATE;
+	} else
+		progress->length = reader->contentLength;
+	return ESP_OK;
+}
+
+#if CONFIG_OTA_DELTA_UPDATES
+static esp_err_t writePatch(void *ctx, const uint8_t *data, int len) {
+	return deltaPatchWrite((deltaPatch_t *)ctx, data, len);
+}
+#endif
+
+// downloads url into the update partition, a patch (isDelta) is applied against the running partition first
+// a compressed url (eg .hs) is decompressed before that
+// with progress the download continues after progress->committed bytes and progress is kept up to date
+static esp_err_t downloadImage(char *url, bool isDelta, imageWriter_t *writer, otaProgress_t *progress) {
 	esp_err_t err = ESP_OK;
-	esp_ota_handle_t update_handle = 0;
-	char updateURL[96];
-	httpsRegParams_t httpsRegParams;
-	size_t binary_file_length = 0;
-	httpsMssg_t mssg;
-	bool rdy = false;
-	bool doUpdate = false;
-	bool image_header_was_checked = false;
-	int data_read;
-	int block = 0;
+	httpsReader_t reader;
+	writeBehind_t behind;
+	int64_t startTime;
+	int blocks = 0;
+	int bytes = 0;
+	updateWriteFunc_t write = writeImage; // first stage of the chain to the update partition
+	void *writeCtx = writer;
+	const decoder_t *decoder = decompressFind(url);
+
+	writer->image_header_was_checked = false;
+	writer->progress = progress;
+	writer->binary_file_length = progress ? progress->committed : 0;
+	verifyBegin(&writer->verify, writer->entry);
+	if (writer->binary_file_length > 0) {
+		if (writer->merkle) { // continue after the last good chunk in flash
+			writer->binary_file_length = merkleCheckFlash(writer->merkle, writer->update_partition, writer->binary_file_length, &writer->verify);
+			progress->committed = writer->binary_file_length;
+		} else
+			err = verifyResume(&writer->verify, writer->update_partition, writer->binary_file_length);
+		if (err != ESP_OK) {
+			verifyAbort(&writer->verify);
+			return err;
+		}
+	}
+	if (writer->merkle) { // chunks are checked as they come out of the chain, before they are written
+		merkleBegin(writer->merkle, writer->binary_file_length, write, writeCtx);
+		write = merkleWrite;
+		writeCtx = writer->merkle;
+	}
+#if CONFIG_OTA_DELTA_UPDATES
+	if (isDelta) {
+		deltaPatchBegin(&patch, esp_ota_get_running_partition(), write, writeCtx);
+		write = writePatch;
+		writeCtx = &patch;
+	}
+#endif
+	if (decoder) {
+		err = decompressBegin(&decompress, decoder, write, writeCtx);
+		if (err != ESP_OK) {
+			verifyAbort(&writer->verify);
+			return err;
+		}
+		write = decompressWrite;
+		writeCtx = &decompress;
+	}
+
+	if (writer->binary_file_length > 0)
+		ESP_LOGI(TAG, "Resuming %s at %d", url, writer->binary_file_length);
+	else
+		ESP_LOGI(TAG, "Downloading %s", url);
+
+	// erasing runs while the connection is set up
+	if (writer->flash && (eraseAheadBegin(&writer->erase, writer->update_partition, writer->binary_file_length) != ESP_OK ||
+						  sectorWriterBegin(&writer->sectors, writer->update_partition, writer->binary_file_length, &writer->erase) != ESP_OK)) {
+		eraseAheadEnd(&writer->erase);
+		if (decoder)
+			decompressAbort(&decompress);
+		verifyAbort(&writer->verify);
+		return ESP_ERR_NO_MEM;
+	}
+
+	// the chain writes in a task of its own, the next blocks are read meanwhile
+	startTime = esp_timer_get_time();
+	err = writeBehindBegin(&behind, write, writeCtx);
+	if (err == ESP_OK) {
+		// the benchmark times the connection of the download itself
+		err = httpsReaderOpen(&reader, url, writer->binary_file_length, writer->bench ? &writer->bench->connect : NULL);
+		if ((err == ESP_OK) && writer->progress)
+			err = startProgress(writer, &reader);
+		int64_t blockTime = startTime;
+		while (err == ESP_OK) {
+			uint8_t *block = writeBehindGet(&behind);
+			if (!block) // chain failed, writeBehindEnd returns why
+				break;
+			int len = httpsReaderRead(&reader, block, CONFIG_HTTPS_READ_BUFSIZE);
+			if (len <= 0) {
+				writeBehindPut(&behind, block, 0);
+				if (len < 0)
+					err = ESP_FAIL;
+				break;
+			}
+			if (writer->bench) {
+				int64_t now = esp_timer_get_time();
+				otaBenchmarkBlock(writer->bench, now - blockTime);
+				blockTime = now;
+			}
+			blocks++;
+			bytes += len;
+			putchar('.');
+			writeBehindPut(&behind, block, len);
+		}
+		httpsReaderClose(&reader);
+		esp_err_t writeErr = writeBehindEnd(&behind);
+		if (err == ESP_OK)
+			err = writeErr;
+		ESP_LOGI(TAG, "Download waited %lld ms for the writer", behind.stallUs / 1000);
+		if (writer->bench)
+			writer->bench->writeStallUs = behind.stallUs;
+	}
+	if (err == ESP_OK) {
+		int64_t ms = (esp_timer_get_time() - startTime) / 1000;
+		if (writer->bench) {
+			writer->bench->downloadUs = esp_timer_get_time() - startTime;
+			writer->bench->bytes = bytes;
+		}
+		ESP_LOGI(TAG, "Ready received %d bytes %d blocks in %lld ms (%lld kB/s)", bytes, blocks, ms, ms ? (int64_t)bytes / ms : 0);
+	}
+
+	if (decoder) {
+		if (err == ESP_OK)
+			err = decompressEnd(&decompress);
+		else
+			decompressAbort(&decompress);
+	}
+#if CONFIG_OTA_DELTA_UPDATES
+	if (isDelta && (err == ESP_OK))
+		err = deltaPatchEnd(&patch);
+#endif
+	if (writer->merkle && (err == ESP_OK))
+		err = merkleEnd(writer->merkle);
+	if (writer->flash) {
+		if (err == ESP_OK)
+			err = sectorWriterEnd(&writer->sectors); // the last sector
+		else
+			sectorWriterAbort(&writer->sectors);
+		eraseAheadEnd(&writer->erase);
+		ESP_LOGI(TAG, "Writer waited %lld ms for erase", writer->erase.stallUs / 1000);
+		if (writer->bench)
+			writer->bench->eraseStallUs = writer->erase.stallUs;
+	}
+	if ((err == ESP_OK) && (writer->binary_file_length == 0)) {
+		ESP_LOGE(TAG, "No data received");
+		err = !ESP_OK;
+	}
+	if (err == ESP_OK) {
+		err = verifyEnd(&writer->verify); // known as soon as the last block is written
+		if ((err != ESP_OK) && writer->progress) {
+			saveProgress(NULL); // do not resume a corrupted image
+			writer->progress = NULL;
+		}
+	} else
+		verifyAbort(&writer->verify);
+	if ((err != ESP_OK) && writer->progress)
+		commitProgress(writer, true);
+	return err;
+}
+
+// pvParameter: manifestEntry_t of the firmware to update to
+void updateFirmwareTask(void *pvParameter) {
+	esp_err_t err = ESP_FAIL;
+	char updateURL[SERVER_URL_MAX_SZ];
+	imageWriter_t writer = {};
+	const manifestEntry_t *entry = (const manifestEntry_t *)pvParameter;
+	const char *newVersion = entry->version;
+
+	writer.entry = entry;
+	writer.flash = true;
 
 	ESP_LOGI(TAG, "Starting updateFirmwareTask");
 
 	updateStatus = UPDATE_BUSY;
 
-	httpsRegParams.httpsServer = wifiSettings.upgradeServer;
-	strcpy(updateURL, wifiSettings.upgradeURL);
-	strcat(updateURL, "/");
-	strcat(updateURL, wifiSettings.upgradeFileName);
-	httpsRegParams.httpsURL = updateURL;
-	httpsRegParams.destbuffer = ota_write_data;
-	httpsRegParams.maxChars = sizeof(ota_write_data);
+	if (verifySignature(entry) != ESP_OK) { // tampered manifest, do not touch flash
+		updateStatus = UPDATE_ERROR;
+		vTaskDelete(NULL);
+	}
 
 	const esp_partition_t *configured = esp_ota_get_boot_partition();
 	const esp_partition_t *running = esp_ota_get_running_partition();
-	const esp_partition_t *update_partition = esp_ota_get_next_update_partition(NULL);
-	if (update_partition == NULL) {
+	writer.update_partition = esp_ota_get_next_update_partition(NULL);
+	if (writer.update_partition == NULL) {
 		ESP_LOGE(TAG, "update_partition not valid");
 		updateStatus = UPDATE_ERROR;
 		vTaskDelete( NULL);	
@@ -68,119 +398,90 @@ void updateFirmwareTask(void *pvParameter) {
 	}
 	ESP_LOGI(TAG, "Running partition type %d subtype %d (offset 0x%08" PRIx32 ")", running->type, running->subtype, running->address);
 
-	ESP_LOGI(TAG, "Writing to partition subtype %d at offset 0x%" PRIx32, update_partition->subtype, update_partition->address);
-	if ( httpsReqRdyMssgBox) {
-		xQueueSend(httpsReqRdyMssgBox, &mssg, 0);
+	ESP_LOGI(TAG, "Writing to partition subtype %d at offset 0x%" PRIx32, writer.update_partition->subtype, writer.update_partition->address);
+
+	if (merkleLoad(&merkle, entry) != ESP_OK) {
+		updateStatus = UPDATE_ERROR;
+		vTaskDelete(NULL);
 	}
-	xTaskCreate(&httpsGetRequestTask, "httpsGetRequestTask", 8192, (void *)&httpsRegParams, 5, NULL);
-	vTaskDelay(10);
+	writer.merkle = merkle.leaves ? &merkle : NULL;
 
-	while (!rdy && (err == ESP_OK)) {
-		xQueueSend(httpsReqRdyMssgBox, &mssg, 0);
-		if (xQueueReceive(httpsReqMssgBox, (void *)&mssg, (CONFIG_OTA_RECV_TIMEOUT / portTICK_PERIOD_MS))) {
-			data_read = mssg.len;
-			block++;
-			//	ESP_LOGI(TAG, "Reading block %d bytes %d ", block ,data_read);
-			putchar('.');
-			if (data_read < 0) {
-				ESP_LOGE(TAG, "Error: SSL data read error");
-				err = !ESP_OK;
-			} else {
-
-				if (data_read == 0) {
-					ESP_LOGI(TAG, "Ready written %d bytes %d mssgs", binary_file_length, block);
-					rdy = true;
-				} else {
-					if (image_header_was_checked == false) {
-						esp_app_desc_t new_app_info;
-						if (data_read > sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t) + sizeof(esp_app_desc_t)) {
-							memcpy(&new_app_info, &ota_write_data[sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t)],
-								   sizeof(esp_app_desc_t));
-							ESP_LOGI(TAG, "New firmware version: %s", new_app_info.version);
-							ESP_LOGI(TAG, "New firmware project: %s", new_app_info.project_name);
-
-							esp_app_desc_t running_app_info;
-							if (esp_ota_get_partition_description(update_partition, &running_app_info) == ESP_OK) {
-								ESP_LOGI(TAG, "Project name: %s", running_app_info.project_name);
-								ESP_LOGI(TAG, "Old internal firmware version: %s",
-										 running_app_info.version); // internal firmware version, not used here
-							} else
-								ESP_LOGI(TAG, "Cannot read info running app");
-
-							if (memcmp(new_app_info.version, running_app_info.version, sizeof(new_app_info.version)) == 0) {
-								ESP_LOGW(TAG, "Current running internal version is the same as a new."); // internal firmware version, not used here
-							}
-							image_header_was_checked = true;
-#ifndef DOWNLOAD_ONLY
-							err = esp_ota_begin(update_partition, OTA_WITH_SEQUENTIAL_WRITES, &update_handle);
-							if (err != ESP_OK) {
-								ESP_LOGE(TAG, "esp_ota_begin failed (%s)", esp_err_to_name(err));
-								esp_ota_abort(update_handle);
-								err = !ESP_OK;
-							}
-							else
-								ESP_LOGI(TAG, "esp_ota_begin succeeded");
-#endif								
-
-						} else {
-							ESP_LOGE(TAG, "received failed");
-#ifndef DOWNLOAD_ONLY
-							esp_ota_abort(update_handle);
+	// resume an interrupted download of this version
+	otaProgress_t progress;
+	bool resume = false;
+	bool resumable = CONFIG_OTA_RESUME && (decompressFind(entry->fileName) == NULL);
+	if (resumable) {
+		resume = loadProgress(&progress) && (strcmp(progress.version, newVersion) == 0) &&
+				 (progress.address == writer.update_partition->address) && (progress.committed > 0);
+		if (!resume) {
+			memset(&progress, 0, sizeof(progress));
+			strncpy(progress.version, newVersion, sizeof(progress.version) - 1);
+			progress.address = writer.update_partition->address;
+		}
+	}
+
+#if CONFIG_OTA_MULTICAST
+	// the fleet sender, blocks it does not deliver come from the image as flashed (not compressed) on the server
+	if (!resume && entry->hasSha256) {
+		const char *name = entry->fileName;
+		snprintf(updateURL, sizeof(updateURL), "%s/%.*s", wifiSettings.upgradeURL, (int)(strlen(name) - strlen(decompressExtension(name))), name);
+		size_t length;
+		err = multicastReceive(entry, writer.update_partition, updateURL, &length);
+		if (err == ESP_OK)
+			writer.binary_file_length = length;
+		else if (err != ESP_ERR_NOT_FOUND)
+			ESP_LOGW(TAG, "Multicast update failed, downloading");
+	}
 #endif
-							err = !ESP_OK;
-						}
-						//						ESP_LOGI(TAG, "read :%d %d", data_read, block++);
-					} // end if (image_header_was_checked == false)
-
-					if (err == ESP_OK) {
-#ifndef DOWNLOAD_ONLY
-						err = esp_ota_write(update_handle, (const void *)ota_write_data, data_read);
-						if (err != ESP_OK) {
-							ESP_LOGE(TAG, "Error ota write (%s)", esp_err_to_name(err));
-							esp_ota_abort(update_handle);
-						}
+#if CONFIG_OTA_LAN_PEERS
+	// a device on the lan already running the new version, its image is checked against the manifest
+	if ((err != ESP_OK) && !resume && entry->hasSha256 && lanPeerFind(newVersion, updateURL, sizeof(updateURL))) {
+		err = downloadImage(updateURL, false, &writer, NULL);
+		if (err != ESP_OK)
+			ESP_LOGW(TAG, "LAN peer failed, using the server");
+	}
 #endif
-					}
-					binary_file_length += data_read;
-					//			ESP_LOGD(TAG, "Written image length %d", binary_file_length);
-				}
-			}
-		} else {
-			ESP_LOGE(TAG, "read firmware timeout");
-
-#ifndef DOWNLOAD_ONLY
-			if (update_handle)
-				esp_ota_abort(update_handle);
+#if CONFIG_OTA_DELTA_UPDATES
+	if ((err != ESP_OK) && !resume && (wifiSettings.firmwareVersion[0] != 0) && manifestHasDelta(entry, wifiSettings.firmwareVersion)) {
+		// the patch is compressed like the full image
+		snprintf(updateURL, sizeof(updateURL), "%s/" DELTA_FILENAME_FMT "%s", wifiSettings.upgradeURL, wifiSettings.firmwareVersion, newVersion,
+				 decompressExtension(entry->fileName));
+		err = downloadImage(updateURL, true, &writer, NULL);
+		if (err != ESP_OK)
+			ESP_LOGW(TAG, "No usable delta patch, downloading full image");
+	}
 #endif
-			err = !ESP_OK;
+	if (err != ESP_OK) {
+		snprintf(updateURL, sizeof(updateURL), "%s/%s", wifiSettings.upgradeURL, entry->fileName);
+		err = downloadImage(updateURL, false, &writer, resumable ? &progress : NULL);
+		if (err == ESP_ERR_INVALID_STATE) { // image changed since the last attempt, start again
+			progress.committed = 0;
+			err = downloadImage(updateURL, false, &writer, &progress);
 		}
+		// a corrupt chunk is not written, get the image again from there
+		for (int retry = 0; (err != ESP_OK) && merkle.failed && resumable && (retry < CONFIG_OTA_CHUNK_RETRIES); retry++) {
+			ESP_LOGW(TAG, "Refetching from chunk %d", merkle.chunk);
+			err = downloadImage(updateURL, false, &writer, &progress);
+		}
+	}
 
-	} // end while (! rdy && !err)
-	if ( binary_file_length == 0) {
-		ESP_LOGE(TAG, "No data received");
-		err = !ESP_OK;
+	if ((err == ESP_OK) && entry->size && (entry->size != writer.binary_file_length)) {
+		ESP_LOGE(TAG, "Image size %d, manifest %" PRIu32, writer.binary_file_length, entry->size);
+		err = ESP_ERR_INVALID_SIZE;
+		if (resumable)
+			saveProgress(NULL);
 	}
 	if (err == ESP_OK) {
-		ESP_LOGI(TAG, "Total Write binary data length: %d", binary_file_length);
-#ifndef DOWNLOAD_ONLY
-		err |= esp_ota_end(update_handle);
-#endif
-		if (err != ESP_OK) {
-			if (err == ESP_ERR_OTA_VALIDATE_FAILED) {
-				ESP_LOGE(TAG, "Image validation failed, image is corrupted (%s)", esp_err_to_name(err));
-			} else {
-				ESP_LOGE(TAG, "esp_ota_end failed (%s)!", esp_err_to_name(err));
-			}
-		}
-		if (err == ESP_OK) {
+		ESP_LOGI(TAG, "Total Write binary data length: %d", writer.binary_file_length);
+		err = esp_ota_set_boot_partition(writer.update_partition); // verifies the image
+		if (err == ESP_ERR_OTA_VALIDATE_FAILED)
+			ESP_LOGE(TAG, "Image validation failed, image is corrupted (%s)", esp_err_to_name(err));
+		else if (err != ESP_OK)
+			ESP_LOGE(TAG, "esp_ota_set_boot_partition failed (%s)!", esp_err_to_name(err));
+		else
 			ESP_LOGI(TAG, "Image written successful");
-#ifndef DOWNLOAD_ONLY
-			err = esp_ota_set_boot_partition(update_partition);
-#endif
-			if (err != ESP_OK) {
-				ESP_LOGE(TAG, "esp_ota_set_boot_partition failed (%s)!", esp_err_to_name(err));
-			}
-		}
+		if (resumable)
+			saveProgress(NULL); // done, or corrupted: start again
 	}
 
 	if (err == ESP_OK)
@@ -188,5 +489,46 @@ void updateFirmwareTask(void *pvParameter) {
 	else
 		updateStatus = UPDATE_ERROR;
 
+	merkleFree(&merkle);
+	vTaskDelete(NULL);
+}
+
+// dry run of an update to the firmware in entry, see otaBenchmark.h
+// pvParameter: manifestEntry_t of the firmware
+void otaBenchmarkTask(void *pvParameter) {
+	const manifestEntry_t *entry = (const manifestEntry_t *)pvParameter;
+	otaBenchmark_t *bench = &otaBenchmark;
+	char updateURL[SERVER_URL_MAX_SZ];
+	imageWriter_t writer = {};
+	char report[768];
+
+	updateStatus = UPDATE_BUSY;
+	bench->state = BENCH_RUNNING;
+	ESP_LOGI(TAG, "Starting otaBenchmarkTask, flash %d", bench->flash);
+
+	writer.entry = entry;
+	writer.update_partition = esp_ota_get_next_update_partition(NULL);
+	writer.flash = bench->flash;
+	writer.bench = bench;
+	snprintf(updateURL, sizeof(updateURL), "%s/%s", wifiSettings.upgradeURL, entry->fileName);
+
+	esp_err_t err = (writer.update_partition != NULL) ? ESP_OK : ESP_ERR_NOT_FOUND;
+	if (err == ESP_OK)
+		err = httpsProbeConnect(updateURL, &bench->probe);
+	if (err == ESP_OK)
+		err = merkleLoad(&merkle, entry);
+	if (err == ESP_OK) {
+		writer.merkle = merkle.leaves ? &merkle : NULL;
+		if (writer.flash && CONFIG_OTA_RESUME)
+			saveProgress(NULL); // the partition is overwritten
+		err = downloadImage(updateURL, false, &writer, NULL);
+		merkleFree(&merkle);
+	}
+	bench->result = err;
+	bench->state = BENCH_DONE;
+	otaBenchmarkReport(report, sizeof(report));
+	printf("%s", report);
+
+	updateStatus = (err == ESP_OK) ? UPDATE_RDY : UPDATE_ERROR;
 	vTaskDelete(NULL);
 }
@@ -4,12 +4,14 @@
  *  Created on: May 24, 2023
  *      Author: dig
  */
+#include <stdio.h>
 #include <string.h>
 #include "errno.h"
 #include <inttypes.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "nvs_flash.h"
 
 #include "updateTask.h"
@@ -17,84 +19,183 @@
 #include "wifiConnect.h"
 #include "settings.h"
 #include "httpsReadFile.h"
+#include "decompress.h"
+#include "manifest.h"
+#include "merkle.h"
+#include "sectorWriter.h"
+#include "storageFiles.h"
+#include "storageIndex.h"
+#include "storagePartition.h"
+#include "verify.h"
+#include "writeBehind.h"
 
 static const char *TAG = "updateSPIFFSTask";
 
+static decompress_t decompress;
+static merkle_t merkle;
+
+typedef struct {
+	const esp_partition_t *partition;
+	bool started;
+	size_t length;
+	imageVerify_t verify;
+	sectorWriter_t sectors;
+} storageWriter_t;
+
+// writes the image per sector, only sectors that changed are erased and written
+// nothing is touched before the first block arrives
+static esp_err_t writeStorage(void *ctx, const uint8_t *data, int len) {
+	storageWriter_t *writer = (storageWriter_t *)ctx;
+	esp_err_t err = ESP_OK;
+
+	if (!writer->started) {
+		err = sectorWriterBegin(&writer->sectors, writer->partition, 0, NULL);
+		if (err != ESP_OK)
+			return err;
+		writer->started = true;
+	}
+	err = sectorWriterWrite(&writer->sectors, data, len);
+	if (err != ESP_OK) {
+		ESP_LOGE(TAG, "Error ota write (%s)", esp_err_to_name(err));
+	} else
+		verifyUpdate(&writer->verify, data, len);
+	writer->length += len;
+	return err;
+}
+
+// pvParameter: manifestEntry_t of the storage image to update to
 void updateSpiffsTask(void *pvParameter) {
+	const manifestEntry_t *entry = (const manifestEntry_t *)pvParameter;
 	esp_err_t err;
-	size_t binary_file_length = 0;
-	char updateURL[96];
-	httpsMssg_t mssg;
-	bool rdy = false;
-	bool started = false;
-	int block = 0;
-	int data_read;
-	httpsRegParams_t httpsRegParams;
-	uint8_t ota_write_data[BUFFSIZE + 1];
+	storageWriter_t writer = {};
+	char updateURL[SERVER_URL_MAX_SZ];
+	httpsReader_t reader;
+	writeBehind_t behind;
+	int64_t startTime;
+	int blocks = 0;
+	int bytes = 0;
 
 	ESP_LOGI(TAG, "Starting updateSpiffsTask");
 	updateStatus = UPDATE_BUSY;
 
-	const esp_partition_t *spiffsPartition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_SPIFFS, NULL);
-	ESP_LOGI(TAG, "SPIFFS partition type %d subtype %d (offset 0x%08"PRIx32")", spiffsPartition->type, spiffsPartition->subtype, spiffsPartition->address);
+	if (verifySignature(entry) != ESP_OK) { // tampered manifest, do not touch flash
+		updateStatus = UPDATE_ERROR;
+		vTaskDelete(NULL);
+	}
 
-	err = ESP_OK;
+#if CONFIG_OTA_STORAGE_FILES
+	if (entry->hasFiles) { // only the files that changed
+		if (storageFilesUpdate(entry) == ESP_OK) {
+			updateStatus = UPDATE_RDY;
+			vTaskDelete(NULL);
+		}
+		ESP_LOGW(TAG, "Update per file failed, flashing the image");
+	}
+#endif
 
-	httpsRegParams.httpsServer = wifiSettings.upgradeServer;
-	strcpy(updateURL, wifiSettings.upgradeURL);
-	strcat(updateURL, "//");
-	strcat(updateURL, CONFIG_SPIFFS_UPGRADE_FILENAME);
+	// with two storage partitions the one not mounted, the file server keeps working
+	const esp_partition_t *spiffsPartition = storageInactive();
+	bool switchPartition = (spiffsPartition != NULL);
+	if (!switchPartition)
+		spiffsPartition = storageMounted();
+	ESP_LOGI(TAG, "SPIFFS partition type %d subtype %d (offset 0x%08"PRIx32")", spiffsPartition->type, spiffsPartition->subtype, spiffsPartition->address);
+
+	if (merkleLoad(&merkle, entry) != ESP_OK) { // tree in the manifest but not usable, do not touch flash
+		updateStatus = UPDATE_ERROR;
+		vTaskDelete(NULL);
+	}
 
-	httpsRegParams.httpsURL = updateURL;
+	err = ESP_OK;
+	writer.partition = spiffsPartition;
+	updateWriteFunc_t write = writeStorage;
+	void *writeCtx = &writer;
+
+	if (merkle.leaves) { // chunks are checked as they come out of the chain, before they are written
+		merkleBegin(&merkle, 0, write, writeCtx);
+		write = merkleWrite;
+		writeCtx = &merkle;
+	}
 
-	httpsRegParams.destbuffer = ota_write_data;
-	httpsRegParams.maxChars = sizeof(ota_write_data) ;
+	snprintf(updateURL, sizeof(updateURL), "%s/%s", wifiSettings.upgradeURL, entry->fileName);
 
-	xTaskCreate(&httpsGetRequestTask, "httpsGetRequestTask", 8192, (void*) &httpsRegParams, 5, NULL);
-	vTaskDelay(10);
-	/*deal with all receive packet*/
+	const decoder_t *decoder = decompressFind(updateURL);
+	if (decoder) {
+		if (decompressBegin(&decompress, decoder, write, writeCtx) != ESP_OK) {
+			merkleFree(&merkle);
+			updateStatus = UPDATE_ERROR;
+			vTaskDelete(NULL);
+		}
+		write = decompressWrite;
+		writeCtx = &decompress;
+	}
 
-	while (!rdy && (err == ESP_OK)) {
-		xQueueSend(httpsReqRdyMssgBox, &mssg, 0);
-		if (xQueueReceive(httpsReqMssgBox, (void*) &mssg, ( UPDATETIMEOUT / portTICK_PERIOD_MS))) {
-			data_read = mssg.len;
-			block++;
-			putchar('.');
-		//	ESP_LOGI(TAG, "Reading block %d bytes %d ", block ,data_read);
-			if (data_read < 0) {
-				ESP_LOGE(TAG, "Error reading");
-				err = !ESP_OK;
-			}
-			if (data_read == 0) {
-				rdy = true;
-			} else {
-				if (!started) {
-					started = true;
-					err = esp_partition_erase_range(spiffsPartition, 0, spiffsPartition->size);
-					if (err != ESP_OK) {
-						ESP_LOGE(TAG, "spiffs partition erase failed: (%s)", esp_err_to_name(err));
-						err = !ESP_OK;
-					}
-					else
-						ESP_LOGI(TAG, "spiffs partition erased");
-				}
-				err = esp_partition_write(spiffsPartition, binary_file_length, (const void*) ota_write_data, data_read);
-				if (err != ESP_OK) {
-					ESP_LOGE(TAG, "Error ota write (%s)", esp_err_to_name(err));
-				}
-				binary_file_length += data_read;
+	verifyBegin(&writer.verify, entry);
+
+	// the chain writes in a task of its own, the next blocks are read meanwhile
+	startTime = esp_timer_get_time();
+	err = writeBehindBegin(&behind, write, writeCtx);
+	if (err == ESP_OK) {
+		err = httpsReaderOpen(&reader, updateURL, 0);
+		while (err == ESP_OK) {
+			uint8_t *block = writeBehindGet(&behind);
+			if (!block) // chain failed, writeBehindEnd returns why
+				break;
+			int len = httpsReaderRead(&reader, block, CONFIG_HTTPS_READ_BUFSIZE);
+			if (len <= 0) {
+				writeBehindPut(&behind, block, 0);
+				if (len < 0)
+					err = ESP_FAIL;
+				break;
 			}
+			blocks++;
+			bytes += len;
+			putchar('.');
+			writeBehindPut(&behind, block, len);
 		}
+		httpsReaderClose(&reader);
+		esp_err_t writeErr = writeBehindEnd(&behind);
+		if (err == ESP_OK)
+			err = writeErr;
 	}
 
-	if (!rdy) {
-		do {
-			xQueueSend(httpsReqRdyMssgBox, &mssg, 0);
-			xQueueReceive(httpsReqMssgBox, (void*) &mssg, (1000 / portTICK_PERIOD_MS)); // wait for httpsGetRequestTask to end
-		}while (mssg.len > 0);
+	if (decoder) {
+		if (err == ESP_OK)
+			err = decompressEnd(&decompress);
+		else
+			decompressAbort(&decompress);
+	}
+	if (merkle.leaves) {
+		if (err == ESP_OK)
+			err = merkleEnd(&merkle);
+		else if (merkle.failed)
+			ESP_LOGE(TAG, "Storage image stopped at chunk %d", merkle.chunk);
+		merkleFree(&merkle);
 	}
+	if (writer.started) {
+		if (err == ESP_OK)
+			err = sectorWriterEnd(&writer.sectors);
+		else
+			sectorWriterAbort(&writer.sectors);
+		if (err == ESP_OK) // no old file system data after the image
+			err = sectorWriterClearRest(&writer.sectors);
+	}
+	if ((err == ESP_OK) && entry->size && (entry->size != writer.length)) {
+		ESP_LOGE(TAG, "Image size %d, manifest %" PRIu32, writer.length, entry->size);
+		err = ESP_ERR_INVALID_SIZE;
+	}
+	if (err == ESP_OK)
+		err = verifyEnd(&writer.verify);
 	else
-		ESP_LOGI(TAG, "Ready written %d bytes %d blocks", binary_file_length, block);
+		verifyAbort(&writer.verify);
+	if ((err == ESP_OK) && switchPartition) // verified, use it from now on
+		err = storageSwitch(spiffsPartition);
+	else if (writer.started) // written under the mounted file system
+		storageIndexBuild();
+	if (err == ESP_OK) {
+		int64_t ms = (esp_timer_get_time() - startTime) / 1000;
+		ESP_LOGI(TAG, "Ready written %d bytes, received %d bytes %d blocks in %lld ms (%lld kB/s)", writer.length, bytes, blocks, ms,
+				 ms ? (int64_t)bytes / ms : 0);
+	}
 
 	if ( err == ESP_OK)
 		updateStatus = UPDATE_RDY;
@@ -20,6 +20,8 @@
 #include "updateTask.h"
 #include "updateFirmWareTask.h"
 #include "updateSpiffsTask.h"
+#include "manifest.h"
+#include "otaBenchmark.h"
 
 static const char *TAG = "updateTask";
 
@@ -32,7 +34,8 @@ typedef struct {
 } versionInfoParam_t;
 
 
-esp_err_t getNewVersion(char *infoFileName, char *newVersion) {
+// reads the version file, with validator newVersion is left unchanged when the file is not modified
+esp_err_t getNewVersion(char *infoFileName, char *newVersion, httpsValidator_t *validator) {
 	char url[96];
 	int len;
 
@@ -40,8 +43,10 @@ esp_err_t getNewVersion(char *infoFileName, char *newVersion) {
 	strcat(url, "/");
 	strcat(url, infoFileName);
 
-	len = httpsReadFile( url, newVersion, MAX_STORAGEVERSIONSIZE-1);
-	newVersion[len] = 0;
+	len = httpsReadFile( url, newVersion, MAX_STORAGEVERSIONSIZE-1, validator);
+	if (len == HTTPS_NOT_MODIFIED)
+		return ESP_OK;
+	newVersion[(len > 0) ? len : 0] = 0;
 	
 	if (len >0)
 		return ESP_OK;
@@ -49,9 +54,10 @@ esp_err_t getNewVersion(char *infoFileName, char *newVersion) {
 		return ESP_FAIL;
 }
 
+static updateManifest_t manifest;
+
 void updateTask(void *pvParameter) {
 	bool doUpdate;
-	char newVersion[MAX_STORAGEVERSIONSIZE];
 	TaskHandle_t updateFWTaskh;
 	TaskHandle_t updateSPIFFSTaskh;
 
@@ -71,27 +77,38 @@ void updateTask(void *pvParameter) {
 	}
 	ESP_LOGI(TAG, "Running partition type %d subtype %d (offset 0x%08"PRIx32")", running->type, running->subtype, running->address);
 
+#if CONFIG_OTA_BENCHMARK_AT_START
+	otaBenchmarkStart(CONFIG_OTA_BENCHMARK_FLASH);
+#endif
+
 	while (1) {
 		doUpdate = false;
-		getNewVersion(BINARY_INFO_FILENAME, newVersion);
-		if (newVersion[0] != 0) {
-			if (strcmp(newVersion, wifiSettings.firmwareVersion) != 0) {
-				ESP_LOGI(TAG, "New firmware version available: %s", newVersion);
+		httpsSessionBegin(wifiSettings.upgradeURL); // one connection for all requests of this poll
+		getManifest(&manifest);
+		if ((otaBenchmark.state == BENCH_REQUESTED) && (manifest.firmware.fileName[0] != 0)) {
+			xTaskCreate(&otaBenchmarkTask, "otaBenchmarkTask", 2 * 8192, (void *)&manifest.firmware, 5, NULL);
+			vTaskDelay(100 / portTICK_PERIOD_MS);
+			while (updateStatus == UPDATE_BUSY)
+				vTaskDelay(100 / portTICK_PERIOD_MS);
+		}
+		if (manifest.firmware.version[0] != 0) {
+			if (strcmp(manifest.firmware.version, wifiSettings.firmwareVersion) != 0) {
+				ESP_LOGI(TAG, "New firmware version available: %s", manifest.firmware.version);
 				doUpdate = true;
 			} else
-				ESP_LOGI(TAG, "Firmware up to date: %s", newVersion);
+				ESP_LOGI(TAG, "Firmware up to date: %s", manifest.firmware.version);
 		} else
 			ESP_LOGE(TAG, "Reading New firmware info failed");
 
 		if (doUpdate) {
-			ESP_LOGI(TAG, "Updating firmware to version: %s", newVersion);
-			xTaskCreate(&updateFirmwareTask, "updateFirmwareTask", 2 * 8192, NULL, 5, &updateFWTaskh);
+			ESP_LOGI(TAG, "Updating firmware to version: %s", manifest.firmware.version);
+			xTaskCreate(&updateFirmwareTask, "updateFirmwareTask", 2 * 8192, (void *)&manifest.firmware, 5, &updateFWTaskh);
 			vTaskDelay(100 / portTICK_PERIOD_MS);
 			while (updateStatus == UPDATE_BUSY)
 				vTaskDelay(100 / portTICK_PERIOD_MS);
 
 			if (updateStatus == UPDATE_RDY) {
-				strcpy(wifiSettings.firmwareVersion, newVersion);
+				strcpy(wifiSettings.firmwareVersion, manifest.firmware.version);
 				saveSettings();
 				ESP_LOGI(TAG, "Update successfull, restarting system!");
 				vTaskDelay(100 / portTICK_PERIOD_MS);
@@ -105,19 +122,18 @@ void updateTask(void *pvParameter) {
 // ********************* SPIFFS update ***************************
 
 		doUpdate = false;
-		getNewVersion(SPIFFS_INFO_FILENAME, newVersion);
-		if (newVersion[0] != 0) {
-			if (strcmp(newVersion, wifiSettings.SPIFFSversion) != 0) {
-				ESP_LOGI(TAG, "New SPIFFS version available: %s", newVersion);
+		if (manifest.storage.version[0] != 0) {
+			if (strcmp(manifest.storage.version, wifiSettings.SPIFFSversion) != 0) {
+				ESP_LOGI(TAG, "New SPIFFS version available: %s", manifest.storage.version);
 				doUpdate = true;
 			} else
-				ESP_LOGI(TAG, "SPIFFS up to date: %s", newVersion);
+				ESP_LOGI(TAG, "SPIFFS up to date: %s", manifest.storage.version);
 		} else
 			ESP_LOGI(TAG, "Reading New SPIFFS info failed");
 
 		if (doUpdate) {
-			ESP_LOGI(TAG, "Updating SPIFFS to version: %s", newVersion);
-			xTaskCreate(&updateSpiffsTask, "updateSpiffsTask", 2 * 8192, NULL, 5, &updateSPIFFSTaskh);
+			ESP_LOGI(TAG, "Updating SPIFFS to version: %s", manifest.storage.version);
+			xTaskCreate(&updateSpiffsTask, "updateSpiffsTask", 2 * 8192, (void *)&manifest.storage, 5, &updateSPIFFSTaskh);
 			vTaskDelay(100 / portTICK_PERIOD_MS);
 
 			while (updateStatus == UPDATE_BUSY) // wait for task to finish
@@ -125,11 +141,12 @@ void updateTask(void *pvParameter) {
 
 			if (updateStatus == UPDATE_RDY) {
 				ESP_LOGI(TAG, "SPIFFS flashed OK");
-				strcpy(wifiSettings.SPIFFSversion, newVersion);
+				strcpy(wifiSettings.SPIFFSversion, manifest.storage.version);
 				saveSettings();
 			} else
 				ESP_LOGI(TAG, "Update SPIFFS failed!");
 		}
+		httpsSessionEnd();
 	//	vTaskDelay(CONFIG_CHECK_FIRMWARWE_UPDATE_INTERVAL * 60 * 60 * 1000 / portTICK_PERIOD_MS);
 		vTaskDelay(10000 / portTICK_PERIOD_MS);
 	}
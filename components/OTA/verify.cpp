@@ -0,0 +1,118 @@
+/*
+ * verify.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: dig
+ *
+ *  the digest is computed on the data as it is written, so the result is known when the last block arrives
+ */
+
+#include <string.h>
+
+#include "esp_log.h"
+#include "mbedtls/pk.h"
+
+#include "verify.h"
+
+static const char *TAG = "verify";
+
+#if CONFIG_OTA_SIGNED_MANIFEST
+extern const char update_key_pem_start[] asm("_binary_update_key_pub_pem_start");
+extern const char update_key_pem_end[] asm("_binary_update_key_pub_pem_end");
+#endif
+
+#if CONFIG_OTA_SIGNED_MANIFEST
+// the signed message: "<version>\n<file>\n" and the 32 bytes of the sha256 of the image (makeManifest.py sign)
+// an older signed image can not be offered under a new version
+static void signedDigest(const manifestEntry_t *entry, uint8_t *digest) {
+	mbedtls_sha256_context ctx;
+
+	mbedtls_sha256_init(&ctx);
+	mbedtls_sha256_starts(&ctx, 0);
+	mbedtls_sha256_update(&ctx, (const unsigned char *)entry->version, strlen(entry->version));
+	mbedtls_sha256_update(&ctx, (const unsigned char *)"\n", 1);
+	mbedtls_sha256_update(&ctx, (const unsigned char *)entry->fileName, strlen(entry->fileName));
+	mbedtls_sha256_update(&ctx, (const unsigned char *)"\n", 1);
+	mbedtls_sha256_update(&ctx, entry->sha256, sizeof(entry->sha256));
+	mbedtls_sha256_finish(&ctx, digest);
+	mbedtls_sha256_free(&ctx);
+}
+#endif
+
+// checks version, file name and sha256 in the manifest were signed with the update key, before anything is flashed
+esp_err_t verifySignature(const manifestEntry_t *entry) {
+#if CONFIG_OTA_SIGNED_MANIFEST
+	mbedtls_pk_context pk;
+	uint8_t digest[32];
+	int ret;
+
+	if (!entry->hasSha256 || (entry->signatureLen == 0)) {
+		ESP_LOGE(TAG, "%s not signed", entry->fileName);
+		return ESP_ERR_INVALID_STATE;
+	}
+	signedDigest(entry, digest);
+	mbedtls_pk_init(&pk);
+	ret = mbedtls_pk_parse_public_key(&pk, (const unsigned char *)update_key_pem_start, update_key_pem_end - update_key_pem_start);
+	if (ret == 0)
+		ret = mbedtls_pk_verify(&pk, MBEDTLS_MD_SHA256, digest, sizeof(digest), entry->signature, entry->signatureLen);
+	mbedtls_pk_free(&pk);
+	if (ret != 0) {
+		ESP_LOGE(TAG, "Invalid signature for %s (-0x%04x)", entry->fileName, -ret);
+		return ESP_ERR_INVALID_RESPONSE;
+	}
+	ESP_LOGI(TAG, "Signature %s OK", entry->fileName);
+#endif
+	return ESP_OK;
+}
+
+void verifyBegin(imageVerify_t *verify, const manifestEntry_t *entry) {
+	verify->entry = entry;
+	verify->active = entry && entry->hasSha256;
+	if (verify->active) {
+		mbedtls_sha256_init(&verify->ctx);
+		mbedtls_sha256_starts(&verify->ctx, 0);
+	}
+}
+
+// a resumed download: the part written before is read back once
+esp_err_t verifyResume(imageVerify_t *verify, const esp_partition_t *partition, size_t len) {
+	uint8_t buf[256];
+	esp_err_t err = ESP_OK;
+
+	for (size_t offset = 0; verify->active && (offset < len) && (err == ESP_OK); offset += sizeof(buf)) {
+		size_t n = (len - offset > sizeof(buf)) ? sizeof(buf) : len - offset;
+		err = esp_partition_read(partition, offset, buf, n);
+		if (err == ESP_OK)
+			mbedtls_sha256_update(&verify->ctx, buf, n);
+	}
+	if (err != ESP_OK)
+		ESP_LOGE(TAG, "Reading partition failed (%s)", esp_err_to_name(err));
+	return err;
+}
+
+void verifyUpdate(imageVerify_t *verify, const uint8_t *data, int len) {
+	if (verify->active)
+		mbedtls_sha256_update(&verify->ctx, data, len);
+}
+
+// compares the digest of all data written with the manifest
+esp_err_t verifyEnd(imageVerify_t *verify) {
+	uint8_t hash[32];
+
+	if (!verify->active)
+		return ESP_OK;
+	mbedtls_sha256_finish(&verify->ctx, hash);
+	verifyAbort(verify);
+	if (memcmp(hash, verify->entry->sha256, sizeof(hash)) != 0) {
+		ESP_LOGE(TAG, "sha256 of %s does not match manifest", verify->entry->fileName);
+		return ESP_ERR_INVALID_CRC;
+	}
+	ESP_LOGI(TAG, "sha256 %s OK", verify->entry->fileName);
+	return ESP_OK;
+}
+
+void verifyAbort(imageVerify_t *verify) {
+	if (verify->active)
+		mbedtls_sha256_free(&verify->ctx); // releases the sha engine
+	verify->active = false;
+}
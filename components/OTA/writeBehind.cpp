@@ -0,0 +1,110 @@
+/*
+ * writeBehind.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: dig
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "httpsReadFile.h"
+
+#include "writeBehind.h"
+
+static const char *TAG = "writeBehind";
+
+typedef struct {
+	uint8_t *data;
+	int len;
+} writeBehindBlock_t;
+
+static void writeBehindTask(void *pvParameter) {
+	writeBehind_t *behind = (writeBehind_t *)pvParameter;
+	writeBehindBlock_t block;
+
+	while (xQueueReceive(behind->filled, &block, portMAX_DELAY) == pdTRUE) {
+		if (block.data == NULL)
+			break;
+		if ((behind->err == ESP_OK) && (block.len > 0)) {
+			esp_err_t err = behind->write(behind->writeCtx, block.data, block.len);
+			if (err != ESP_OK) {
+				ESP_LOGE(TAG, "Write failed (%s)", esp_err_to_name(err));
+				behind->err = err;
+			}
+		}
+		xQueueSend(behind->free, &block.data, portMAX_DELAY);
+	}
+	xSemaphoreGive(behind->done);
+	vTaskDelete(NULL);
+}
+
+// starts the writer task, write(writeCtx) gets the blocks in the order they are put
+esp_err_t writeBehindBegin(writeBehind_t *behind, updateWriteFunc_t write, void *writeCtx) {
+	memset(behind, 0, sizeof(writeBehind_t));
+	behind->write = write;
+	behind->writeCtx = writeCtx;
+	behind->blocks = (uint8_t *)malloc(CONFIG_OTA_WRITE_BEHIND_BLOCKS * CONFIG_HTTPS_READ_BUFSIZE);
+	behind->free = xQueueCreate(CONFIG_OTA_WRITE_BEHIND_BLOCKS, sizeof(uint8_t *));
+	behind->filled = xQueueCreate(CONFIG_OTA_WRITE_BEHIND_BLOCKS + 1, sizeof(writeBehindBlock_t)); // + the end
+	behind->done = xSemaphoreCreateBinary();
+	if (!behind->blocks || !behind->free || !behind->filled || !behind->done ||
+		(xTaskCreate(&writeBehindTask, "writeBehindTask", 8192, behind, 5, &behind->task) != pdPASS)) {
+		behind->task = NULL;
+		writeBehindEnd(behind);
+		return ESP_ERR_NO_MEM;
+	}
+	for (int n = 0; n < CONFIG_OTA_WRITE_BEHIND_BLOCKS; n++) {
+		uint8_t *data = behind->blocks + n * CONFIG_HTTPS_READ_BUFSIZE;
+		xQueueSend(behind->free, &data, 0);
+	}
+	return ESP_OK;
+}
+
+// a block of CONFIG_HTTPS_READ_BUFSIZE bytes to read into, waits while all are being written
+// NULL when the chain failed, writeBehindEnd returns why
+uint8_t *writeBehindGet(writeBehind_t *behind) {
+	uint8_t *data;
+
+	if (behind->err != ESP_OK)
+		return NULL;
+	if (xQueueReceive(behind->free, &data, 0) != pdTRUE) { // writer is behind
+		int64_t startTime = esp_timer_get_time();
+		xQueueReceive(behind->free, &data, portMAX_DELAY);
+		behind->stallUs += esp_timer_get_time() - startTime;
+	}
+	if (behind->err != ESP_OK) {
+		xQueueSend(behind->free, &data, 0);
+		return NULL;
+	}
+	return data;
+}
+
+// hands len bytes in block to the writer, len 0 returns the block unused
+void writeBehindPut(writeBehind_t *behind, uint8_t *block, int len) {
+	writeBehindBlock_t filled = {block, len};
+	xQueueSend(behind->filled, &filled, portMAX_DELAY);
+}
+
+// waits until the blocks put are written, stops the writer, returns the first error of the chain
+esp_err_t writeBehindEnd(writeBehind_t *behind) {
+	if (behind->task) {
+		writeBehindBlock_t end = {NULL, 0};
+		xQueueSend(behind->filled, &end, portMAX_DELAY);
+		xSemaphoreTake(behind->done, portMAX_DELAY); // last thing the writer touches
+	}
+	behind->task = NULL;
+	if (behind->free)
+		vQueueDelete(behind->free);
+	if (behind->filled)
+		vQueueDelete(behind->filled);
+	if (behind->done)
+		vSemaphoreDelete(behind->done);
+	free(behind->blocks);
+	behind->free = behind->filled = NULL;
+	behind->done = NULL;
+	behind->blocks = NULL;
+	return behind->err;
+}
@@ -0,0 +1,207 @@
+/*
+ * assetCache.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: dig
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+
+#include "assetCache.h"
+
+static const char *TAG = "assetCache";
+
+static assetEntry_t *head; // most recently used
+static assetEntry_t *tail; // evicted first
+static SemaphoreHandle_t cacheLock;
+static size_t used;
+static int nrEntries;
+static uint32_t hits, misses, evictions;
+static uint32_t generation; // counts invalidations, a read that saw one may hold the old file
+
+esp_err_t assetCacheInit(void) {
+	if (!cacheLock)
+		cacheLock = xSemaphoreCreateMutex();
+	return cacheLock ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+// cacheLock must be held for these
+static assetEntry_t *find(const char *path) {
+	for (assetEntry_t *entry = head; entry; entry = entry->next) {
+		if (strcmp(entry->path, path) == 0)
+			return entry;
+	}
+	return NULL;
+}
+
+static void unlinkEntry(assetEntry_t *entry) {
+	if (entry->prev)
+		entry->prev->next = entry->next;
+	else
+		head = entry->next;
+	if (entry->next)
+		entry->next->prev = entry->prev;
+	else
+		tail = entry->prev;
+	entry->prev = entry->next = NULL;
+}
+
+static void pushFront(assetEntry_t *entry) {
+	entry->prev = NULL;
+	entry->next = head;
+	if (head)
+		head->prev = entry;
+	head = entry;
+	if (!tail)
+		tail = entry;
+}
+
+// out of the cache, freed now or when the last request sending it is done
+// returns the entry when it is to be freed, after cacheLock is released
+static assetEntry_t *drop(assetEntry_t *entry) {
+	unlinkEntry(entry);
+	entry->cached = false;
+	used -= entry->size;
+	nrEntries--;
+	return (entry->refs == 0) ? entry : NULL;
+}
+
+// the cached file with a reference (assetCacheRelease), read from flash on a miss
+// NULL if the file is too large for the cache, can not be read or was changed while it was read
+assetEntry_t *assetCacheGet(const char *path, size_t size) {
+	assetEntry_t *entry;
+	uint32_t readGeneration;
+
+	if (!cacheLock || (size == 0) || (size > CONFIG_HTTP_ASSET_CACHE_MAX_FILE) || (size > CONFIG_HTTP_ASSET_CACHE_SIZE))
+		return NULL;
+	xSemaphoreTake(cacheLock, portMAX_DELAY);
+	entry = find(path);
+	if (entry) {
+		unlinkEntry(entry);
+		pushFront(entry);
+		entry->refs++;
+		hits++;
+	} else
+		misses++;
+	readGeneration = generation;
+	xSemaphoreGive(cacheLock);
+	if (entry)
+		return entry;
+
+	// path and data behind the entry, read without holding the cache
+	size_t pathLen = strlen(path) + 1;
+	entry = (assetEntry_t *)malloc(sizeof(assetEntry_t) + pathLen + size);
+	if (!entry)
+		return NULL;
+	char *entryPath = (char *)(entry + 1);
+	uint8_t *data = (uint8_t *)entryPath + pathLen;
+	memcpy(entryPath, path, pathLen);
+	FILE *fd = fopen(path, "r");
+	size_t len = fd ? fread(data, 1, size, fd) : 0;
+	if (fd)
+		fclose(fd);
+	if (len != size) {
+		ESP_LOGE(TAG, "Reading %s failed", path);
+		free(entry);
+		return NULL;
+	}
+	entry->path = entryPath;
+	entry->data = data;
+	entry->size = size;
+	entry->refs = 1;
+	entry->cached = true;
+
+	assetEntry_t *freeList = NULL; // evicted, freed after the lock
+	xSemaphoreTake(cacheLock, portMAX_DELAY);
+	if (generation != readGeneration) { // written, deleted or unmounted while read
+		xSemaphoreGive(cacheLock);
+		free(entry);
+		return NULL;
+	}
+	assetEntry_t *loaded = find(path); // by another request meanwhile
+	if (loaded) {
+		loaded->refs++;
+		xSemaphoreGive(cacheLock);
+		free(entry);
+		return loaded;
+	}
+	while (tail && (used + size > CONFIG_HTTP_ASSET_CACHE_SIZE)) {
+		assetEntry_t *evicted = drop(tail);
+		evictions++;
+		if (evicted) {
+			evicted->next = freeList;
+			freeList = evicted;
+		}
+	}
+	pushFront(entry);
+	used += size;
+	nrEntries++;
+	xSemaphoreGive(cacheLock);
+	while (freeList) {
+		assetEntry_t *next = freeList->next;
+		free(freeList);
+		freeList = next;
+	}
+	return entry;
+}
+
+void assetCacheRelease(assetEntry_t *entry) {
+	xSemaphoreTake(cacheLock, portMAX_DELAY);
+	bool last = (--entry->refs == 0) && !entry->cached;
+	xSemaphoreGive(cacheLock);
+	if (last)
+		free(entry);
+}
+
+// path was written or deleted
+void assetCacheInvalidate(const char *path) {
+	assetEntry_t *dropped = NULL;
+
+	if (!cacheLock)
+		return;
+	xSemaphoreTake(cacheLock, portMAX_DELAY);
+	generation++;
+	assetEntry_t *entry = find(path);
+	if (entry)
+		dropped = drop(entry);
+	xSemaphoreGive(cacheLock);
+	free(dropped);
+}
+
+// all files, eg another partition is mounted
+void assetCacheClear(void) {
+	if (!cacheLock)
+		return;
+	xSemaphoreTake(cacheLock, portMAX_DELAY);
+	generation++;
+	xSemaphoreGive(cacheLock);
+	while (true) {
+		assetEntry_t *dropped = NULL;
+		xSemaphoreTake(cacheLock, portMAX_DELAY);
+		bool empty = (head == NULL);
+		if (!empty)
+			dropped = drop(head);
+		xSemaphoreGive(cacheLock);
+		free(dropped);
+		if (empty)
+			break;
+	}
+}
+
+int assetCacheReport(char *pBuffer, int count) {
+	int len;
+
+	if (!cacheLock)
+		return snprintf(pBuffer, count, "asset cache off\n");
+	xSemaphoreTake(cacheLock, portMAX_DELAY);
+	len = snprintf(pBuffer, count, "hits %lu\nmisses %lu\nevictions %lu\nfiles %d\nbytes %u of %u\n", (unsigned long)hits, (unsigned long)misses,
+				   (unsigned long)evictions, nrEntries, (unsigned)used, (unsigned)CONFIG_HTTP_ASSET_CACHE_SIZE);
+	xSemaphoreGive(cacheLock);
+	return (len < count) ? len : count - 1;
+}
@@ -0,0 +1,160 @@
+/*
+ * caStore.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: dig
+ */
+
+#include <stdlib.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "mbedtls/ssl.h"
+#include "mbedtls/x509_crt.h"
+
+#include "caStore.h"
+
+static const char *TAG = "caStore";
+
+extern const char server_root_cert_pem_start[] asm("_binary_ca_cert_pem_start");
+extern const char server_root_cert_pem_end[] asm("_binary_ca_cert_pem_end");
+
+struct caStore {
+	mbedtls_x509_crt chain;
+	int refs;
+};
+
+#define HANDSHAKE_SLOTS 8 // tasks setting up a connection at the same time
+
+static caStore_t *current;			// used by new connections, holds a reference
+static SemaphoreHandle_t storeLock; // current, handshakes and the reference counts
+
+// the store of each connection being set up, caStoreAttach gets no context but runs in the task of esp_http_client_open
+static struct {
+	TaskHandle_t task;
+	caStore_t *store; // holds a reference
+} handshakes[HANDSHAKE_SLOTS];
+
+// cert: PEM (including the terminating 0) or DER, a chain of certificates
+static caStore_t *parse(const unsigned char *cert, size_t len) {
+	caStore_t *store = (caStore_t *)calloc(1, sizeof(caStore_t));
+	if (!store)
+		return NULL;
+	mbedtls_x509_crt_init(&store->chain);
+	int ret = mbedtls_x509_crt_parse(&store->chain, cert, len);
+	if ((ret < 0) || (store->chain.raw.p == NULL)) {
+		ESP_LOGE(TAG, "Parsing certificates failed (-0x%x)", (ret < 0) ? -ret : 0);
+		mbedtls_x509_crt_free(&store->chain);
+		free(store);
+		return NULL;
+	}
+	if (ret > 0) // the others are used
+		ESP_LOGW(TAG, "%d certificates could not be parsed", ret);
+	store->refs = 1;
+	return store;
+}
+
+// parses the certificate embedded in the firmware (server_certs/ca_cert.pem)
+esp_err_t caStoreInit(void) {
+	if (storeLock)
+		return ESP_OK;
+	storeLock = xSemaphoreCreateMutex();
+	current = parse((const unsigned char *)server_root_cert_pem_start, server_root_cert_pem_end - server_root_cert_pem_start);
+	return current ? ESP_OK : ESP_FAIL;
+}
+
+// replaces the certificates when they are rotated, the old ones are kept when cert does not parse
+esp_err_t caStoreReload(const unsigned char *cert, size_t len) {
+	caStore_t *store = parse(cert, len);
+	if (!store)
+		return ESP_FAIL;
+	xSemaphoreTake(storeLock, portMAX_DELAY);
+	caStore_t *old = current;
+	current = store;
+	xSemaphoreGive(storeLock);
+	caStoreRelease(old); // freed when no handshake uses it
+	ESP_LOGI(TAG, "Certificates reloaded");
+	return ESP_OK;
+}
+
+caStore_t *caStoreAcquire(void) {
+	caStore_t *store;
+
+	xSemaphoreTake(storeLock, portMAX_DELAY);
+	store = current;
+	if (store)
+		store->refs++;
+	xSemaphoreGive(storeLock);
+	return store;
+}
+
+void caStoreRelease(caStore_t *store) {
+	bool last;
+
+	if (!store)
+		return;
+	xSemaphoreTake(storeLock, portMAX_DELAY);
+	last = (--store->refs == 0);
+	xSemaphoreGive(storeLock);
+	if (last) {
+		mbedtls_x509_crt_free(&store->chain);
+		free(store);
+	}
+}
+
+// around esp_http_client_open, the certificates are only needed during the handshake
+// handshakes of several tasks run at the same time, the lock is only held to find the store
+void caStoreHandshakeBegin(void) {
+	TaskHandle_t task = xTaskGetCurrentTaskHandle();
+	int slot;
+
+	caStoreInit();
+	xSemaphoreTake(storeLock, portMAX_DELAY);
+	for (slot = 0; (slot < HANDSHAKE_SLOTS) && handshakes[slot].task; slot++)
+		;
+	if (slot < HANDSHAKE_SLOTS) {
+		handshakes[slot].task = task;
+		handshakes[slot].store = current;
+		if (current)
+			current->refs++;
+	}
+	xSemaphoreGive(storeLock);
+	if (slot == HANDSHAKE_SLOTS)
+		ESP_LOGE(TAG, "More than %d handshakes at a time", HANDSHAKE_SLOTS);
+}
+
+void caStoreHandshakeEnd(void) {
+	TaskHandle_t task = xTaskGetCurrentTaskHandle();
+	caStore_t *store = NULL;
+
+	xSemaphoreTake(storeLock, portMAX_DELAY);
+	for (int slot = 0; slot < HANDSHAKE_SLOTS; slot++) {
+		if (handshakes[slot].task == task) {
+			store = handshakes[slot].store;
+			handshakes[slot].task = NULL;
+			handshakes[slot].store = NULL;
+			break;
+		}
+	}
+	xSemaphoreGive(storeLock);
+	caStoreRelease(store);
+}
+
+// crt_bundle_attach of esp_http_client_config_t: the server is verified against the certificates of this handshake
+esp_err_t caStoreAttach(void *conf) {
+	TaskHandle_t task = xTaskGetCurrentTaskHandle();
+	caStore_t *store = NULL;
+
+	xSemaphoreTake(storeLock, portMAX_DELAY);
+	for (int slot = 0; slot < HANDSHAKE_SLOTS; slot++) {
+		if (handshakes[slot].task == task)
+			store = handshakes[slot].store;
+	}
+	xSemaphoreGive(storeLock);
+	if (!store) // no valid certificates
+		return ESP_FAIL;
+	mbedtls_ssl_conf_ca_chain((mbedtls_ssl_config *)conf, &store->chain, NULL); // kept alive by the slot until caStoreHandshakeEnd
+	return ESP_OK;
+}
@@ -17,6 +17,8 @@
 
 #include "../../main/include/settings.h"
 #include "../http/include/httpd.h"
+#include "../OTA/include/otaBenchmark.h"
+#include "assetCache.h"
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
@@ -42,7 +44,7 @@ const tCGI *g_pCGIs;
 int g_iNumCGIs;
 
 
-#define NUM_CGIurls 5
+#define NUM_CGIurls 6
 
 // http:/192.168.2.7///cgi-bin/getLogMeasValues
 
@@ -59,6 +61,8 @@ int getRTMeasValuesScript(char *pBuffer, int count);
 
 
 int actionRespScript(char *pBuffer, int count);
+int otaBenchmarkScript(char *pBuffer, int count);
+int assetCacheScript(char *pBuffer, int count);
 bool readActionScript(char *pcParam);
 
 int scriptState;
@@ -82,6 +86,8 @@ static const tCGI CGIurls[NUM_CGIurls] = {
 		{ "/action_page.php", (tCGIHandler_t) readCGIvalues,(CGIresponseFileHandler_t) actionRespScript },
 		{ "/cgi-bin/getLogMeasValues", (tCGIHandler_t) readCGIvalues, (CGIresponseFileHandler_t) getLogScript},
 		{ "/cgi-bin/getRTMeasValues", (tCGIHandler_t) readCGIvalues, (CGIresponseFileHandler_t) getRTMeasValuesScript},
+		{ "/cgi-bin/otaBenchmark", (tCGIHandler_t) readCGIvalues, (CGIresponseFileHandler_t) otaBenchmarkScript},  // ?start or ?start&flash
+		{ "/cgi-bin/assetCache", (tCGIHandler_t) readCGIvalues, (CGIresponseFileHandler_t) assetCacheScript},
 	//	{ "/cgi-bin/getAvgMeasValues", (tCGIHandler_t) readCGIvalues, (CGIresponseFileHandler_t) getAvgMeasValuesScript},
 
 };
@@ -115,6 +121,10 @@ const char* startCGIscript(int iIndex, char *pcParam) {
 		readActionScript(pcParam);
 		return ("/spiffs/dmm.html");
 		break;
+	case 4: // otaBenchmark, runs at the next poll of the update task
+		if (pcParam && strstr(pcParam, "start"))
+			otaBenchmarkStart(strstr(pcParam, "flash") != NULL);
+		break;
 
 	default:
 		todoIndex = iIndex;
@@ -234,6 +244,31 @@ int actionRespScript(char *pBuffer, int count) {
 	return nrChars;
 }
 
+// state of the ota benchmark, the results when done
+int otaBenchmarkScript(char *pBuffer, int count) {
+	int nrChars = 0;
+	switch (scriptState) {
+	case 0:
+		nrChars = sprintf(pBuffer, "%s", http_html_hdr);
+		nrChars += otaBenchmarkReport(pBuffer + nrChars, count - nrChars);
+		scriptState++;
+		break;
+	}
+	return nrChars;
+}
+
+int assetCacheScript(char *pBuffer, int count) {
+	int nrChars = 0;
+	switch (scriptState) {
+	case 0:
+		nrChars = sprintf(pBuffer, "%s", http_html_hdr);
+		nrChars += assetCacheReport(pBuffer + nrChars, count - nrChars);
+		scriptState++;
+		break;
+	}
+	return nrChars;
+}
+
 int readDescriptorsScript(char *pBuffer, int count) {
 	switch (scriptState) {
 	case 0:
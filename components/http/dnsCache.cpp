@@ -0,0 +1,268 @@
+/*
+ * dnsCache.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: dig
+ */
+
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_netif.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+#include "lwip/api.h"
+#include "lwip/dns.h"
+#include "lwip/sockets.h"
+#include "sdkconfig.h"
+
+#include "dnsCache.h"
+
+#if CONFIG_DNS_CACHE
+
+static const char *TAG = "dnsCache";
+
+#define DNS_PORT 53
+#define DNS_MSG_SIZE 512
+#define DNS_TIMEOUT_MS 2000
+#define DNS_RETRY_S 5 // after a failed refresh
+#define DNS_TYPE_A 1
+#define DNS_CLASS_IN 1
+
+typedef struct {
+	char host[DNS_HOST_SZ]; // empty: free
+	ip4_addr_t addr;
+	int64_t expires;   // us
+	int64_t refreshAt; // us
+	bool used;		   // looked up since the last refresh, only then it is refreshed
+} dnsEntry_t;
+
+static dnsEntry_t entries[DNS_CACHE_ENTRIES];
+static SemaphoreHandle_t cacheLock;
+static TaskHandle_t refreshTaskh;
+
+// returns the position after the name at pos, -1 if it does not fit in the message
+static int skipName(const uint8_t *msg, int len, int pos) {
+	while (pos < len) {
+		if (msg[pos] == 0)
+			return pos + 1;
+		if ((msg[pos] & 0xC0) == 0xC0) // pointer ends the name
+			return (pos + 2 <= len) ? pos + 2 : -1;
+		pos += msg[pos] + 1;
+	}
+	return -1;
+}
+
+// asks the dns server for the A record of host, ttl: the lowest of the records on the way (CNAMEs) in s
+// lwip does not pass the ttl, so the query is done here
+static esp_err_t query(const char *host, ip4_addr_t *addr, uint32_t *ttl) {
+	uint8_t msg[DNS_MSG_SIZE];
+	const ip_addr_t *server = dns_getserver(0);
+	int len = 0;
+
+	if (!server || !IP_IS_V4(server) || ip4_addr_isany(ip_2_ip4(server)))
+		return ESP_ERR_NOT_FOUND;
+	uint16_t id = esp_random();
+	const uint8_t header[12] = { (uint8_t)(id >> 8), (uint8_t)id, 0x01, 0x00, 0, 1, 0, 0, 0, 0, 0, 0 }; // recursion desired, 1 question
+	memcpy(msg, header, sizeof(header));
+	len = sizeof(header);
+	for (const char *label = host; *label;) {
+		size_t n = strcspn(label, ".");
+		if ((n == 0) || (n > 63) || (len + n + 6 > sizeof(msg)))
+			return ESP_ERR_INVALID_ARG;
+		msg[len++] = n;
+		memcpy(&msg[len], label, n);
+		len += n;
+		label += n;
+		if (*label == '.')
+			label++;
+	}
+	const uint8_t question[5] = { 0, 0, DNS_TYPE_A, 0, DNS_CLASS_IN };
+	memcpy(&msg[len], question, sizeof(question));
+	len += sizeof(question);
+
+	int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (sock < 0)
+		return ESP_FAIL;
+	struct timeval timeout = { .tv_sec = DNS_TIMEOUT_MS / 1000, .tv_usec = (DNS_TIMEOUT_MS % 1000) * 1000 };
+	setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+	struct sockaddr_in to = {};
+	to.sin_family = AF_INET;
+	to.sin_port = htons(DNS_PORT);
+	to.sin_addr.s_addr = ip_2_ip4(server)->addr;
+	if (sendto(sock, msg, len, 0, (struct sockaddr *)&to, sizeof(to)) != len)
+		len = -1;
+	else
+		len = recv(sock, msg, sizeof(msg), 0);
+	close(sock);
+
+	// id, a response, no error
+	if ((len < 12) || (msg[0] != (uint8_t)(id >> 8)) || (msg[1] != (uint8_t)id) || !(msg[2] & 0x80) || (msg[3] & 0x0F))
+		return ESP_ERR_NOT_FOUND;
+	int questions = (msg[4] << 8) | msg[5];
+	int answers = (msg[6] << 8) | msg[7];
+	int pos = 12;
+	for (int n = 0; (n < questions) && (pos >= 0); n++) {
+		pos = skipName(msg, len, pos);
+		if (pos >= 0)
+			pos += 4;
+	}
+	*ttl = UINT32_MAX;
+	for (int n = 0; (n < answers) && (pos >= 0); n++) {
+		pos = skipName(msg, len, pos);
+		if ((pos < 0) || (pos + 10 > len))
+			break;
+		int type = (msg[pos] << 8) | msg[pos + 1];
+		int cls = (msg[pos + 2] << 8) | msg[pos + 3];
+		uint32_t recordTtl = ((uint32_t)msg[pos + 4] << 24) | (msg[pos + 5] << 16) | (msg[pos + 6] << 8) | msg[pos + 7];
+		int rdLength = (msg[pos + 8] << 8) | msg[pos + 9];
+		pos += 10;
+		if (pos + rdLength > len)
+			break;
+		if (recordTtl < *ttl)
+			*ttl = recordTtl;
+		if ((type == DNS_TYPE_A) && (cls == DNS_CLASS_IN) && (rdLength == 4)) {
+			memcpy(&addr->addr, &msg[pos], 4);
+			return ESP_OK;
+		}
+		pos += rdLength;
+	}
+	return ESP_ERR_NOT_FOUND;
+}
+
+static dnsEntry_t *findEntry(const char *host) {
+	for (int n = 0; n < DNS_CACHE_ENTRIES; n++) {
+		if (strcmp(entries[n].host, host) == 0)
+			return &entries[n];
+	}
+	return NULL;
+}
+
+// cacheLock must be held
+static void storeEntry(const char *host, const ip4_addr_t *addr, uint32_t ttl) {
+	int64_t now = esp_timer_get_time();
+	dnsEntry_t *entry = findEntry(host);
+
+	if (!entry) { // a free one or the one that expires first
+		entry = &entries[0];
+		for (int n = 1; (n < DNS_CACHE_ENTRIES) && entry->host[0]; n++) {
+			if (!entries[n].host[0] || (entries[n].expires < entry->expires))
+				entry = &entries[n];
+		}
+		strlcpy(entry->host, host, sizeof(entry->host));
+	}
+	uint32_t prefetch = (ttl / 2 < CONFIG_DNS_CACHE_PREFETCH) ? ttl / 2 : CONFIG_DNS_CACHE_PREFETCH;
+	entry->addr = *addr;
+	entry->expires = now + (int64_t)ttl * 1000000;
+	entry->refreshAt = now + (int64_t)(ttl - prefetch) * 1000000;
+	entry->used = false;
+}
+
+// refreshes the addresses in use before they expire
+static void refreshTask(void *pvParameters) {
+	char host[DNS_HOST_SZ];
+	ip4_addr_t addr;
+	uint32_t ttl;
+
+	while (1) {
+		int64_t now = esp_timer_get_time();
+		int64_t next = INT64_MAX;
+		host[0] = 0;
+		xSemaphoreTake(cacheLock, portMAX_DELAY);
+		for (int n = 0; n < DNS_CACHE_ENTRIES; n++) {
+			if (entries[n].host[0] && entries[n].used && (entries[n].refreshAt < next)) {
+				next = entries[n].refreshAt;
+				if (next <= now)
+					strcpy(host, entries[n].host);
+			}
+		}
+		xSemaphoreGive(cacheLock);
+
+		if (host[0]) {
+			esp_err_t err = query(host, &addr, &ttl);
+			xSemaphoreTake(cacheLock, portMAX_DELAY);
+			dnsEntry_t *entry = findEntry(host);
+			if (err == ESP_OK) {
+				storeEntry(host, &addr, ttl);
+				ESP_LOGD(TAG, "%s refreshed, ttl %lu s", host, (unsigned long)ttl);
+			} else if (entry) { // again at the next lookup, not before DNS_RETRY_S
+				entry->refreshAt = now + DNS_RETRY_S * 1000000LL;
+				entry->used = false;
+				ESP_LOGW(TAG, "Refreshing %s failed", host);
+			}
+			xSemaphoreGive(cacheLock);
+			continue;
+		}
+		TickType_t wait = (next == INT64_MAX) ? portMAX_DELAY : pdMS_TO_TICKS((next - now) / 1000) + 1;
+		ulTaskNotifyTake(pdTRUE, wait);
+	}
+}
+
+esp_err_t dnsCacheInit(void) {
+	if (cacheLock)
+		return ESP_OK;
+	cacheLock = xSemaphoreCreateMutex();
+	if (!cacheLock || (xTaskCreate(refreshTask, "dnsCache", 3 * 1024, NULL, 2, &refreshTaskh) != pdPASS))
+		return ESP_FAIL;
+	return ESP_OK;
+}
+
+// called by lwip for every name lookup (netconn_gethostbyname), returns 1 with the address when it is handled here
+// 0: lwip resolves the name itself, eg ip addresses, mdns .local names, ipv6 or when the dns query here fails
+extern "C" int lwip_hook_netconn_external_resolve(const char *name, ip_addr_t *addr, u8_t addrtype, err_t *err) {
+	ip4_addr_t found;
+	ip_addr_t literal;
+	uint32_t ttl;
+	size_t len = strlen(name);
+
+	if (ipaddr_aton(name, &literal)) // the hook runs before lwip checks for an address, eg a lan peer url
+		return 0;
+	if (!cacheLock || (addrtype == NETCONN_DNS_IPV6) || (len >= DNS_HOST_SZ) || ((len > 6) && (strcasecmp(&name[len - 6], ".local") == 0)))
+		return 0;
+
+	int64_t now = esp_timer_get_time();
+	xSemaphoreTake(cacheLock, portMAX_DELAY);
+	dnsEntry_t *entry = findEntry(name);
+	if (entry && ((now < entry->expires) || CONFIG_DNS_CACHE_STALE)) {
+		found = entry->addr;
+		// the task plans the refresh of an entry that came into use, refreshes now when due
+		// also when expired: the stale address is used meanwhile
+		bool notify = !entry->used || (now >= entry->refreshAt);
+		entry->used = true;
+		xSemaphoreGive(cacheLock);
+		if (notify)
+			xTaskNotifyGive(refreshTaskh);
+		ip_addr_copy_from_ip4(*addr, found);
+		*err = ERR_OK;
+		return 1;
+	}
+	xSemaphoreGive(cacheLock);
+
+	if (query(name, &found, &ttl) != ESP_OK)
+		return 0;
+	xSemaphoreTake(cacheLock, portMAX_DELAY);
+	storeEntry(name, &found, ttl);
+	xSemaphoreGive(cacheLock);
+	ESP_LOGI(TAG, "%s: " IPSTR ", ttl %lu s", name, IP2STR(&found), (unsigned long)ttl);
+	ip_addr_copy_from_ip4(*addr, found);
+	*err = ERR_OK;
+	return 1;
+}
+
+#else
+
+esp_err_t dnsCacheInit(void) {
+	return ESP_OK;
+}
+
+#if CONFIG_LWIP_HOOK_NETCONN_EXT_RESOLVE_CUSTOM
+// lwip still calls the hook it is configured with, every name is left to it
+extern "C" int lwip_hook_netconn_external_resolve(const char *name, ip_addr_t *addr, u8_t addrtype, err_t *err) {
+	return 0;
+}
+#endif
+
+#endif
@@ -9,19 +9,32 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
 #include <sys/param.h>
 #include <sys/unistd.h>
 #include <sys/stat.h>
 #include <dirent.h>
 
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+
 #include "esp_err.h"
 #include "esp_log.h"
 
 #include "esp_vfs.h"
 #include "esp_spiffs.h"
 #include "esp_http_server.h"
+#include "esp_ota_ops.h"
+#include "esp_image_format.h"
 
+#include "assetCache.h"
 #include "cgiScripts.h"
+#include "../../main/include/storagePartition.h"
+#include "../../main/include/storageIndex.h"
+#include "../OTA/include/lanPeer.h"
+#include "../wifiConnect/include/wifiConnect.h"
 
 /* Max length a file path can have on storage */
 #define FILE_PATH_MAX (ESP_VFS_PATH_MAX + CONFIG_SPIFFS_OBJ_NAME_LEN)
@@ -42,16 +55,54 @@ void parseCGIWriteData(char *buf, int received);
 /* Scratch buffer size */
 #define SCRATCH_BUFSIZE  8192
 
+/* Time a request waits for a scratch buffer while all are in use */
+#define SCRATCH_WAIT_MS  5000
+
+/* An upload is received next to the file and renamed when complete */
+#define UPLOAD_TMP_EXT "~"
+
 struct file_server_data {
 	/* Base path of file storage */
 	char base_path[ESP_VFS_PATH_MAX + 1];
 
-	/* Scratch buffer for temporary storage during file transfer */
-	char scratch[SCRATCH_BUFSIZE];
+	/* Pool of CONFIG_HTTP_SCRATCH_BUFFERS scratch buffers, a request
+	 * leases one for temporary storage during file transfer */
+	QueueHandle_t scratch_pool;
 };
 
+/* A request handed to a worker task */
+typedef struct {
+	httpd_req_t *req;
+	esp_err_t (*handler)(httpd_req_t *req);
+} async_req_t;
+
+static QueueHandle_t async_req_queue;
+static SemaphoreHandle_t worker_ready_count;
+
+/* The cgi scripts keep their state in globals, one request runs them at a time */
+static SemaphoreHandle_t cgi_lock;
+
 static const char *TAG = "file_server";
 
+/* Takes a scratch buffer from the pool, waits while other requests use all of them.
+ * Without one the request is answered with 503 and NULL is returned */
+static char* scratch_lease(httpd_req_t *req) {
+	char *buf = NULL;
+
+	if (xQueueReceive(((struct file_server_data*) req->user_ctx)->scratch_pool, &buf, pdMS_TO_TICKS(SCRATCH_WAIT_MS)) != pdTRUE) {
+		ESP_LOGE(TAG, "No scratch buffer free");
+		httpd_resp_set_status(req, "503 Service Unavailable");
+		httpd_resp_set_hdr(req, "Retry-After", "1");
+		httpd_resp_send(req, NULL, 0);
+		return NULL;
+	}
+	return buf;
+}
+
+static void scratch_return(httpd_req_t *req, char *buf) {
+	xQueueSend(((struct file_server_data*) req->user_ctx)->scratch_pool, &buf, 0);
+}
+
 /* Handler to redirect incoming GET request for /index.html to /
  * This can be overridden by uploading file with same name */
 static esp_err_t index_html_get_handler(httpd_req_t *req) {
@@ -69,7 +120,8 @@ static esp_err_t favicon_get_handler(httpd_req_t *req) {
 	extern const unsigned char favicon_ico_end[] asm("_binary_favicon_ico_end");
 	const size_t favicon_ico_size = (favicon_ico_end - favicon_ico_start);
 	httpd_resp_set_type(req, "image/x-icon");
-	httpd_resp_send(req, (const char*) favicon_ico_start, favicon_ico_size);
+	/* No body for HEAD, only the length */
+	httpd_resp_send(req, (req->method == HTTP_HEAD) ? NULL : (const char*) favicon_ico_start, favicon_ico_size);
 	return ESP_OK;
 }
 
@@ -160,27 +212,105 @@ static esp_err_t http_resp_dir_html(httpd_req_t *req, const char *dirpath) {
 	return ESP_OK;
 }
 
-#define IS_FILE_EXT(filename, ext) \
-		(strcasecmp(&filename[strlen(filename) - sizeof(ext) + 1], ext) == 0)
-
 /* Set HTTP response content type according to file extension */
 static esp_err_t set_content_type_from_file(httpd_req_t *req, const char *filename) {
-	if (IS_FILE_EXT(filename, ".pdf")) {
-		return httpd_resp_set_type(req, "application/pdf");
-	} else if (IS_FILE_EXT(filename, ".html")) {
-		return httpd_resp_set_type(req, "text/html");
-	} else if (IS_FILE_EXT(filename, ".jpeg")) {
-		return httpd_resp_set_type(req, "image/jpeg");
-	} else if (IS_FILE_EXT(filename, ".ico")) {
-		return httpd_resp_set_type(req, "image/x-icon");
-	} else if (IS_FILE_EXT(filename, ".css")) {
-		return httpd_resp_set_type(req, "text/css");
-	} else if (IS_FILE_EXT(filename, ".js")) {
-		return httpd_resp_set_type(req, "text/javaScript");
-	}
-	/* This is a limited set only */
-	/* For any other type always set as plain text */
-	return httpd_resp_set_type(req, "text/plain");
+	return httpd_resp_set_type(req, storageContentType(filename));
+}
+
+/* Precompressed versions of a file (compressAssets.py), preferred first */
+static const struct {
+	const char *ext;
+	const char *coding;
+	uint8_t flag; // in storageFileInfo_t
+} encodings[] = { { ".br", "br", STORAGE_ENC_BR }, { ".gz", "gzip", STORAGE_ENC_GZ } };
+
+/* True if coding is in the Accept-Encoding list and not refused with q=0 */
+static bool accepts_encoding(const char *accept, const char *coding) {
+	size_t len = strlen(coding);
+	for (const char *p = strstr(accept, coding); p; p = strstr(p + len, coding)) {
+		if ((p != accept) && (p[-1] != ' ') && (p[-1] != ','))
+			continue;
+		const char *end = p + len;
+		while (*end == ' ')
+			end++;
+		if ((*end == 0) || (*end == ','))
+			return true;
+		float q = 1;
+		if (*end == ';' && (sscanf(end, "; q = %f", &q) == 1))
+			return q > 0;
+	}
+	return false;
+}
+
+/* Picks a precompressed version of filepath (info->encodings) the client accepts, appends its
+ * extension to filepath, updates info and returns the Content-Encoding, NULL if there is none */
+static const char* find_encoded_file(httpd_req_t *req, char *filepath, size_t size, storageFileInfo_t *info) {
+	char accept[64];
+	size_t len = strlen(filepath);
+
+	if (!info->encodings || (httpd_req_get_hdr_value_str(req, "Accept-Encoding", accept, sizeof(accept)) != ESP_OK))
+		return NULL;
+	for (int n = 0; n < sizeof(encodings) / sizeof(encodings[0]); n++) {
+		if (!(info->encodings & encodings[n].flag) || !accepts_encoding(accept, encodings[n].coding) || (len + strlen(encodings[n].ext) >= size))
+			continue;
+		strcpy(filepath + len, encodings[n].ext);
+		if (storageIndexFind(filepath, info))
+			return encodings[n].coding;
+		filepath[len] = 0;
+	}
+	return NULL;
+}
+
+/* Cache-Control per path, the first that matches ('*' at the start or end of the pattern)
+ * without max-age the browser asks each time, mostly answered with 304 Not Modified */
+static const struct {
+	const char *pattern;
+	const char *value;
+} cache_policies[] = {
+		{ "/images/*", "max-age=3600" },
+		{ "*.jpeg", "max-age=3600" },
+		{ "*.ico", "max-age=3600" },
+		{ "*", "no-cache" },
+};
+
+static const char* cache_control(const char *filename) {
+	size_t len = strlen(filename);
+	for (int n = 0; n < sizeof(cache_policies) / sizeof(cache_policies[0]); n++) {
+		const char *pattern = cache_policies[n].pattern;
+		size_t plen = strlen(pattern);
+		if ((pattern[0] == '*') ? ((len >= plen - 1) && (strcmp(filename + len - (plen - 1), pattern + 1) == 0)) :
+			(pattern[plen - 1] == '*') ? (strncmp(filename, pattern, plen - 1) == 0) : (strcmp(filename, pattern) == 0))
+			return cache_policies[n].value;
+	}
+	return "no-cache";
+}
+
+/* Validators of a file: the ETag changes with the storage version, size and modification time
+ * (an update of the storage image may keep both), and differs per encoding */
+static void file_validators(const storageFileInfo_t *info, const char *encoding, char *etag, size_t etag_size, char *last_modified, size_t lm_size) {
+	uint32_t version = 2166136261; // fnv-1a
+	for (const char *p = wifiSettings.SPIFFSversion; *p; p++)
+		version = (version ^ (uint8_t)*p) * 16777619;
+	snprintf(etag, etag_size, "\"%08lx-%lx-%llx%s%s\"", (unsigned long)version, (unsigned long)info->size,
+			(unsigned long long)info->mtime, encoding ? "-" : "", encoding ? encoding : "");
+	last_modified[0] = 0;
+	if (info->mtime > 1600000000) { // no clock when the file was written
+		struct tm tm;
+		gmtime_r(&info->mtime, &tm);
+		strftime(last_modified, lm_size, "%a, %d %b %Y %H:%M:%S GMT", &tm);
+	}
+}
+
+/* True if the copy of the client is still valid, If-None-Match goes before If-Modified-Since,
+ * which is compared as text: browsers send back the Last-Modified they got */
+static bool not_modified(httpd_req_t *req, const char *etag, const char *last_modified) {
+	char value[64];
+
+	if (httpd_req_get_hdr_value_str(req, "If-None-Match", value, sizeof(value)) == ESP_OK)
+		return (strstr(value, etag) != NULL) || (strcmp(value, "*") == 0);
+	if (last_modified[0] && (httpd_req_get_hdr_value_str(req, "If-Modified-Since", value, sizeof(value)) == ESP_OK))
+		return strcmp(value, last_modified) == 0;
+	return false;
 }
 
 /* Copies the full path into destination buffer and returns
@@ -215,12 +345,15 @@ static const char* get_path_from_uri(char *dest, const char *base_path, const ch
 static esp_err_t download_get_handler(httpd_req_t *req) {
 	char filepath[FILE_PATH_MAX];
 	FILE *fd = NULL;
-	struct stat file_stat;
+	storageFileInfo_t info;
 	char *params;
 	int i;
 	bool foundCGI = false;
 	bool sendFile = true;
+	bool cgiFile = false;
 	char *chunk;
+	char etag[48];
+	char last_modified[32];
 
 	char *filename = (char*) get_path_from_uri(filepath, ((struct file_server_data*) req->user_ctx)->base_path, req->uri, sizeof(filepath));
 	if (!filename) {
@@ -239,7 +372,7 @@ static esp_err_t download_get_handler(httpd_req_t *req) {
 	//    if (filename[strlen(filename) - 1] == '/') {
 	//        return http_resp_dir_html(req, filepath);
 	//    }
-	if (stat(filepath, &file_stat) == -1) {
+	if (!storageIndexFind(filepath, &info)) {
 		/* If file not present on SPIFFS check if URI
 		 * corresponds to one of the hardcoded paths */
 		if (strcmp(filename, "/index.html") == 0) {
@@ -247,6 +380,12 @@ static esp_err_t download_get_handler(httpd_req_t *req) {
 		} else if (strcmp(filename, "/favicon.ico") == 0) {
 			return favicon_get_handler(req);
 		}
+		/* A cgi is only run for GET */
+		if (req->method == HTTP_HEAD) {
+			httpd_resp_set_status(req, "404 Not Found");
+			httpd_resp_send(req, NULL, 0);
+			return ESP_OK;
+		}
 		/* First, isolate the base URI (without any parameters) */
 		// look for cgi
 		//	LWIP_DEBUGF(HTTPD_DEBUG, ("CGI Looking for %s \n", filename));
@@ -255,6 +394,7 @@ static esp_err_t download_get_handler(httpd_req_t *req) {
 			*params = '\0';
 			params++;
 		}
+		xSemaphoreTake(cgi_lock, portMAX_DELAY);
 		/* Does the base URI we have isolated correspond to a CGI handler? */
 		if (g_iNumCGIs && g_pCGIs) {
 			for (i = 0; i < g_iNumCGIs; i++) {
@@ -281,6 +421,7 @@ static esp_err_t download_get_handler(httpd_req_t *req) {
 			}
 		}
 		if (!foundCGI) {
+			xSemaphoreGive(cgi_lock);
 			ESP_LOGE(TAG, "Failed to stat file : %s", filepath);
 			/* Respond with 404 Not Found */
 			httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "File does not exist");
@@ -295,10 +436,14 @@ static esp_err_t download_get_handler(httpd_req_t *req) {
 		//	printf( "Sending CG responsefile : %s ...", filename);
 		sendFile = false;
 
-		if (stat(filename, &file_stat) == -1) {
+		if (!storageIndexFind(filename, &info)) {
 			// check cgiscript wants a file to be send as answer
-			/* Retrieve the pointer to scratch buffer for temporary storage */
-			chunk = ((struct file_server_data*) req->user_ctx)->scratch;
+			/* Lease a scratch buffer for temporary storage */
+			chunk = scratch_lease(req);
+			if (!chunk) {
+				xSemaphoreGive(cgi_lock);
+				return ESP_FAIL;
+			}
 			size_t chunksize;
 			do {
 				/* Read file in chunks into the scratch buffer */
@@ -309,6 +454,8 @@ static esp_err_t download_get_handler(httpd_req_t *req) {
 					if (httpd_resp_send_chunk(req, chunk, chunksize) != ESP_OK) {
 						//	if (httpd_send_all( req,(const char *) chunk,(size_t) chunksize) != ESP_OK) {
 						ESP_LOGE(TAG, "File sending failed!");
+						scratch_return(req, chunk);
+						xSemaphoreGive(cgi_lock);
 						/* Abort sending file */
 						httpd_resp_sendstr_chunk(req, NULL);
 						/* Respond with 500 Internal Server Error */
@@ -319,13 +466,48 @@ static esp_err_t download_get_handler(httpd_req_t *req) {
 
 				/* Keep looping till the whole file is sent */
 			} while (chunksize != 0);
+			scratch_return(req, chunk);
 		} else {
 			strcpy(filepath, filename);
 			sendFile = true;
+			cgiFile = true;
 		}
+		xSemaphoreGive(cgi_lock);
 		foundCGI = false;
 	}
 	if (sendFile) { // read from file
+		httpd_resp_set_type(req, info.contentType);
+		const char *cache = cache_control(filename);
+		/* After the type, the name gets the extension of the compressed file */
+		const char *encoding = find_encoded_file(req, filepath, sizeof(filepath), &info);
+		if (encoding) {
+			httpd_resp_set_hdr(req, "Content-Encoding", encoding);
+			httpd_resp_set_hdr(req, "Vary", "Accept-Encoding");
+		}
+		if (!cgiFile) { // an answer of a cgi is not cached
+			file_validators(&info, encoding, etag, sizeof(etag), last_modified, sizeof(last_modified));
+			httpd_resp_set_hdr(req, "ETag", etag);
+			if (last_modified[0])
+				httpd_resp_set_hdr(req, "Last-Modified", last_modified);
+			httpd_resp_set_hdr(req, "Cache-Control", cache);
+			if (not_modified(req, etag, last_modified)) { // without opening the file
+				httpd_resp_set_status(req, "304 Not Modified");
+				httpd_resp_send(req, NULL, 0);
+				return ESP_OK;
+			}
+		}
+		if (req->method == HTTP_HEAD) { // headers only, with the length
+			httpd_resp_send(req, NULL, info.size);
+			return ESP_OK;
+		}
+		if (!cgiFile) { // small files from RAM
+			assetEntry_t *asset = assetCacheGet(filepath, info.size);
+			if (asset) {
+				esp_err_t err = httpd_resp_send(req, (const char*) asset->data, asset->size);
+				assetCacheRelease(asset);
+				return err;
+			}
+		}
 		fd = fopen(filepath, "r");
 		if (!fd) {
 			ESP_LOGE(TAG, "Failed to read existing file : %s", filepath);
@@ -335,10 +517,13 @@ static esp_err_t download_get_handler(httpd_req_t *req) {
 		}
 
 		//	ESP_LOGI(TAG, "Sending file : %s (%ld bytes)...", filename, file_stat.st_size);
-		set_content_type_from_file(req, filename);
 
-		/* Retrieve the pointer to scratch buffer for temporary storage */
-		chunk = ((struct file_server_data*) req->user_ctx)->scratch;
+		/* Lease a scratch buffer for temporary storage */
+		chunk = scratch_lease(req);
+		if (!chunk) {
+			fclose(fd);
+			return ESP_FAIL;
+		}
 		size_t chunksize;
 		do {
 			/* Read file in chunks into the scratch buffer */
@@ -348,6 +533,7 @@ static esp_err_t download_get_handler(httpd_req_t *req) {
 				/* Send the buffer contents as HTTP response chunk */
 				if (httpd_resp_send_chunk(req, chunk, chunksize) != ESP_OK) {
 					fclose(fd);
+					scratch_return(req, chunk);
 					ESP_LOGE(TAG, "File sending failed!");
 					/* Abort sending file */
 					httpd_resp_sendstr_chunk(req, NULL);
@@ -362,8 +548,9 @@ static esp_err_t download_get_handler(httpd_req_t *req) {
 
 		/* Close file after sending complete */
 		fclose(fd);
+		scratch_return(req, chunk);
 	}
-	ESP_LOGI(TAG, "File sending complete %s (%ld bytes)", filename, file_stat.st_size);
+	ESP_LOGI(TAG, "File sending complete %s", filename);
 
 	/* Respond with an empty chunk to signal HTTP response completion */
 	httpd_resp_send_chunk(req, NULL, 0);
@@ -372,6 +559,7 @@ static esp_err_t download_get_handler(httpd_req_t *req) {
 static esp_err_t upload_post_handler(httpd_req_t *req) {
 	bool isCGIWrite = false;
 	char filepath[FILE_PATH_MAX];
+	char tmppath[FILE_PATH_MAX + sizeof(UPLOAD_TMP_EXT)];
 	//const char filepath[] = {"/spiffs/descriptors.dmm"}; // fixed filename
 	FILE *fd = NULL;
 	struct stat file_stat;
@@ -413,10 +601,11 @@ static esp_err_t upload_post_handler(httpd_req_t *req) {
 	if (strncmp(filename, "/cgi-bin/", 9) == 0)
 		isCGIWrite = true;  // klp use POST also for cgi-write commands
 	else {
-
-		fd = fopen(filepath, "w");
+		/* Requests for the file get the old one until the upload is complete */
+		snprintf(tmppath, sizeof(tmppath), "%s" UPLOAD_TMP_EXT, filepath);
+		fd = fopen(tmppath, "w");
 		if (!fd) {
-			ESP_LOGE(TAG, "Failed to create file : %s", filepath);
+			ESP_LOGE(TAG, "Failed to create file : %s", tmppath);
 			/* Respond with 500 Internal Server Error */
 			httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to create file");
 			return ESP_FAIL;
@@ -425,8 +614,15 @@ static esp_err_t upload_post_handler(httpd_req_t *req) {
 	ESP_LOGI(TAG, "Receiving file : %s...", filepath);
 //	printf("Receiving file : %s...", filepath);
 
-	/* Retrieve the pointer to scratch buffer for temporary storage */
-	char *buf = ((struct file_server_data*) req->user_ctx)->scratch;
+	/* Lease a scratch buffer for temporary storage */
+	char *buf = scratch_lease(req);
+	if (!buf) {
+		if (!isCGIWrite) {
+			fclose(fd);
+			unlink(tmppath);
+		}
+		return ESP_FAIL;
+	}
 	int received;
 
 	/* Content length of the request gives
@@ -443,12 +639,13 @@ static esp_err_t upload_post_handler(httpd_req_t *req) {
 				/* Retry if timeout occurred */
 				continue;
 			}
+			scratch_return(req, buf);
 
 			/* In case of unrecoverable error,
 			 * close and delete the unfinished file*/
 			if (!isCGIWrite) {
 				fclose(fd);
-				unlink(filepath);
+				unlink(tmppath);
 			}
 
 			ESP_LOGE(TAG, "File reception failed!");
@@ -463,13 +660,16 @@ static esp_err_t upload_post_handler(httpd_req_t *req) {
 		if (isCGIWrite) {
 			if (received < SCRATCH_BUFSIZE)
 				buf[received] = 0;
+			xSemaphoreTake(cgi_lock, portMAX_DELAY);
 			parseCGIWriteData(buf, received);
+			xSemaphoreGive(cgi_lock);
 		} else {
 			if (received && (received != fwrite(buf, 1, received, fd))) {
 				/* Couldn't write everything to file!
 				 * Storage may be full? */
+				scratch_return(req, buf);
 				fclose(fd);
-				unlink(filepath);
+				unlink(tmppath);
 
 				ESP_LOGE(TAG, "File write failed!");
 				/* Respond with 500 Internal Server Error */
@@ -481,10 +681,27 @@ static esp_err_t upload_post_handler(httpd_req_t *req) {
 		 * the file left to be uploaded */
 		remaining -= received;
 	}
+	scratch_return(req, buf);
 
-	/* Close file upon upload completion */
-	if (!isCGIWrite)
+	/* Close file upon upload completion and replace the old one,
+	 * with the storage locked alone so no request is reading it */
+	if (!isCGIWrite) {
 		fclose(fd);
+		storageUnshare();
+		storageLock();
+		unlink(filepath);
+		int renamed = rename(tmppath, filepath);
+		storageIndexUpdate(filepath);
+		storageUnlock();
+		storageShare();
+		if (renamed != 0) {
+			unlink(tmppath);
+			ESP_LOGE(TAG, "Failed to replace file : %s", filepath);
+			/* Respond with 500 Internal Server Error */
+			httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to write file to storage");
+			return ESP_FAIL;
+		}
+	}
 	ESP_LOGI(TAG, "File reception complete");
 //	printf( "File reception complete");
 	/* Redirect onto root to see the updated file list */
@@ -537,8 +754,10 @@ static esp_err_t put_handler(httpd_req_t *req) {
 	ESP_LOGI(TAG, "Receiving PUT req");
 //	printf("Receiving file : %s...", filepath);
 
-	/* Retrieve the pointer to scratch buffer for temporary storage */
-	char *buf = ((struct file_server_data*) req->user_ctx)->scratch;
+	/* Lease a scratch buffer for temporary storage */
+	char *buf = scratch_lease(req);
+	if (!buf)
+		return ESP_FAIL;
 	int received;
 
 	/* Content length of the request gives
@@ -555,6 +774,7 @@ static esp_err_t put_handler(httpd_req_t *req) {
 				/* Retry if timeout occurred */
 				continue;
 			}
+			scratch_return(req, buf);
 			ESP_LOGE(TAG, "File reception failed!");
 			/* Respond with 500 Internal Server Error */
 			httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to receive file");
@@ -579,6 +799,7 @@ static esp_err_t put_handler(httpd_req_t *req) {
 		 * the file left to be uploaded */
 		remaining -= received;
 	}
+	scratch_return(req, buf);
 	ESP_LOGI(TAG, "PUI reception complete");
 //	printf( "File reception complete");
 	/* Redirect onto root to see the updated file list */
@@ -591,7 +812,7 @@ static esp_err_t put_handler(httpd_req_t *req) {
 /* Handler to delete a file from the server */
 static esp_err_t delete_post_handler(httpd_req_t *req) {
 	char filepath[FILE_PATH_MAX];
-	struct stat file_stat;
+	storageFileInfo_t info;
 
 	/* Skip leading "/delete" from URI to get filename */
 	/* Note sizeof() counts NULL termination hence the -1 */
@@ -609,7 +830,7 @@ static esp_err_t delete_post_handler(httpd_req_t *req) {
 		return ESP_FAIL;
 	}
 
-	if (stat(filepath, &file_stat) == -1) {
+	if (!storageIndexFind(filepath, &info)) {
 		ESP_LOGE(TAG, "File does not exist : %s", filename);
 		/* Respond with 400 Bad Request */
 		httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "File does not exist");
@@ -619,6 +840,7 @@ static esp_err_t delete_post_handler(httpd_req_t *req) {
 	ESP_LOGI(TAG, "Deleting file : %s", filename);
 	/* Delete file */
 	unlink(filepath);
+	storageIndexRemove(filepath);
 
 	/* Redirect onto root to see the updated file list */
 	httpd_resp_set_status(req, "303 See Other");
@@ -627,6 +849,137 @@ static esp_err_t delete_post_handler(httpd_req_t *req) {
 	return ESP_OK;
 }
 
+#if CONFIG_OTA_LAN_PEERS
+/* Handler to send the running firmware to a device on the lan updating to this version,
+ * the image as it was flashed, so it matches the sha256 in the manifest */
+static esp_err_t ota_firmware_get_handler(httpd_req_t *req) {
+	static uint32_t imageLen; // found once, the running image does not change
+	const esp_partition_t *running = esp_ota_get_running_partition();
+
+	if (imageLen == 0) {
+		esp_partition_pos_t pos = { .offset = running->address, .size = running->size };
+		esp_image_metadata_t metadata;
+		if (esp_image_verify(ESP_IMAGE_VERIFY_SILENT, &pos, &metadata) != ESP_OK) {
+			httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Running image not valid");
+			return ESP_FAIL;
+		}
+		imageLen = metadata.image_len;
+	}
+	httpd_resp_set_type(req, "application/octet-stream");
+
+	char *chunk = scratch_lease(req);
+	if (!chunk)
+		return ESP_FAIL;
+	for (uint32_t offset = 0; offset < imageLen; offset += SCRATCH_BUFSIZE) {
+		size_t chunksize = MIN(SCRATCH_BUFSIZE, imageLen - offset);
+		if ((esp_partition_read(running, offset, chunk, chunksize) != ESP_OK) || (httpd_resp_send_chunk(req, chunk, chunksize) != ESP_OK)) {
+			scratch_return(req, chunk);
+			ESP_LOGE(TAG, "Firmware sending failed!");
+			httpd_resp_sendstr_chunk(req, NULL);
+			return ESP_FAIL;
+		}
+	}
+	scratch_return(req, chunk);
+	ESP_LOGI(TAG, "Firmware sent to peer (%lu bytes)", (unsigned long)imageLen);
+	httpd_resp_send_chunk(req, NULL, 0);
+	return ESP_OK;
+}
+#endif
+
+/* Handlers using files share the storage, it is not switched to the
+ * other partition while they run (see storagePartition.h) */
+static esp_err_t storage_shared_handler(httpd_req_t *req, esp_err_t (*handler)(httpd_req_t *req)) {
+	storageShare();
+	esp_err_t err = handler(req);
+	storageUnshare();
+	return err;
+}
+
+static esp_err_t download_shared_handler(httpd_req_t *req) {
+	return storage_shared_handler(req, download_get_handler);
+}
+
+static esp_err_t upload_shared_handler(httpd_req_t *req) {
+	return storage_shared_handler(req, upload_post_handler);
+}
+
+/* No request reads the file meanwhile, waits until the requests sharing the storage are done */
+static esp_err_t delete_locked_handler(httpd_req_t *req) {
+	storageLock();
+	esp_err_t err = delete_post_handler(req);
+	storageUnlock();
+	return err;
+}
+
+/* Worker task, runs the requests handed over by the server task */
+static void worker_task(void *p) {
+	async_req_t async_req;
+
+	while (true) {
+		/* Signal a worker is ready to accept a request */
+		xSemaphoreGive(worker_ready_count);
+		if (xQueueReceive(async_req_queue, &async_req, portMAX_DELAY) == pdTRUE) {
+			if (async_req.handler(async_req.req) != ESP_OK) {
+				/* As the server task does after a failed handler */
+				httpd_sess_trigger_close(async_req.req->handle, httpd_req_to_sockfd(async_req.req));
+			}
+			httpd_req_async_handler_complete(async_req.req);
+		}
+	}
+}
+
+/* Hands the request to a free worker task, so a slow client does not hold up
+ * the server task and the other clients. Without a free worker the request
+ * runs in the server task, as it did without workers */
+static esp_err_t submit_to_worker(httpd_req_t *req, esp_err_t (*handler)(httpd_req_t *req)) {
+	httpd_req_t *copy = NULL;
+
+	if (!worker_ready_count || (xSemaphoreTake(worker_ready_count, 0) != pdTRUE))
+		return handler(req);
+	if (httpd_req_async_handler_begin(req, &copy) != ESP_OK) {
+		xSemaphoreGive(worker_ready_count);
+		return handler(req);
+	}
+	async_req_t async_req = { .req = copy, .handler = handler };
+	/* The worker taken above is waiting on the queue */
+	xQueueSend(async_req_queue, &async_req, portMAX_DELAY);
+	return ESP_OK;
+}
+
+static esp_err_t download_async_handler(httpd_req_t *req) {
+	return submit_to_worker(req, download_shared_handler);
+}
+
+static esp_err_t upload_async_handler(httpd_req_t *req) {
+	return submit_to_worker(req, upload_shared_handler);
+}
+
+static esp_err_t delete_async_handler(httpd_req_t *req) {
+	return submit_to_worker(req, delete_locked_handler);
+}
+
+static esp_err_t put_async_handler(httpd_req_t *req) {
+	return submit_to_worker(req, put_handler);
+}
+
+#if CONFIG_OTA_LAN_PEERS
+static esp_err_t ota_firmware_async_handler(httpd_req_t *req) {
+	return submit_to_worker(req, ota_firmware_get_handler);
+}
+#endif
+
+/* Starts CONFIG_HTTP_WORKERS worker tasks with the stack and priority of the server task */
+static void start_workers(const httpd_config_t *config) {
+	if (CONFIG_HTTP_WORKERS == 0)
+		return;
+	async_req_queue = xQueueCreate(CONFIG_HTTP_WORKERS, sizeof(async_req_t));
+	worker_ready_count = xSemaphoreCreateCounting(CONFIG_HTTP_WORKERS, 0);
+	for (int n = 0; n < CONFIG_HTTP_WORKERS; n++) {
+		if (xTaskCreate(worker_task, "httpdWorker", config->stack_size, NULL, config->task_priority, NULL) != pdPASS)
+			ESP_LOGE(TAG, "Failed to start worker %d", n);
+	}
+}
+
 /* Function to start the file server */
 esp_err_t start_file_server(const char *base_path) {
 	static struct file_server_data *server_data = NULL;
@@ -649,6 +1002,24 @@ esp_err_t start_file_server(const char *base_path) {
 		return ESP_ERR_NO_MEM;
 	}
 	strlcpy(server_data->base_path, base_path, sizeof(server_data->base_path));
+	if (CONFIG_HTTP_ASSET_CACHE_SIZE > 0)
+		assetCacheInit();
+
+	/* Allocate the scratch buffers once, heap use does not grow with the clients */
+	server_data->scratch_pool = xQueueCreate(CONFIG_HTTP_SCRATCH_BUFFERS, sizeof(char*));
+	for (int n = 0; server_data->scratch_pool && (n < CONFIG_HTTP_SCRATCH_BUFFERS); n++) {
+		char *buf = (char*) malloc(SCRATCH_BUFSIZE);
+		if (!buf) {
+			ESP_LOGE(TAG, "Failed to allocate memory for scratch buffer");
+			break;
+		}
+		xQueueSend(server_data->scratch_pool, &buf, 0);
+	}
+	cgi_lock = xSemaphoreCreateMutex();
+	if (!server_data->scratch_pool || !uxQueueMessagesWaiting(server_data->scratch_pool) || !cgi_lock) {
+		ESP_LOGE(TAG, "Failed to allocate memory for server data");
+		return ESP_ERR_NO_MEM;
+	}
 
 	httpd_handle_t server = NULL;
 	httpd_config_t config = HTTPD_DEFAULT_CONFIG();
@@ -663,28 +1034,43 @@ esp_err_t start_file_server(const char *base_path) {
 		ESP_LOGE(TAG, "Failed to start file server!");
 		return ESP_FAIL;
 	}
+	start_workers(&config);
+
+#if CONFIG_OTA_LAN_PEERS
+	/* URI handler for the running firmware, before the match all handler */
+	httpd_uri_t ota_firmware = { .uri = LAN_PEER_FIRMWARE_PATH,
+			.method = HTTP_GET, .handler = ota_firmware_async_handler, .user_ctx = server_data
+			};
+	httpd_register_uri_handler(server, &ota_firmware);
+#endif
 
 	/* URI handler for getting uploaded files */
 	httpd_uri_t file_download = { .uri = "/*",  // Match all URIs of type /path/to/file
-			.method = HTTP_GET, .handler = download_get_handler, .user_ctx = server_data    // Pass server data as context
+			.method = HTTP_GET, .handler = download_async_handler, .user_ctx = server_data    // Pass server data as context
 			};
 	httpd_register_uri_handler(server, &file_download);
 
+	/* URI handler for the headers of files, the same as for getting them */
+	httpd_uri_t file_head = { .uri = "/*",
+			.method = HTTP_HEAD, .handler = download_async_handler, .user_ctx = server_data
+			};
+	httpd_register_uri_handler(server, &file_head);
+
 	/* URI handler for uploading files to server */
 	httpd_uri_t file_upload = { .uri = "/upload/*",   // Match all URIs of type /upload/path/to/file
-			.method = HTTP_POST, .handler = upload_post_handler, .user_ctx = server_data    // Pass server data as context
+			.method = HTTP_POST, .handler = upload_async_handler, .user_ctx = server_data    // Pass server data as context
 			};
 	httpd_register_uri_handler(server, &file_upload);
 
 	/* URI handler for PUT request from client */
 	httpd_uri_t uri_put = { .uri = "/*",   // Match all URIs of type
-			.method = HTTP_PUT, .handler = put_handler, .user_ctx = server_data    // Pass server data as context
+			.method = HTTP_PUT, .handler = put_async_handler, .user_ctx = server_data    // Pass server data as context
 			};
 	httpd_register_uri_handler(server, &uri_put);
 
 	/* URI handler for deleting files from server */
 	httpd_uri_t file_delete = { .uri = "/delete/*",   // Match all URIs of type /delete/path/to/file
-			.method = HTTP_POST, .handler = delete_post_handler, .user_ctx = server_data    // Pass server data as context
+			.method = HTTP_POST, .handler = delete_async_handler, .user_ctx = server_data    // Pass server data as context
 			};
 	httpd_register_uri_handler(server, &file_delete);
 
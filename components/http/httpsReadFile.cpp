@@ -3,36 +3,38 @@
 #include <string.h>
 
 #include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 #include "freertos/task.h"
 
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "lwip/err.h"
+#include "lwip/netdb.h"
+#include "lwip/sockets.h"
 
 #include "esp_tls.h"
 #include "sdkconfig.h"
-#if CONFIG_MBEDTLS_CERTIFICATE_BUNDLE
-#include "esp_crt_bundle.h"
-#endif
 #include "esp_event.h"
 #include <sys/param.h>
 #include <ctype.h>
 #include "esp_system.h"
 
 #include "esp_http_client.h"
+#include "caStore.h"
 #include "httpsReadFile.h"
 
 
 static const char *TAG = "httpsReadFile";
 
-extern const char server_root_cert_pem_start[] asm("_binary_ca_cert_pem_start");
-extern const char server_root_cert_pem_end[] asm("_binary_ca_cert_pem_end");
+#ifndef CONFIG_OTA_RECV_TIMEOUT
+#define CONFIG_OTA_RECV_TIMEOUT 5000
+#endif
 
-QueueHandle_t httpsReqMssgBox;
-QueueHandle_t httpsReqRdyMssgBox;
 #define MAX_HTTP_RECV_BUFFER 512
 #define MAX_HTTP_OUTPUT_BUFFER 2048
 
-uint8_t buf[HTTPSBUFSIZE];
+static esp_http_client_handle_t sessionClient; // NULL: a client per request
+static SemaphoreHandle_t sessionLock;			// held by the request using sessionClient, others get a client of their own
 
 esp_err_t _http_event_handler(esp_http_client_event_t *evt)
 {
@@ -129,111 +131,308 @@ esp_err_t _http_event_handler(esp_http_client_event_t *evt)
 }
 
 
-int httpsReadFile(char *url, char *dest, int maxChars) {
-	int read_len =0, content_length, status;
+// collects the validators of the response
+static esp_err_t validatorEventHandler(esp_http_client_event_t *evt) {
+	httpsValidator_t *validator = (httpsValidator_t *)evt->user_data;
+	if ((evt->event_id == HTTP_EVENT_ON_HEADER) && validator) {
+		if (strcasecmp(evt->header_key, "ETag") == 0)
+			strlcpy(validator->eTag, evt->header_value, sizeof(validator->eTag));
+		else if (strcasecmp(evt->header_key, "Last-Modified") == 0)
+			strlcpy(validator->lastModified, evt->header_value, sizeof(validator->lastModified));
+	}
+	return ESP_OK;
+}
+
+// records when the steps of a timed request end, httpsReaderOpen makes durations of them
+static esp_err_t timingEventHandler(esp_http_client_event_t *evt) {
+	httpsTiming_t *timing = (httpsTiming_t *)evt->user_data;
+	int64_t now = esp_timer_get_time();
+
+	if (evt->event_id == HTTP_EVENT_ON_CONNECTED)
+		timing->connectUs = now;
+	else if (evt->event_id == HTTP_EVENT_HEADER_SENT)
+		timing->requestUs = now;
+	else if ((evt->event_id == HTTP_EVENT_ON_HEADER) && (timing->ttfbUs == 0))
+		timing->ttfbUs = now;
+	return ESP_OK;
+}
 
+// a client of its own for one request
+static esp_http_client_handle_t clientNew(char *url, http_event_handle_cb handler, void *userData) {
 	esp_http_client_config_t config = {
-		.url = url, 
-        .cert_pem = server_root_cert_pem_start,
-		
+		.url = url,
+		.timeout_ms = CONFIG_OTA_RECV_TIMEOUT,
+		.event_handler = handler,
+		.user_data = userData,
+		.crt_bundle_attach = caStoreAttach, // the certificates parsed once
 	};
+	return esp_http_client_init(&config);
+}
 
-	esp_http_client_handle_t client = esp_http_client_init(&config);
+// a client for url, the session client when a session is open and no other request uses it
+static esp_http_client_handle_t clientInit(char *url, void *userData) {
+	if (sessionClient && (xSemaphoreTake(sessionLock, 0) == pdTRUE)) {
+		if (sessionClient) {
+			esp_http_client_set_url(sessionClient, url); // closes the connection when the host changes
+			esp_http_client_set_user_data(sessionClient, userData);
+			esp_http_client_delete_header(sessionClient, "Range");
+			esp_http_client_delete_header(sessionClient, "If-None-Match");
+			esp_http_client_delete_header(sessionClient, "If-Modified-Since");
+			return sessionClient;
+		}
+		xSemaphoreGive(sessionLock);
+	}
+	return clientNew(url, validatorEventHandler, userData);
+}
+
+// sends the request and reads the response headers, returns the content length or < 0 on error
+// the connection kept by a session may have been closed by the server in the meantime, then it is reopened once
+static int clientStart(esp_http_client_handle_t client) {
 	esp_err_t err;
-	if ((err = esp_http_client_open(client, 0)) != ESP_OK) {
-		ESP_LOGE(TAG, "Failed to open HTTP connection: %s", esp_err_to_name(err));
+	int content_length = -1;
+	for (int attempt = 0; attempt < ((client == sessionClient) ? 2 : 1); attempt++) {
+		if (attempt > 0) {
+			ESP_LOGI(TAG, "Reconnecting");
+			esp_http_client_close(client);
+		}
+		caStoreHandshakeBegin();
+		err = esp_http_client_open(client, 0);
+		caStoreHandshakeEnd();
+		if (err != ESP_OK) {
+			ESP_LOGE(TAG, "Failed to open HTTP connection: %s", esp_err_to_name(err));
+			continue;
+		}
+		content_length = esp_http_client_fetch_headers(client);
+		if ((content_length >= 0) || (esp_http_client_get_status_code(client) > 0))
+			return content_length;
+	}
+	return -1;
+}
+
+// ends a request, a session keeps the connection when the response is read completely
+static void clientDone(esp_http_client_handle_t client, bool complete) {
+	if (client != sessionClient) {
+		esp_http_client_close(client);
+		esp_http_client_cleanup(client);
+		return;
+	}
+	if (!complete || (esp_http_client_flush_response(client, NULL) != ESP_OK))
+		esp_http_client_close(client);
+	xSemaphoreGive(sessionLock);
+}
+
+int httpsReadFile(char *url, char *dest, int maxChars) {
+	return httpsReadFile(url, dest, maxChars, NULL);
+}
+
+// reads a small file into dest
+// with validator the request is conditional: HTTPS_NOT_MODIFIED is returned when the file did not change,
+// else validator is updated from the response
+int httpsReadFile(char *url, char *dest, int maxChars, httpsValidator_t *validator) {
+	int read_len =0, content_length, status;
+	httpsValidator_t newValidator = {};
+
+	esp_http_client_handle_t client = clientInit(url, validator ? &newValidator : NULL);
+	if (validator) {
+		if (validator->eTag[0])
+			esp_http_client_set_header(client, "If-None-Match", validator->eTag);
+		if (validator->lastModified[0])
+			esp_http_client_set_header(client, "If-Modified-Since", validator->lastModified);
+	}
+	content_length = clientStart(client);
+	status = esp_http_client_get_status_code(client);
+	if (status <= 0) {
+		clientDone(client, false);
 		return -1;
 	}
-	content_length = esp_http_client_fetch_headers(client);
+	if (status == 304) { // no body
+		ESP_LOGD(TAG, "%s not modified", url);
+		clientDone(client, true);
+		return HTTPS_NOT_MODIFIED;
+	}
 	read_len = esp_http_client_read(client, dest, maxChars);
 
-	status = esp_http_client_get_status_code(client);
 	ESP_LOGI(TAG, "HTTP Stream reader Status = %d, content_length = %" PRId64,
              status, esp_http_client_get_content_length(client));
 
 	if (content_length > maxChars) 
         read_len = -1;
 	if ((status > 300) || (status < 200))
-	    read_len = -1;
+	    read_len = (status == 404) ? HTTPS_NOT_FOUND : -1;
 
 	if ( read_len < 0 )
 		*dest = 0;
+	if (validator)
+		*validator = (read_len >= 0) ? newValidator : httpsValidator_t{};
 
-	esp_http_client_close(client);
-	esp_http_client_cleanup(client);
+	clientDone(client, content_length <= maxChars);
 	return read_len;
 }
 
-int httpsReadFile(const httpsRegParams_t *httpsRegParams) {
-	httpsMssg_t mssg;
-	int read_len = 0, total_read_len = 0, content_length, status;
+esp_err_t httpsReaderOpen(httpsReader_t *reader, char *url, int rangeStart) {
+	return httpsReaderOpen(reader, url, rangeStart, NULL);
+}
 
-	if (httpsRegParams->destbuffer == NULL) {
-		ESP_LOGE(TAG, "buffer not available");
-		return -1;
+// sends the request for url, from rangeStart on, and reads the response headers
+// on ESP_OK the body can be read, the reader must be closed in any case
+// with timing the request goes over a new connection, the steps of setting it up are timed
+esp_err_t httpsReaderOpen(httpsReader_t *reader, char *url, int rangeStart, httpsTiming_t *timing) {
+	char range[32];
+	int content_length;
+
+	memset(reader, 0, sizeof(httpsReader_t));
+	reader->rangeStart = rangeStart;
+	reader->contentLength = -1;
+	if (timing) {
+		memset(timing, 0, sizeof(httpsTiming_t));
+		reader->client = clientNew(url, timingEventHandler, timing);
+	} else
+		reader->client = clientInit(url, NULL);
+	if (reader->client == NULL)
+		return ESP_ERR_NO_MEM;
+	if (rangeStart > 0) {
+		snprintf(range, sizeof(range), "bytes=%d-", rangeStart);
+		esp_http_client_set_header(reader->client, "Range", range);
 	}
-
-	esp_http_client_config_t config = {
-		.url = httpsRegParams->httpsURL,
-		// .crt_bundle_attach = esp_crt_bundle_attach,
-		.cert_pem = server_root_cert_pem_start,
-	};
-
-	esp_http_client_handle_t client = esp_http_client_init(&config);
-	esp_err_t err;
-	if ((err = esp_http_client_open(client, 0)) != ESP_OK) {
-		ESP_LOGE(TAG, "Failed to open HTTP connection: %s", esp_err_to_name(err));
-		return -1;
+	int64_t startTime = esp_timer_get_time();
+	content_length = clientStart(reader->client);
+	if (timing) {
+		if (timing->ttfbUs)
+			timing->ttfbUs -= timing->requestUs;
+		if (timing->requestUs)
+			timing->requestUs -= timing->connectUs;
+		if (timing->connectUs)
+			timing->connectUs -= startTime;
 	}
-	content_length = esp_http_client_fetch_headers(client);
-	status = esp_http_client_get_status_code(client);
-	ESP_LOGI(TAG, "HTTP Stream reader Status = %d, content_length = %" PRId64, status, esp_http_client_get_content_length(client));
-
-	if ((status > 300) || (status < 200)) {
-		total_read_len = -1;
-		ESP_LOGE(TAG, "HTTP Stream reader Status = %d", status);
+	reader->status = esp_http_client_get_status_code(reader->client);
+	if (reader->status <= 0)
+		return ESP_FAIL;
+	ESP_LOGI(TAG, "HTTP Stream reader Status = %d, content_length = %d", reader->status, content_length);
+
+	if ((reader->status > 300) || (reader->status < 200)) {
+		ESP_LOGE(TAG, "HTTP Stream reader Status = %d", reader->status);
+		return ESP_ERR_NOT_FOUND;
 	}
-
-	else {
-		do {
-			if (xQueueReceive(httpsReqRdyMssgBox, &mssg, MSSGBOX_TIMEOUT)) {
-				read_len = esp_http_client_read(client, (char *)httpsRegParams->destbuffer, httpsRegParams->maxChars);
-				mssg.len = read_len;
-				xQueueSend(httpsReqMssgBox, &mssg, MSSGBOX_TIMEOUT);
-			} else {
-				ESP_LOGE(TAG, "Timeout httpsReqRdyMssgBox");
-				read_len = -1;
-			}
-			total_read_len += read_len;
-		} while (read_len > 0);
+	if ((rangeStart > 0) && (reader->status != 206)) {
+		ESP_LOGW(TAG, "Range not supported, getting whole file");
+		reader->rangeStart = 0;
 	}
+	if (content_length >= 0)
+		reader->contentLength = reader->rangeStart + content_length;
+	return ESP_OK;
+}
 
-	//	ESP_LOGI(TAG, "HTTP Stream reader Status = %d, content_length = %" PRId64, esp_http_client_get_status_code(client),
-	//			 esp_http_client_get_content_length(client));
-
-	esp_http_client_close(client);
-	esp_http_client_cleanup(client);
-	return total_read_len;
+// reads the next part of the body straight into buf, returns the bytes read (size unless the end is reached),
+// 0 at the end, < 0 on error
+int httpsReaderRead(httpsReader_t *reader, uint8_t *buf, int size) {
+	int len = esp_http_client_read(reader->client, (char *)buf, size);
+	if (len < 0)
+		ESP_LOGE(TAG, "Read error");
+	else if (len == 0)
+		reader->complete = esp_http_client_is_complete_data_received(reader->client);
+	return len;
 }
 
+// reads the body to the end into buf (size bytes, owned by the caller), passing each block to sink
+esp_err_t httpsReaderSink(httpsReader_t *reader, uint8_t *buf, int size, httpsSink_t sink, void *ctx) {
+	esp_err_t err = ESP_OK;
+	int len;
 
+	while ((err == ESP_OK) && ((len = httpsReaderRead(reader, buf, size)) != 0)) {
+		if (len < 0)
+			err = ESP_FAIL;
+		else
+			err = sink(ctx, buf, len);
+	}
+	return err;
+}
 
-void httpsGetRequestTask(void *pvparameters) {
-	ESP_LOGI(TAG, "Start https_task");
-	httpsRegParams_t *httpsRegParams = (httpsRegParams_t *)pvparameters;
-	// char request[256];
-	// snprintf(request, sizeof(request), "GET %s HTTP/1.1\r\nHost: %s\r\nUser-Agent: esp-idf/1.0 esp32\r\n\r\n", httpsRegParams->httpsURL,
-	// 		 httpsRegParams->httpsServer);
+// ends the request, a session keeps the connection when the response was read completely
+// an error response (eg 404 for a delta patch) is small, it is read to keep the connection
+void httpsReaderClose(httpsReader_t *reader) {
+	if (reader->client) {
+		bool errorResponse = (reader->status > 300) || ((reader->status > 0) && (reader->status < 200));
+		clientDone(reader->client, reader->complete || errorResponse);
+		reader->client = NULL;
+	}
+}
 
-	if (httpsReqMssgBox == NULL) { // once
-		httpsReqMssgBox = xQueueCreate(1, sizeof(httpsMssg_t));
-		httpsReqRdyMssgBox = xQueueCreate(1, sizeof(httpsMssg_t));
-	} else {
-		xQueueReset(httpsReqMssgBox);
-		xQueueReset(httpsReqRdyMssgBox);
+// update session: the requests until httpsSessionEnd use one client, keeping the connection to the server open
+// a new connection resumes the TLS session (with CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS)
+// the client serves one request at a time, a request of another task meanwhile (eg the benchmark) gets a client of its own
+// begin and end are called by one task (updateTask)
+esp_err_t httpsSessionBegin(char *url) {
+	if (sessionClient)
+		return ESP_OK;
+	if (!sessionLock)
+		sessionLock = xSemaphoreCreateMutex();
+	if (!sessionLock)
+		return ESP_ERR_NO_MEM;
+	esp_http_client_config_t config = {
+		.url = url,
+		.timeout_ms = CONFIG_OTA_RECV_TIMEOUT,
+		.event_handler = validatorEventHandler,
+		.crt_bundle_attach = caStoreAttach,
+#if CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+		.save_client_session = true,
+#endif
+	};
+	sessionClient = esp_http_client_init(&config);
+	return sessionClient ? ESP_OK : ESP_FAIL;
+}
+
+// waits for the request using the session client
+void httpsSessionEnd(void) {
+	if (sessionClient) {
+		xSemaphoreTake(sessionLock, portMAX_DELAY);
+		esp_http_client_handle_t client = sessionClient;
+		sessionClient = NULL;
+		xSemaphoreGive(sessionLock);
+		esp_http_client_close(client);
+		esp_http_client_cleanup(client);
 	}
-    httpsReadFile(httpsRegParams);
+}
 
-	ESP_LOGI(TAG, "Finish https_request task" );
-	vTaskDelete(NULL);
+// probes the dns lookup and the tcp connect of the host of url, for the ota benchmark
+// separate from the connection of a download: the lookup may come from the dns cache, the connect is closed again
+esp_err_t httpsProbeConnect(char *url, httpsProbe_t *probe) {
+	char host[64];
+	int port = (strncmp(url, "http:", 5) == 0) ? 80 : 443;
+	struct addrinfo hints = {};
+	struct addrinfo *res = NULL;
+	int64_t t;
+
+	memset(probe, 0, sizeof(httpsProbe_t));
+	const char *p = strstr(url, "://");
+	p = p ? p + 3 : url;
+	size_t len = strcspn(p, ":/");
+	if (len >= sizeof(host))
+		return ESP_ERR_INVALID_ARG;
+	memcpy(host, p, len);
+	host[len] = 0;
+	if (p[len] == ':')
+		port = atoi(&p[len + 1]);
+
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_STREAM;
+	t = esp_timer_get_time();
+	if ((getaddrinfo(host, NULL, &hints, &res) != 0) || (res == NULL)) {
+		ESP_LOGE(TAG, "DNS lookup %s failed", host);
+		return ESP_FAIL;
+	}
+	probe->dnsUs = esp_timer_get_time() - t;
+
+	((struct sockaddr_in *)res->ai_addr)->sin_port = htons(port);
+	int sock = socket(AF_INET, SOCK_STREAM, 0);
+	t = esp_timer_get_time();
+	int ret = (sock >= 0) ? connect(sock, res->ai_addr, res->ai_addrlen) : -1;
+	probe->tcpUs = esp_timer_get_time() - t;
+	if (sock >= 0)
+		close(sock);
+	freeaddrinfo(res);
+	if (ret != 0) {
+		ESP_LOGE(TAG, "Connect %s:%d failed", host, port);
+		return ESP_FAIL;
+	}
+	return ESP_OK;
 }
@@ -0,0 +1,44 @@
+/*
+ * assetCache.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: dig
+ *
+ *  small files of /spiffs in RAM (index.html, css, js, icons), least recently used ones make room
+ *  within CONFIG_HTTP_ASSET_CACHE_SIZE bytes
+ *  a file is dropped when it changes: storageIndex calls assetCacheInvalidate for every file written or deleted
+ */
+
+#ifndef COMPONENTS_HTTP_INCLUDE_ASSETCACHE_H_
+#define COMPONENTS_HTTP_INCLUDE_ASSETCACHE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+#ifndef CONFIG_HTTP_ASSET_CACHE_SIZE
+#define CONFIG_HTTP_ASSET_CACHE_SIZE 0
+#endif
+#ifndef CONFIG_HTTP_ASSET_CACHE_MAX_FILE
+#define CONFIG_HTTP_ASSET_CACHE_MAX_FILE 8192
+#endif
+
+typedef struct assetEntry {
+	struct assetEntry *prev; // more recently used
+	struct assetEntry *next;
+	const char *path;
+	const uint8_t *data;
+	size_t size;
+	int refs;	 // requests sending it
+	bool cached; // false: dropped while sent, freed at the last assetCacheRelease
+} assetEntry_t;
+
+esp_err_t assetCacheInit(void);
+assetEntry_t *assetCacheGet(const char *path, size_t size);
+void assetCacheRelease(assetEntry_t *entry);
+void assetCacheInvalidate(const char *path);
+void assetCacheClear(void);
+int assetCacheReport(char *pBuffer, int count);
+
+#endif /* COMPONENTS_HTTP_INCLUDE_ASSETCACHE_H_ */
@@ -0,0 +1,27 @@
+/*
+ * caStore.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: dig
+ *
+ *  the trusted CA certificates of the https client, parsed once instead of from PEM on every connection
+ *  a store is reference counted: caStoreReload replaces it, connections being set up keep the old one until their handshake is done
+ */
+
+#ifndef COMPONENTS_HTTP_INCLUDE_CASTORE_H_
+#define COMPONENTS_HTTP_INCLUDE_CASTORE_H_
+
+#include <stddef.h>
+#include "esp_err.h"
+
+typedef struct caStore caStore_t;
+
+esp_err_t caStoreInit(void);
+esp_err_t caStoreReload(const unsigned char *cert, size_t len);
+caStore_t *caStoreAcquire(void);
+void caStoreRelease(caStore_t *store);
+void caStoreHandshakeBegin(void);
+void caStoreHandshakeEnd(void);
+esp_err_t caStoreAttach(void *conf);
+
+#endif /* COMPONENTS_HTTP_INCLUDE_CASTORE_H_ */
@@ -0,0 +1,22 @@
+/*
+ * dnsCache.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: dig
+ *
+ *  caches the addresses of the hosts the device connects to (the update server) for the TTL of their dns record
+ *  lwip asks the cache first (LWIP_HOOK_NETCONN_EXT_RESOLVE_CUSTOM), so every getaddrinfo uses it, also the one in esp_http_client
+ *  an address that is in use is refreshed by a task before it expires, the polls never wait for the dns server
+ */
+
+#ifndef COMPONENTS_HTTP_INCLUDE_DNSCACHE_H_
+#define COMPONENTS_HTTP_INCLUDE_DNSCACHE_H_
+
+#include "esp_err.h"
+
+#define DNS_CACHE_ENTRIES 4
+#define DNS_HOST_SZ 64
+
+esp_err_t dnsCacheInit(void);
+
+#endif /* COMPONENTS_HTTP_INCLUDE_DNSCACHE_H_ */
@@ -8,31 +8,61 @@
 #ifndef COMPONENTS_HTTP_INCLUDE_HTTPSREQUEST_H_
 #define COMPONENTS_HTTP_INCLUDE_HTTPSREQUEST_H_
 
-#include "freertos/FreeRTOS.h"
-#include "freertos/queue.h"
+#include "esp_err.h"
+#include "esp_http_client.h"
+#include "sdkconfig.h"
 
 #define SERVER_URL_MAX_SZ 256
-#define HTTPSBUFSIZE 1024
-#define MSSGBOX_TIMEOUT (5000/portTICK_PERIOD_MS)
 
+#ifndef CONFIG_HTTPS_READ_BUFSIZE
+#define CONFIG_HTTPS_READ_BUFSIZE 4096
+#endif
+
+// receives the data of a file read by httpsReaderSink, returning an error stops the transfer
+typedef esp_err_t (*httpsSink_t)(void *ctx, const uint8_t *data, int len);
+
+// a file being read in the task of the caller: httpsReaderOpen, httpsReaderRead or httpsReaderSink, httpsReaderClose
+typedef struct {
+	esp_http_client_handle_t client;
+	int status;
+	int rangeStart;	   // > 0: the file from this offset on, set to 0 when the server sends the whole file
+	int contentLength; // size of the whole file, -1 if unknown
+	bool complete;	   // response read to the end
+} httpsReader_t;
+
+// validators of the last response of a resource, sent back to get 304 Not Modified when unchanged
 typedef struct {
-	char *httpsServer;
-	char *httpsURL;
-	uint8_t *destbuffer; // where to put data read
-	int maxChars;
-} httpsRegParams_t;
+	char eTag[64];
+	char lastModified[32];
+} httpsValidator_t;
 
+// setup of the connection that carries a request (httpsReaderOpen with timing), in us
+typedef struct {
+	int64_t connectUs; // dns, tcp connect and tls handshake
+	int64_t requestUs; // sending the request
+	int64_t ttfbUs;	   // request sent until the response headers come in
+} httpsTiming_t;
 
+// dns lookup and tcp connect of a host, measured apart from any request (httpsProbeConnect), in us
 typedef struct {
-	int len;
-} httpsMssg_t ;
+	int64_t dnsUs;
+	int64_t tcpUs;
+} httpsProbe_t;
+
+#define HTTPS_NOT_MODIFIED (-304) // httpsReadFile: validators match, dest not changed
+#define HTTPS_NOT_FOUND (-404)	  // httpsReadFile: the server has no such file
 
-extern QueueHandle_t httpsReqMssgBox;
-extern QueueHandle_t httpsReqRdyMssgBox;
-void httpsGetRequestTask(void *pvparameters);
+esp_err_t httpsReaderOpen(httpsReader_t *reader, char *url, int rangeStart);
+esp_err_t httpsReaderOpen(httpsReader_t *reader, char *url, int rangeStart, httpsTiming_t *timing);
+int httpsReaderRead(httpsReader_t *reader, uint8_t *buf, int size);
+esp_err_t httpsReaderSink(httpsReader_t *reader, uint8_t *buf, int size, httpsSink_t sink, void *ctx);
+void httpsReaderClose(httpsReader_t *reader);
 
-int httpsReadFile(const httpsRegParams_t *httpsRegParams);
+esp_err_t httpsSessionBegin(char *url);
+void httpsSessionEnd(void);
+esp_err_t httpsProbeConnect(char *url, httpsProbe_t *probe);
 int httpsReadFile(char * url, char * dest, int maxChars);
+int httpsReadFile(char *url, char *dest, int maxChars, httpsValidator_t *validator);
 
 
 #endif /* COMPONENTS_HTTP_INCLUDE_HTTPSREQUEST_H_ */
@@ -8,6 +8,8 @@
 #include "sdkconfig.h"
 #include "esp_log.h"
 #include "mdns.h"
+#include "wifiConnect.h"
+#include "../OTA/include/lanPeer.h"
 
 #define EXAMPLE_MDNS_INSTANCE CONFIG_MDNS_INSTANCE
 static const char *TAG = "mdns";
@@ -45,6 +47,15 @@ void initialiseMdns(char * hostName)
 
     //initialize service
     ESP_ERROR_CHECK( mdns_service_add("ESP32-WebServer", "_http", "_tcp", 80, serviceTxtData, 3) );
+#if CONFIG_OTA_LAN_PEERS
+    // running firmware for devices on the lan that update to this version
+    mdns_txt_item_t otaTxtData[2] = {
+        {"fw", wifiSettings.firmwareVersion},
+        {"path", LAN_PEER_FIRMWARE_PATH}
+    };
+    if (wifiSettings.firmwareVersion[0] != 0)
+        ESP_ERROR_CHECK( mdns_service_add(hostName, LAN_PEER_SERVICE, LAN_PEER_PROTO, 80, otaTxtData, 2) );
+#endif
 #if CONFIG_MDNS_MULTIPLE_INSTANCE
     ESP_ERROR_CHECK( mdns_service_add("ESP32-WebServer1", "_http", "_tcp", 80, NULL, 0) );
 #endif
@@ -0,0 +1,65 @@
+#!/usr/bin/env python3
+# copies the web files for the storage image and adds precompressed versions of the text files next to them:
+# <file>.gz and, when the brotli module is installed, <file>.br
+# the file server sends such a version instead of the file when the browser accepts it (Accept-Encoding)
+# a version is only added when it is clearly smaller, images like jpeg are already compressed
+#
+# usage: compressAssets.py [--no-br] spiffs_image build/spiffs_image
+#  then make the storage image (and makeManifest.py --files) from build/spiffs_image
+
+import argparse
+import gzip
+import os
+import shutil
+
+TEXT_EXTENSIONS = ('.html', '.htm', '.css', '.js', '.json', '.svg', '.txt', '.xml', '.ico')
+MIN_GAIN = 0.9  # the compressed file must be smaller than this part of the original
+NAME_LEN = 32  # CONFIG_SPIFFS_OBJ_NAME_LEN, including the terminating 0
+
+try:
+    import brotli
+except ImportError:
+    brotli = None
+
+
+def compressors(use_br: bool):
+    if use_br and brotli is not None:
+        yield '.br', lambda data: brotli.compress(data, quality=11)
+    yield '.gz', lambda data: gzip.compress(data, compresslevel=9, mtime=0)
+
+
+def main() -> None:
+    parser = argparse.ArgumentParser(description='add precompressed versions of the web files')
+    parser.add_argument('--no-br', action='store_true', help='only gzip')
+    parser.add_argument('src')
+    parser.add_argument('dst')
+    args = parser.parse_args()
+
+    if not args.no_br and brotli is None:
+        print('brotli module not installed (pip install brotli), only gzip')
+    if os.path.isdir(args.dst):
+        shutil.rmtree(args.dst)
+    shutil.copytree(args.src, args.dst)
+
+    for root, _, names in os.walk(args.dst):
+        for name in sorted(names):
+            if not name.lower().endswith(TEXT_EXTENSIONS):
+                continue
+            path = os.path.join(root, name)
+            with open(path, 'rb') as f:
+                data = f.read()
+            for ext, compress in compressors(not args.no_br):
+                device_path = '/' + os.path.relpath(path, args.dst).replace(os.sep, '/') + ext
+                if len(device_path) >= NAME_LEN:
+                    print('{}: name too long for spiffs, skipped'.format(device_path))
+                    continue
+                packed = compress(data)
+                if len(packed) >= len(data) * MIN_GAIN:
+                    continue
+                with open(path + ext, 'wb') as f:
+                    f.write(packed)
+                print('{} {} -> {} bytes'.format(device_path, len(data), len(packed)))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,96 @@
+#!/usr/bin/env python3
+# compresses a firmware, storage or delta image for download
+# output is raw heatshrink, the device decompresses while flashing, see components/OTA/include/decompress.h
+# window and lookahead must match CONFIG_OTA_HEATSHRINK_WINDOW_BITS and CONFIG_OTA_HEATSHRINK_LOOKAHEAD_BITS
+#
+# usage: compressImage.py [-w 10] [-l 5] image.bin image.bin.hs
+
+import argparse
+
+HASHLEN = 3  # bytes used to find a match
+MAXCHAIN = 64  # candidates tried per position
+
+
+class BitWriter:
+    def __init__(self) -> None:
+        self.out = bytearray()
+        self.acc = 0
+        self.nr_bits = 0
+
+    def put(self, value: int, nr_bits: int) -> None:
+        self.acc = (self.acc << nr_bits) | value
+        self.nr_bits += nr_bits
+        while self.nr_bits >= 8:
+            self.nr_bits -= 8
+            self.out.append((self.acc >> self.nr_bits) & 0xFF)
+        self.acc &= (1 << self.nr_bits) - 1
+
+    def finish(self) -> bytes:
+        if self.nr_bits:
+            self.out.append((self.acc << (8 - self.nr_bits)) & 0xFF)
+        return bytes(self.out)
+
+
+def compress(data: bytes, window_bits: int, lookahead_bits: int) -> bytes:
+    window = 1 << window_bits
+    max_len = 1 << lookahead_bits
+    # shorter matches cost more bits than literals
+    min_len = (1 + window_bits + lookahead_bits) // 9 + 1
+    chains = {}
+    bits = BitWriter()
+    pos = 0
+
+    def insert(p: int) -> None:
+        chains.setdefault(data[p:p + HASHLEN], []).append(p)
+
+    while pos < len(data):
+        best_len = 0
+        best_pos = 0
+        limit = min(max_len, len(data) - pos)
+        for cand in reversed(chains.get(data[pos:pos + HASHLEN], [])[-MAXCHAIN:]):
+            if pos - cand > window:
+                break
+            n = 0
+            while n < limit and data[cand + n] == data[pos + n]:
+                n += 1
+            if n > best_len:
+                best_len = n
+                best_pos = cand
+                if n == limit:
+                    break
+        if best_len >= min_len and best_len >= HASHLEN:
+            bits.put(0, 1)
+            bits.put(pos - best_pos - 1, window_bits)
+            bits.put(best_len - 1, lookahead_bits)
+            step = best_len
+        else:
+            bits.put(1, 1)
+            bits.put(data[pos], 8)
+            step = 1
+        for p in range(pos, pos + step):
+            if p + HASHLEN <= len(data):
+                insert(p)
+        pos += step
+    return bits.finish()
+
+
+def main() -> None:
+    parser = argparse.ArgumentParser(description='heatshrink compress an update image')
+    parser.add_argument('-w', '--window', type=int, default=10, help='window bits (CONFIG_OTA_HEATSHRINK_WINDOW_BITS)')
+    parser.add_argument('-l', '--lookahead', type=int, default=5, help='lookahead bits (CONFIG_OTA_HEATSHRINK_LOOKAHEAD_BITS)')
+    parser.add_argument('input')
+    parser.add_argument('output')
+    args = parser.parse_args()
+    if not 4 <= args.lookahead < args.window <= 14:
+        parser.error('need 4 <= lookahead < window <= 14')
+
+    with open(args.input, 'rb') as f:
+        data = f.read()
+    packed = compress(data, args.window, args.lookahead)
+    with open(args.output, 'wb') as f:
+        f.write(packed)
+    print('{}: {} bytes, image {} bytes ({:.1f}%)'.format(args.output, len(packed), len(data), 100.0 * len(packed) / max(len(data), 1)))
+
+
+if __name__ == '__main__':
+    main()
@@ -1 +1 @@
-scp firmWareVersion.txt  build/ESP32_OTAtemplate.bin root@85.215.168.155:~/firmware/OTA/
+scp manifest.txt firmWareVersion.txt  build/ESP32_OTAtemplate.bin root@85.215.168.155:~/firmware/OTA/
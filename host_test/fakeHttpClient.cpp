@@ -0,0 +1,430 @@
+/*
+ * fakeHttpClient.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: dig
+ *
+ *  esp_http_client for file:// urls, the file is the body of a 200 (206 with Range) response, a missing file is a 404
+ *  http:// and https:// urls go over a socket (OpenSSL for https, the certificate is not checked), the connection is kept
+ *  between requests as esp_http_client does, the events the OTA code uses are sent
+ *  fakeHttpClientDelay makes each read as slow as a network link
+ */
+
+#include <netdb.h>
+#include <openssl/ssl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "caStore.h"
+#include "esp_http_client.h"
+#include "esp_timer.h"
+#include "esp_tls.h"
+#include "fakeHttpClient.h"
+
+#define FILE_URL "file://"
+#define MAX_HEADERS 8
+
+struct esp_http_client {
+	char url[256];
+	http_event_handle_cb handler;
+	void *userData;
+	int timeoutMs;
+	struct {
+		char key[32];
+		char value[128];
+	} headers[MAX_HEADERS];
+	int status;
+	// file://
+	FILE *f;
+	long size;
+	long pos;
+	long rangeStart;
+	// http(s)://
+	char host[64];
+	char port[8];
+	bool tls;
+	const char *path;
+	int sock;
+	SSL *ssl;
+	bool keepAlive;
+	char in[4096]; // received, not yet used
+	int inLen;
+	int inPos;
+	int64_t contentLength; // -1: unknown
+	int64_t bodyRead;
+};
+
+static int readUs;
+
+void fakeHttpClientDelay(int us) {
+	readUs = us;
+}
+
+#ifndef HAVE_STRLCPY
+size_t strlcpy(char *dst, const char *src, size_t size) {
+	size_t len = strlen(src);
+	if (size > 0) {
+		size_t n = (len < size - 1) ? len : size - 1;
+		memcpy(dst, src, n);
+		dst[n] = 0;
+	}
+	return len;
+}
+#endif
+
+int64_t esp_timer_get_time(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+esp_err_t esp_tls_get_and_clear_last_error(esp_tls_error_handle_t h, int *esp_tls_code, int *esp_tls_flags) {
+	return ESP_OK;
+}
+
+void caStoreHandshakeBegin(void) {
+}
+
+void caStoreHandshakeEnd(void) {
+}
+
+esp_err_t caStoreAttach(void *conf) {
+	return ESP_OK;
+}
+
+static bool isFile(esp_http_client_handle_t client) {
+	return strncmp(client->url, FILE_URL, strlen(FILE_URL)) == 0;
+}
+
+static void event(esp_http_client_handle_t client, esp_http_client_event_id_t id, char *key, char *value) {
+	esp_http_client_event_t evt = {};
+
+	if (client->handler == NULL)
+		return;
+	evt.event_id = id;
+	evt.client = client;
+	evt.user_data = client->userData;
+	evt.header_key = key;
+	evt.header_value = value;
+	client->handler(&evt);
+}
+
+static const char *header(esp_http_client_handle_t client, const char *key) {
+	for (int n = 0; n < MAX_HEADERS; n++) {
+		if (strcasecmp(client->headers[n].key, key) == 0)
+			return client->headers[n].value;
+	}
+	return NULL;
+}
+
+static void closeConnection(esp_http_client_handle_t client) {
+	if (client->ssl) {
+		SSL_shutdown(client->ssl);
+		SSL_free(client->ssl);
+		client->ssl = NULL;
+	}
+	if (client->sock >= 0) {
+		close(client->sock);
+		client->sock = -1;
+		event(client, HTTP_EVENT_DISCONNECTED, NULL, NULL);
+	}
+	client->inLen = client->inPos = 0;
+}
+
+static bool connectTo(esp_http_client_handle_t client) {
+	static SSL_CTX *ctx;
+	struct addrinfo hints = {};
+	struct addrinfo *res;
+
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	if (getaddrinfo(client->host, client->port, &hints, &res) != 0)
+		return false;
+	client->sock = socket(res->ai_family, SOCK_STREAM, 0);
+	struct timeval timeout = {client->timeoutMs / 1000, (client->timeoutMs % 1000) * 1000};
+	setsockopt(client->sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+	bool ok = (client->sock >= 0) && (connect(client->sock, res->ai_addr, res->ai_addrlen) == 0);
+	freeaddrinfo(res);
+	if (ok && client->tls) {
+		if (ctx == NULL)
+			ctx = SSL_CTX_new(TLS_client_method());
+		client->ssl = SSL_new(ctx);
+		SSL_set_fd(client->ssl, client->sock);
+		SSL_set_tlsext_host_name(client->ssl, client->host);
+		ok = SSL_connect(client->ssl) == 1;
+	}
+	if (!ok) {
+		closeConnection(client);
+		return false;
+	}
+	event(client, HTTP_EVENT_ON_CONNECTED, NULL, NULL);
+	return true;
+}
+
+static int sendAll(esp_http_client_handle_t client, const char *data, int len) {
+	int sent = 0;
+	while (sent < len) {
+		int n = client->ssl ? SSL_write(client->ssl, data + sent, len - sent) : send(client->sock, data + sent, len - sent, MSG_NOSIGNAL);
+		if (n <= 0)
+			return -1;
+		sent += n;
+	}
+	return sent;
+}
+
+// the next bytes of the connection, at most len, 0 when it is closed
+static int receive(esp_http_client_handle_t client, char *buf, int len) {
+	if (client->inPos < client->inLen) {
+		int n = client->inLen - client->inPos;
+		if (n > len)
+			n = len;
+		memcpy(buf, client->in + client->inPos, n);
+		client->inPos += n;
+		return n;
+	}
+	int n = client->ssl ? SSL_read(client->ssl, buf, len) : recv(client->sock, buf, len, 0);
+	return (n < 0) ? -1 : n;
+}
+
+// a header line without \r\n, false when the connection ends first
+static bool receiveLine(esp_http_client_handle_t client, char *line, int size) {
+	int len = 0;
+	while (true) {
+		if (client->inPos == client->inLen) {
+			client->inPos = 0;
+			client->inLen = client->ssl ? SSL_read(client->ssl, client->in, sizeof(client->in)) : recv(client->sock, client->in, sizeof(client->in), 0);
+			if (client->inLen <= 0) {
+				client->inLen = 0;
+				return false;
+			}
+		}
+		char c = client->in[client->inPos++];
+		if (c == '\n')
+			break;
+		if ((c != '\r') && (len < size - 1))
+			line[len++] = c;
+	}
+	line[len] = 0;
+	return true;
+}
+
+esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t *config) {
+	esp_http_client_handle_t client = (esp_http_client_handle_t)calloc(1, sizeof(struct esp_http_client));
+	client->sock = -1;
+	client->handler = config->event_handler;
+	client->userData = config->user_data;
+	client->timeoutMs = config->timeout_ms ? config->timeout_ms : 5000;
+	esp_http_client_set_url(client, config->url);
+	return client;
+}
+
+// a connection to another server is closed
+esp_err_t esp_http_client_set_url(esp_http_client_handle_t client, const char *url) {
+	char host[sizeof(client->host)];
+	char port[sizeof(client->port)];
+
+	strlcpy(client->url, url, sizeof(client->url));
+	if (isFile(client))
+		return ESP_OK;
+	bool tls = strncmp(url, "https://", 8) == 0;
+	const char *p = strstr(url, "://");
+	p = p ? p + 3 : url;
+	size_t len = strcspn(p, ":/");
+	snprintf(host, sizeof(host), "%.*s", (int)len, p);
+	if (p[len] == ':')
+		snprintf(port, sizeof(port), "%d", atoi(p + len + 1));
+	else
+		strcpy(port, tls ? "443" : "80");
+	if ((strcmp(host, client->host) != 0) || (strcmp(port, client->port) != 0) || (tls != client->tls))
+		closeConnection(client);
+	strcpy(client->host, host);
+	strcpy(client->port, port);
+	client->tls = tls;
+	client->path = strchr(p, '/') ? strchr(p, '/') : "/";
+	return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_user_data(esp_http_client_handle_t client, void *data) {
+	client->userData = data;
+	return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_header(esp_http_client_handle_t client, const char *key, const char *value) {
+	int free = -1;
+	for (int n = MAX_HEADERS - 1; n >= 0; n--) {
+		if ((client->headers[n].key[0] == 0) || (strcasecmp(client->headers[n].key, key) == 0))
+			free = n;
+	}
+	if (free < 0)
+		return ESP_ERR_NO_MEM;
+	strlcpy(client->headers[free].key, key, sizeof(client->headers[free].key));
+	strlcpy(client->headers[free].value, value, sizeof(client->headers[free].value));
+	return ESP_OK;
+}
+
+esp_err_t esp_http_client_delete_header(esp_http_client_handle_t client, const char *key) {
+	for (int n = 0; n < MAX_HEADERS; n++) {
+		if (strcasecmp(client->headers[n].key, key) == 0)
+			client->headers[n].key[0] = 0;
+	}
+	return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_redirection(esp_http_client_handle_t client) {
+	return ESP_OK;
+}
+
+// connects unless the connection of the last request is still open, sends the request
+esp_err_t esp_http_client_open(esp_http_client_handle_t client, int write_len) {
+	char request[512];
+
+	client->status = 0;
+	if (isFile(client)) {
+		const char *range = header(client, "Range");
+		client->rangeStart = range ? strtol(range + strlen("bytes="), NULL, 10) : 0;
+		client->f = fopen(client->url + strlen(FILE_URL), "rb");
+		if (client->f == NULL) {
+			client->status = 404;
+			return ESP_OK;
+		}
+		fseek(client->f, 0, SEEK_END);
+		client->size = ftell(client->f);
+		client->pos = (client->rangeStart < client->size) ? client->rangeStart : client->size;
+		fseek(client->f, client->pos, SEEK_SET);
+		client->status = (client->rangeStart > 0) ? 206 : 200;
+		return ESP_OK;
+	}
+
+	if ((client->sock >= 0) && !client->keepAlive)
+		closeConnection(client);
+	if ((client->sock < 0) && !connectTo(client))
+		return ESP_FAIL;
+	int len = snprintf(request, sizeof(request), "GET %s HTTP/1.1\r\nHost: %s\r\n", client->path, client->host);
+	for (int n = 0; n < MAX_HEADERS; n++) {
+		if (client->headers[n].key[0])
+			len += snprintf(request + len, sizeof(request) - len, "%s: %s\r\n", client->headers[n].key, client->headers[n].value);
+	}
+	len += snprintf(request + len, sizeof(request) - len, "\r\n");
+	if (sendAll(client, request, len) < 0) { // the server closed a kept connection
+		closeConnection(client);
+		return ESP_FAIL;
+	}
+	event(client, HTTP_EVENT_HEADER_SENT, NULL, NULL);
+	client->contentLength = -1;
+	client->bodyRead = 0;
+	client->keepAlive = true;
+	return ESP_OK;
+}
+
+int64_t esp_http_client_fetch_headers(esp_http_client_handle_t client) {
+	char line[512];
+
+	if (isFile(client))
+		return esp_http_client_get_content_length(client);
+	if (!receiveLine(client, line, sizeof(line)) || (sscanf(line, "HTTP/%*s %d", &client->status) != 1)) {
+		client->status = 0;
+		closeConnection(client);
+		return ESP_FAIL;
+	}
+	while (receiveLine(client, line, sizeof(line)) && line[0]) {
+		char *value = strchr(line, ':');
+		if (value == NULL)
+			continue;
+		*value++ = 0;
+		while (*value == ' ')
+			value++;
+		if (strcasecmp(line, "Content-Length") == 0)
+			client->contentLength = strtoll(value, NULL, 10);
+		else if ((strcasecmp(line, "Connection") == 0) && (strcasecmp(value, "close") == 0))
+			client->keepAlive = false;
+		event(client, HTTP_EVENT_ON_HEADER, line, value);
+	}
+	return client->contentLength;
+}
+
+bool esp_http_client_is_chunked_response(esp_http_client_handle_t client) {
+	return false;
+}
+
+// as esp_http_client_read: len bytes unless the body ends
+int esp_http_client_read(esp_http_client_handle_t client, char *buffer, int len) {
+	int n = 0;
+
+	if (isFile(client)) {
+		if (client->f == NULL)
+			return 0;
+		n = fread(buffer, 1, len, client->f);
+		client->pos += n;
+	} else {
+		if (client->sock < 0)
+			return 0;
+		if ((client->contentLength >= 0) && (len > client->contentLength - client->bodyRead))
+			len = client->contentLength - client->bodyRead;
+		while (n < len) {
+			int r = receive(client, buffer + n, len - n);
+			if (r < 0)
+				return n ? n : -1;
+			if (r == 0)
+				break;
+			n += r;
+		}
+		client->bodyRead += n;
+	}
+	if (readUs && n)
+		usleep(readUs);
+	return n;
+}
+
+int esp_http_client_get_status_code(esp_http_client_handle_t client) {
+	return client->status;
+}
+
+int64_t esp_http_client_get_content_length(esp_http_client_handle_t client) {
+	if (isFile(client))
+		return client->f ? client->size - client->rangeStart : 0;
+	return client->contentLength;
+}
+
+bool esp_http_client_is_complete_data_received(esp_http_client_handle_t client) {
+	if (isFile(client))
+		return (client->f == NULL) || (client->pos == client->size);
+	return client->bodyRead == client->contentLength;
+}
+
+// reads the rest of the body, the connection can take the next request
+esp_err_t esp_http_client_flush_response(esp_http_client_handle_t client, int *len) {
+	char buf[1024];
+	int n, total = 0;
+
+	if (!isFile(client)) {
+		while ((n = esp_http_client_read(client, buf, sizeof(buf))) > 0)
+			total += n;
+		if (n < 0)
+			return ESP_FAIL;
+	}
+	if (len)
+		*len = total;
+	return ESP_OK;
+}
+
+esp_err_t esp_http_client_close(esp_http_client_handle_t client) {
+	if (client->f)
+		fclose(client->f);
+	client->f = NULL;
+	closeConnection(client);
+	client->status = 0;
+	return ESP_OK;
+}
+
+esp_err_t esp_http_client_cleanup(esp_http_client_handle_t client) {
+	esp_http_client_close(client);
+	free(client);
+	return ESP_OK;
+}
@@ -0,0 +1,14 @@
+/*
+ * fakeHttpClient.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: dig
+ */
+
+#ifndef HOST_TEST_FAKEHTTPCLIENT_H_
+#define HOST_TEST_FAKEHTTPCLIENT_H_
+
+// each read of a body takes us longer, 0: as fast as the file
+void fakeHttpClientDelay(int us);
+
+#endif /* HOST_TEST_FAKEHTTPCLIENT_H_ */
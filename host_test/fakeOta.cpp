@@ -0,0 +1,115 @@
+/*
+ * fakeOta.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: dig
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "esp_ota_ops.h"
+#include "fakeOta.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "mbedtls/sha256.h"
+#include "nvs.h"
+#include "test.h"
+#include "updateFirmWareTask.h"
+#include "wifiConnect.h"
+
+wifiSettings_t wifiSettings = {"", CONFIG_FIRMWARE_UPGRADE_FILENAME};
+volatile updateStatus_t updateStatus;
+
+esp_partition_t *fakeOtaRunning;
+esp_partition_t *fakeOtaUpdate;
+const esp_partition_t *fakeOtaBoot;
+
+const esp_partition_t *esp_ota_get_boot_partition(void) {
+	return fakeOtaRunning;
+}
+
+const esp_partition_t *esp_ota_get_running_partition(void) {
+	return fakeOtaRunning;
+}
+
+const esp_partition_t *esp_ota_get_next_update_partition(const esp_partition_t *start_from) {
+	return fakeOtaUpdate;
+}
+
+esp_err_t esp_ota_get_partition_description(const esp_partition_t *partition, esp_app_desc_t *app_desc) {
+	return ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t *partition) {
+	fakeOtaBoot = partition;
+	return ESP_OK;
+}
+
+esp_err_t nvs_open(const char *name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle) {
+	return ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length) {
+	return ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length) {
+	return ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key) {
+	return ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle) {
+	return ESP_ERR_NVS_NOT_FOUND;
+}
+
+void nvs_close(nvs_handle_t handle) {
+}
+
+// the server has a manifest, the version files are not read
+esp_err_t getNewVersion(char *infoFileName, char *newVersion, httpsValidator_t *validator) {
+	return ESP_FAIL;
+}
+
+void fakeOtaBegin(uint32_t partitionSize) {
+	fakeOtaRunning = fakePartition("ota_0", partitionSize);
+	fakeOtaUpdate = fakePartition("ota_1", partitionSize);
+	fakeOtaBoot = NULL;
+}
+
+void fakeOtaEnd(void) {
+	fakePartitionFree(fakeOtaRunning);
+	fakePartitionFree(fakeOtaUpdate);
+}
+
+bool fakeOtaRun(void (*taskCode)(void *), manifestEntry_t *entry, int timeoutMs) {
+	updateStatus = UPDATE_BUSY;
+	if (xTaskCreate(taskCode, "fakeOtaTask", 2 * 8192, entry, 5, NULL) != pdPASS)
+		return false;
+	for (int ms = 0; (updateStatus == UPDATE_BUSY) && (ms < timeoutMs); ms += 10)
+		vTaskDelay(10 / portTICK_PERIOD_MS);
+	return updateStatus != UPDATE_BUSY;
+}
+
+void fakeOtaImage(const char *folder, const char *fileName, const uint8_t *image, int len, manifestEntry_t *entry) {
+	char path[256];
+
+	mkdir(folder, 0755);
+	snprintf(path, sizeof(path), "%s/%s", folder, fileName);
+	FILE *f = fopen(path, "wb");
+	if (f) {
+		fwrite(image, 1, len, f);
+		fclose(f);
+	}
+	if (entry == NULL)
+		return;
+	memset(entry, 0, sizeof(*entry));
+	strncpy(entry->fileName, fileName, sizeof(entry->fileName) - 1);
+	entry->size = len;
+	mbedtls_sha256(image, len, entry->sha256, 0);
+	entry->hasSha256 = true;
+}
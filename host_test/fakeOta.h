@@ -0,0 +1,28 @@
+/*
+ * fakeOta.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: dig
+ *
+ *  what updateFirmWareTask.cpp uses of ESP-IDF (ota partitions, nvs) and of main, for the tests running its tasks
+ *  the ota partitions are in RAM, nvs is empty and can not be written
+ */
+
+#ifndef HOST_TEST_FAKEOTA_H_
+#define HOST_TEST_FAKEOTA_H_
+
+#include "esp_partition.h"
+#include "manifest.h"
+
+extern esp_partition_t *fakeOtaRunning;
+extern esp_partition_t *fakeOtaUpdate;
+extern const esp_partition_t *fakeOtaBoot; // set by esp_ota_set_boot_partition, NULL: not called
+
+void fakeOtaBegin(uint32_t partitionSize);
+void fakeOtaEnd(void);
+// runs taskCode(entry) in a task as updateTask does, false if updateStatus is still UPDATE_BUSY after timeoutMs
+bool fakeOtaRun(void (*taskCode)(void *), manifestEntry_t *entry, int timeoutMs);
+// folder/fileName with image, entry (if not NULL) as makeManifest.py describes it
+void fakeOtaImage(const char *folder, const char *fileName, const uint8_t *image, int len, manifestEntry_t *entry);
+
+#endif /* HOST_TEST_FAKEOTA_H_ */
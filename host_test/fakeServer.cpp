@@ -0,0 +1,108 @@
+/*
+ * fakeServer.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: dig
+ */
+
+#include <string.h>
+
+#include "fakeServer.h"
+#include "httpsReadFile.h"
+#include "test.h"
+#include "updateSpiffsTask.h"
+#include "wifiConnect.h"
+
+wifiSettings_t wifiSettings = {FAKE_SERVER_URL, CONFIG_FIRMWARE_UPGRADE_FILENAME};
+
+#define MAX_FILES 16
+
+static char serverFolder[32];
+static struct {
+	char name[64];
+	int requests;
+} requestLog[MAX_FILES];
+
+// folder: in host_test/vectors, "" for the vectors themselves
+void fakeServerBegin(const char *folder) {
+	strncpy(serverFolder, folder, sizeof(serverFolder) - 1);
+	memset(requestLog, 0, sizeof(requestLog));
+}
+
+// requests for fileName since fakeServerBegin
+int fakeServerRequests(const char *fileName) {
+	for (int n = 0; n < MAX_FILES; n++) {
+		if (strcmp(requestLog[n].name, fileName) == 0)
+			return requestLog[n].requests;
+	}
+	return 0;
+}
+
+static void logRequest(const char *fileName) {
+	for (int n = 0; n < MAX_FILES; n++) {
+		if ((requestLog[n].name[0] == 0) || (strcmp(requestLog[n].name, fileName) == 0)) {
+			strncpy(requestLog[n].name, fileName, sizeof(requestLog[n].name) - 1);
+			requestLog[n].requests++;
+			return;
+		}
+	}
+}
+
+int httpsReadFile(char *url, char *dest, int maxChars) {
+	return httpsReadFile(url, dest, maxChars, NULL);
+}
+
+// as the one in httpsReadFile.cpp, the ETag is the size and a sum of the file
+int httpsReadFile(char *url, char *dest, int maxChars, httpsValidator_t *validator) {
+	char path[SERVER_URL_MAX_SZ];
+	char eTag[sizeof(validator->eTag)];
+	int len;
+
+	if (strncmp(url, FAKE_SERVER_URL "/", strlen(FAKE_SERVER_URL "/")) != 0) {
+		*dest = 0;
+		return -1;
+	}
+	const char *fileName = url + strlen(FAKE_SERVER_URL "/");
+	logRequest(fileName);
+	snprintf(path, sizeof(path), "%s%s%s", serverFolder, serverFolder[0] ? "/" : "", fileName);
+	uint8_t *data = readVector(path, &len);
+	if (data == NULL) {
+		*dest = 0;
+		if (validator)
+			memset(validator, 0, sizeof(httpsValidator_t));
+		return HTTPS_NOT_FOUND;
+	}
+	uint32_t sum = 0;
+	for (int n = 0; n < len; n++)
+		sum = sum * 31 + data[n];
+	snprintf(eTag, sizeof(eTag), "\"%d-%08x\"", len, (unsigned)sum);
+	if (validator && (strcmp(validator->eTag, eTag) == 0)) {
+		free(data);
+		return HTTPS_NOT_MODIFIED;
+	}
+	if (len > maxChars) {
+		*dest = 0;
+		len = -1;
+	}
+	else
+		memcpy(dest, data, len);
+	if (validator) {
+		memset(validator, 0, sizeof(httpsValidator_t));
+		if (len >= 0)
+			strcpy(validator->eTag, eTag);
+	}
+	free(data);
+	return len;
+}
+
+// as in updateTask.cpp
+esp_err_t getNewVersion(char *infoFileName, char *newVersion, httpsValidator_t *validator) {
+	char url[SERVER_URL_MAX_SZ];
+
+	snprintf(url, sizeof(url), "%s/%s", wifiSettings.upgradeURL, infoFileName);
+	int len = httpsReadFile(url, newVersion, MAX_STORAGEVERSIONSIZE - 1, validator);
+	if (len == HTTPS_NOT_MODIFIED)
+		return ESP_OK;
+	newVersion[(len > 0) ? len : 0] = 0;
+	return (len > 0) ? ESP_OK : ESP_FAIL;
+}
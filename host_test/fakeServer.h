@@ -0,0 +1,18 @@
+/*
+ * fakeServer.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: dig
+ *
+ *  httpsReadFile answered from a folder of host_test/vectors, as the update server
+ */
+
+#ifndef HOST_TEST_FAKESERVER_H_
+#define HOST_TEST_FAKESERVER_H_
+
+#define FAKE_SERVER_URL "https://update.test/ota"
+
+void fakeServerBegin(const char *folder);
+int fakeServerRequests(const char *fileName);
+
+#endif /* HOST_TEST_FAKESERVER_H_ */
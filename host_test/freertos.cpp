@@ -0,0 +1,191 @@
+/*
+ * freertos.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: dig
+ *
+ *  tasks, queues and semaphores of FreeRTOS on pthreads, enough for the tasks of the OTA code
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct {
+	pthread_mutex_t lock;
+	pthread_cond_t changed;
+	UBaseType_t length;
+	UBaseType_t itemSize;
+	UBaseType_t count;
+	UBaseType_t head;
+	uint8_t *items; // NULL for a semaphore, count is its value
+} queue_t;
+
+typedef struct {
+	TaskFunction_t task;
+	void *param;
+} start_t;
+
+static void *taskStart(void *arg) {
+	start_t start = *(start_t *)arg;
+	free(arg);
+	start.task(start.param);
+	return NULL;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t task, const char *name, uint32_t stackDepth, void *param, UBaseType_t priority, TaskHandle_t *handle) {
+	start_t *start = (start_t *)malloc(sizeof(start_t));
+	pthread_t thread;
+
+	start->task = task;
+	start->param = param;
+	if (pthread_create(&thread, NULL, taskStart, start) != 0) {
+		free(start);
+		return pdFAIL;
+	}
+	pthread_detach(thread);
+	if (handle)
+		*handle = (TaskHandle_t)thread;
+	return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task) {
+	if (task == NULL)
+		pthread_exit(NULL);
+}
+
+void vTaskDelay(TickType_t ticks) {
+	struct timespec t = {(time_t)(ticks / 1000), (long)(ticks % 1000) * 1000000};
+	while (nanosleep(&t, &t) != 0 && errno == EINTR)
+		;
+}
+
+TickType_t xTaskGetTickCount(void) {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (TickType_t)(t.tv_sec * 1000 + t.tv_nsec / 1000000);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void) {
+	return (TaskHandle_t)pthread_self();
+}
+
+static queue_t *queueCreate(UBaseType_t length, UBaseType_t itemSize, UBaseType_t count) {
+	queue_t *queue = (queue_t *)calloc(1, sizeof(queue_t));
+
+	pthread_mutex_init(&queue->lock, NULL);
+	pthread_cond_init(&queue->changed, NULL);
+	queue->length = length;
+	queue->itemSize = itemSize;
+	queue->count = count;
+	if (itemSize)
+		queue->items = (uint8_t *)malloc(length * itemSize);
+	return queue;
+}
+
+// waits until ready() or the ticks passed, with queue->lock held
+template <typename F> static bool queueWait(queue_t *queue, TickType_t wait, F ready) {
+	struct timespec until;
+
+	clock_gettime(CLOCK_REALTIME, &until);
+	if (wait != portMAX_DELAY) {
+		until.tv_sec += wait / 1000;
+		until.tv_nsec += (long)(wait % 1000) * 1000000;
+		if (until.tv_nsec >= 1000000000) {
+			until.tv_sec++;
+			until.tv_nsec -= 1000000000;
+		}
+	}
+	while (!ready()) {
+		if (wait == 0)
+			return false;
+		if (wait == portMAX_DELAY)
+			pthread_cond_wait(&queue->changed, &queue->lock);
+		else if (pthread_cond_timedwait(&queue->changed, &queue->lock, &until) == ETIMEDOUT)
+			return ready();
+	}
+	return true;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+	return queueCreate(length, itemSize, 0);
+}
+
+BaseType_t xQueueSend(QueueHandle_t handle, const void *item, TickType_t wait) {
+	queue_t *queue = (queue_t *)handle;
+
+	pthread_mutex_lock(&queue->lock);
+	bool ok = queueWait(queue, wait, [queue] { return queue->count < queue->length; });
+	if (ok) {
+		if (queue->items)
+			memcpy(queue->items + ((queue->head + queue->count) % queue->length) * queue->itemSize, item, queue->itemSize);
+		queue->count++;
+		pthread_cond_broadcast(&queue->changed);
+	}
+	pthread_mutex_unlock(&queue->lock);
+	return ok ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t handle, void *item, TickType_t wait) {
+	queue_t *queue = (queue_t *)handle;
+
+	pthread_mutex_lock(&queue->lock);
+	bool ok = queueWait(queue, wait, [queue] { return queue->count > 0; });
+	if (ok) {
+		if (queue->items) {
+			memcpy(item, queue->items + queue->head * queue->itemSize, queue->itemSize);
+			queue->head = (queue->head + 1) % queue->length;
+		}
+		queue->count--;
+		pthread_cond_broadcast(&queue->changed);
+	}
+	pthread_mutex_unlock(&queue->lock);
+	return ok ? pdTRUE : pdFALSE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t handle) {
+	queue_t *queue = (queue_t *)handle;
+
+	pthread_mutex_lock(&queue->lock);
+	UBaseType_t count = queue->count;
+	pthread_mutex_unlock(&queue->lock);
+	return count;
+}
+
+void vQueueDelete(QueueHandle_t handle) {
+	queue_t *queue = (queue_t *)handle;
+
+	pthread_mutex_destroy(&queue->lock);
+	pthread_cond_destroy(&queue->changed);
+	free(queue->items);
+	free(queue);
+}
+
+// a semaphore is a queue without items, a mutex one that starts given (not recursive, no priority inheritance)
+SemaphoreHandle_t xSemaphoreCreateBinary(void) {
+	return queueCreate(1, 0, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void) {
+	return queueCreate(1, 0, 1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max, UBaseType_t initial) {
+	return queueCreate(max, 0, initial);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t wait) {
+	return xQueueReceive(sem, NULL, wait);
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem) {
+	return xQueueSend(sem, NULL, 0);
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t sem) {
+	vQueueDelete(sem);
+}
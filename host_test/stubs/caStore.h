@@ -0,0 +1,7 @@
+// caStore.h of the http component, no certificates on the host
+#pragma once
+#include "esp_err.h"
+
+void caStoreHandshakeBegin(void);
+void caStoreHandshakeEnd(void);
+esp_err_t caStoreAttach(void *conf);
@@ -0,0 +1,30 @@
+// esp_app_format.h of ESP-IDF, the layout of the start of an app image
+#pragma once
+#include <stdint.h>
+
+typedef struct {
+	uint8_t magic;
+	uint8_t segment_count;
+	uint8_t spi_mode;
+	uint8_t spi_speed_size;
+	uint32_t entry_addr;
+	uint8_t reserved[16];
+} esp_image_header_t;
+
+typedef struct {
+	uint32_t load_addr;
+	uint32_t data_len;
+} esp_image_segment_header_t;
+
+typedef struct {
+	uint32_t magic_word;
+	uint32_t secure_version;
+	uint32_t reserv1[2];
+	char version[32];
+	char project_name[32];
+	char time[16];
+	char date[16];
+	char idf_ver[32];
+	uint8_t app_elf_sha256[32];
+	uint32_t reserv2[20];
+} esp_app_desc_t;
@@ -0,0 +1,11 @@
+// esp_log.h of ESP-IDF, errors and warnings to stdout
+#pragma once
+#include <stdio.h>
+#include "esp_err.h"
+
+#define ESP_LOGE(tag, fmt, ...) printf("E %s: " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) printf("W %s: " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...) printf("I %s: " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGD(tag, fmt, ...) (void)(tag)
+#define ESP_LOGV(tag, fmt, ...) (void)(tag)
+#define ESP_LOG_BUFFER_HEX(tag, buf, len)
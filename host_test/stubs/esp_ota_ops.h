@@ -0,0 +1,12 @@
+// esp_ota_ops.h of ESP-IDF, the partitions of the test (fakeOta.cpp)
+#pragma once
+#include "esp_app_format.h"
+#include "esp_partition.h"
+
+#define ESP_ERR_OTA_VALIDATE_FAILED 0x1503
+
+const esp_partition_t *esp_ota_get_boot_partition(void);
+const esp_partition_t *esp_ota_get_running_partition(void);
+const esp_partition_t *esp_ota_get_next_update_partition(const esp_partition_t *start_from);
+esp_err_t esp_ota_get_partition_description(const esp_partition_t *partition, esp_app_desc_t *app_desc);
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t *partition);
@@ -0,0 +1,3 @@
+// mbedtls/pk.h, no signatures on the host (CONFIG_OTA_SIGNED_MANIFEST is not set)
+#pragma once
+#include "sha256.h"
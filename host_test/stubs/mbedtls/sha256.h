@@ -0,0 +1,17 @@
+// mbedtls/sha256.h, implemented in sha256.cpp
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+	uint32_t state[8];
+	uint64_t total;
+	uint8_t buf[64];
+} mbedtls_sha256_context;
+
+void mbedtls_sha256_init(mbedtls_sha256_context *ctx);
+void mbedtls_sha256_free(mbedtls_sha256_context *ctx);
+int mbedtls_sha256_starts(mbedtls_sha256_context *ctx, int is224);
+int mbedtls_sha256_update(mbedtls_sha256_context *ctx, const unsigned char *input, size_t len);
+int mbedtls_sha256_finish(mbedtls_sha256_context *ctx, unsigned char *output);
+int mbedtls_sha256(const unsigned char *input, size_t len, unsigned char *output, int is224);
@@ -0,0 +1,52 @@
+// mdns.h of the mdns component, the query results used by lanPeer.cpp, mdns_query_ptr is answered by the test (testLanPeer.cpp)
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#define ESP_IPADDR_TYPE_V4 0
+#define ESP_IPADDR_TYPE_V6 6
+
+#define IPSTR "%d.%d.%d.%d"
+#define IP2STR(ipaddr) (int)((ipaddr)->addr & 0xff), (int)(((ipaddr)->addr >> 8) & 0xff), (int)(((ipaddr)->addr >> 16) & 0xff), (int)(((ipaddr)->addr >> 24) & 0xff)
+
+typedef struct {
+	uint32_t addr; // network order
+} esp_ip4_addr_t;
+
+typedef struct {
+	uint32_t addr[4];
+	uint8_t zone;
+} esp_ip6_addr_t;
+
+typedef struct {
+	union {
+		esp_ip6_addr_t ip6;
+		esp_ip4_addr_t ip4;
+	} u_addr;
+	uint8_t type;
+} esp_ip_addr_t;
+
+typedef struct mdns_ip_addr_s {
+	esp_ip_addr_t addr;
+	struct mdns_ip_addr_s *next;
+} mdns_ip_addr_t;
+
+typedef struct {
+	const char *key;
+	const char *value;
+} mdns_txt_item_t;
+
+typedef struct mdns_result_s {
+	struct mdns_result_s *next;
+	char *instance_name;
+	char *hostname;
+	uint16_t port;
+	mdns_txt_item_t *txt;
+	uint8_t *txt_value_len;
+	size_t txt_count;
+	mdns_ip_addr_t *addr;
+} mdns_result_t;
+
+esp_err_t mdns_query_ptr(const char *service_type, const char *proto, uint32_t timeout, size_t max_results, mdns_result_t **results);
+void mdns_query_results_free(mdns_result_t *results);
@@ -0,0 +1,9 @@
+// the options of the OTA and http components used by host_test, defaults of their Kconfig.projbuild
+#pragma once
+#define CONFIG_SPIFFS_UPGRADE_FILENAME "storage.bin"
+#define CONFIG_FIRMWARE_UPGRADE_FILENAME "firmware.bin"
+#define CONFIG_HTTPS_READ_BUFSIZE 4096
+#define CONFIG_OTA_HEATSHRINK_WINDOW_BITS 10
+#define CONFIG_OTA_HEATSHRINK_LOOKAHEAD_BITS 5
+#define CONFIG_OTA_RECV_TIMEOUT 5000
+#define CONFIG_OTA_RESUME_COMMIT_SECTORS 4
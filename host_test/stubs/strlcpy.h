@@ -0,0 +1,5 @@
+// strlcpy of newlib, for a host C library without it
+#pragma once
+#include <stddef.h>
+
+size_t strlcpy(char *dst, const char *src, size_t size);
@@ -0,0 +1,17 @@
+// wifiConnect.h of the wifiConnect component, the settings used by the OTA component
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+	char upgradeURL[128];
+	char upgradeFileName[32];
+} wifiSettings_t;
+
+extern wifiSettings_t wifiSettings;
+
+#ifdef __cplusplus
+}
+#endif
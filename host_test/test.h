@@ -0,0 +1,63 @@
+/*
+ * test.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: dig
+ *
+ *  checks and helpers of the host tests, a test program returns the number of failed checks
+ */
+
+#ifndef HOST_TEST_TEST_H_
+#define HOST_TEST_TEST_H_
+
+#include <stdio.h>
+
+#include "esp_err.h"
+#include "esp_partition.h"
+#include "updateTask.h"
+
+extern int testFailures;
+
+#define CHECK(cond)                                                          \
+	do {                                                                     \
+		if (!(cond)) {                                                       \
+			printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond);           \
+			testFailures++;                                                  \
+		}                                                                    \
+	} while (0)
+
+#define CHECK_ERR(expected, err)                                                                       \
+	do {                                                                                               \
+		esp_err_t _err = (err);                                                                        \
+		if (_err != (expected)) {                                                                      \
+			printf("FAIL %s:%d: %s is 0x%x, not %s\n", __FILE__, __LINE__, #err, _err, #expected);     \
+			testFailures++;                                                                            \
+		}                                                                                              \
+	} while (0)
+
+#define TEST(name)                      \
+	do {                                \
+		printf("-- %s\n", #name);       \
+		name();                         \
+	} while (0)
+
+// output of a stage, grows as written
+typedef struct {
+	uint8_t *data;
+	int len;
+	int size;
+} testBuf_t;
+
+uint8_t *readVector(const char *name, int *len);
+esp_err_t testBufWrite(void *ctx, const uint8_t *data, int len);
+void testBufFree(testBuf_t *buf);
+esp_err_t testFeed(updateWriteFunc_t write, void *ctx, const uint8_t *data, int len, int chunk);
+
+// partitions in memory, erased is 0xFF and a write only clears bits as on flash
+esp_partition_t *fakePartition(const char *label, uint32_t size);
+void fakePartitionLoad(esp_partition_t *partition, const uint8_t *data, int len);
+void fakePartitionDelay(esp_partition_t *partition, int eraseUs, int writeUs);
+uint8_t *fakePartitionData(const esp_partition_t *partition);
+void fakePartitionFree(esp_partition_t *partition);
+
+#endif /* HOST_TEST_TEST_H_ */
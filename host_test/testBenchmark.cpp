@@ -0,0 +1,131 @@
+/*
+ * testBenchmark.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: dig
+ *
+ *  runs otaBenchmarkTask of updateFirmWareTask.cpp against a local https server (testServer.cpp),
+ *  the manifest and the image over TLS with httpsReadFile.cpp, the update partition in RAM
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "esp_app_format.h"
+#include "fakeOta.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "manifest.h"
+#include "mbedtls/sha256.h"
+#include "otaBenchmark.h"
+#include "test.h"
+#include "testServer.h"
+#include "updateFirmWareTask.h"
+#include "wifiConnect.h"
+
+#define FOLDER "benchmark"
+#define PARTITION_SIZE (256 * 1024)
+#define TIMEOUT_MS 20000
+
+// firmware.bin with an app description, and its manifest
+static uint8_t *makeServerFolder(int *len) {
+	uint8_t *image = readVector("firmware.bin", len);
+	esp_app_desc_t desc = {};
+	uint8_t hash[32];
+
+	if (image == NULL)
+		return NULL;
+	strcpy(desc.version, "1.1");
+	strcpy(desc.project_name, "host_test");
+	memcpy(image + sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t), &desc, sizeof(desc));
+	mbedtls_sha256(image, *len, hash, 0);
+
+	mkdir(FOLDER, 0755);
+	FILE *f = fopen(FOLDER "/firmware.bin", "wb");
+	fwrite(image, 1, *len, f);
+	fclose(f);
+	f = fopen(FOLDER "/" MANIFEST_FILENAME, "w");
+	fprintf(f, "firmware.version=1.1\nfirmware.file=firmware.bin\nfirmware.size=%d\nfirmware.sha256=", *len);
+	for (int n = 0; n < 32; n++)
+		fprintf(f, "%02x", hash[n]);
+	fprintf(f, "\n");
+	fclose(f);
+	return image;
+}
+
+// one run of otaBenchmarkTask for entry, as updateTask starts it
+static void runBenchmark(manifestEntry_t *entry, bool flash) {
+	CHECK(otaBenchmarkStart(flash));
+	CHECK(xTaskCreate(&otaBenchmarkTask, "otaBenchmarkTask", 2 * 8192, entry, 5, NULL) == pdPASS);
+	for (int ms = 0; (otaBenchmark.state != BENCH_DONE) && (ms < TIMEOUT_MS); ms += 10)
+		vTaskDelay(10 / portTICK_PERIOD_MS);
+	CHECK(otaBenchmark.state == BENCH_DONE);
+}
+
+static void checkTimings(int len) {
+	CHECK_ERR(ESP_OK, otaBenchmark.result);
+	CHECK(updateStatus == UPDATE_RDY);
+	CHECK(otaBenchmark.bytes == len);
+	CHECK(otaBenchmark.blocks == (len + CONFIG_HTTPS_READ_BUFSIZE - 1) / CONFIG_HTTPS_READ_BUFSIZE);
+	CHECK(otaBenchmark.probe.dnsUs > 0);
+	CHECK(otaBenchmark.probe.tcpUs > 0);
+	CHECK(otaBenchmark.connect.connectUs > 0); // handshake of the download connection
+	CHECK(otaBenchmark.connect.requestUs >= 0);
+	CHECK(otaBenchmark.connect.ttfbUs > 0);
+	CHECK(otaBenchmark.downloadUs > otaBenchmark.connect.connectUs);
+}
+
+int main() {
+	updateManifest_t manifest = {};
+	char report[768];
+	int len;
+
+	uint8_t *image = makeServerFolder(&len);
+	int port = testServerStart(FOLDER, true);
+	CHECK(image != NULL);
+	CHECK(port != 0);
+	if ((image == NULL) || (port == 0))
+		return testFailures;
+	snprintf(wifiSettings.upgradeURL, sizeof(wifiSettings.upgradeURL), "https://127.0.0.1:%d", port);
+	fakeOtaBegin(PARTITION_SIZE);
+
+	// manifest over the session as updateTask reads it
+	CHECK_ERR(ESP_OK, httpsSessionBegin(wifiSettings.upgradeURL));
+	CHECK_ERR(ESP_OK, getManifest(&manifest));
+	httpsSessionEnd();
+	CHECK(strcmp(manifest.firmware.version, "1.1") == 0);
+	CHECK(manifest.firmware.size == len);
+
+	printf("-- download only\n");
+	runBenchmark(&manifest.firmware, false);
+	checkTimings(len);
+	CHECK(otaBenchmark.flashUs == 0);
+	CHECK(fakePartitionData(fakeOtaUpdate)[0] == 0xFF); // not touched
+	CHECK(testServerRequests("/firmware.bin") == 1);
+	otaBenchmarkReport(report, sizeof(report));
+	CHECK(strstr(report, "result=ESP_OK\n") != NULL);
+	CHECK(strstr(report, "connect=") != NULL);
+	CHECK(strstr(report, "dns_probe=") != NULL);
+
+	printf("-- flash\n");
+	runBenchmark(&manifest.firmware, true);
+	checkTimings(len);
+	CHECK(otaBenchmark.flashUs > 0);
+	CHECK(memcmp(fakePartitionData(fakeOtaUpdate), image, len) == 0);
+	CHECK(fakePartitionData(fakeOtaRunning)[0] == 0xFF);
+	CHECK(fakeOtaBoot == NULL); // the boot partition is never changed
+
+	printf("-- image missing\n");
+	manifestEntry_t missing = manifest.firmware;
+	strcpy(missing.fileName, "missing.bin");
+	runBenchmark(&missing, false);
+	CHECK(otaBenchmark.result != ESP_OK);
+	CHECK(updateStatus == UPDATE_ERROR);
+	CHECK(otaBenchmark.bytes == 0);
+
+	testServerStop();
+	fakeOtaEnd();
+	free(image);
+	return testFailures;
+}
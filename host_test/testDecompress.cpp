@@ -0,0 +1,87 @@
+/*
+ * testDecompress.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: dig
+ *
+ *  firmware.bin.hs (compressImage.py) decompresses to firmware.bin
+ */
+
+#include <string.h>
+
+#include "decompress.h"
+#include "test.h"
+
+static uint8_t *target;
+static int targetLen;
+
+static esp_err_t decompress(const uint8_t *data, int len, int chunk, testBuf_t *out) {
+	decompress_t dec;
+
+	esp_err_t err = decompressBegin(&dec, decompressFind("firmware.bin.hs"), testBufWrite, out);
+	if (err == ESP_OK)
+		err = testFeed(decompressWrite, &dec, data, len, chunk);
+	if (err == ESP_OK)
+		return decompressEnd(&dec);
+	decompressAbort(&dec);
+	return err;
+}
+
+static void testFind() {
+	CHECK(decompressFind("firmware.bin.hs") != NULL);
+	CHECK(decompressFind("firmware.bin") == NULL);
+	CHECK(decompressFind(".hs") == NULL);
+	CHECK(strcmp(decompressExtension("delta_1.0_1.1.bin.hs"), ".hs") == 0);
+	CHECK(strcmp(decompressExtension("storage.bin"), "") == 0);
+}
+
+static void testGoodImage() {
+	int len;
+	uint8_t *data = readVector("firmware.bin.hs", &len);
+	const int chunks[] = {1, 13, 1024, 4096, len};
+
+	for (int chunk : chunks) {
+		testBuf_t out = {};
+		CHECK_ERR(ESP_OK, decompress(data, len, chunk, &out));
+		CHECK((out.len == targetLen) && (memcmp(out.data, target, targetLen) == 0));
+		testBufFree(&out);
+	}
+	free(data);
+}
+
+// heatshrink has no length, a stream cut between two symbols decodes fine and is found by the size or sha256 of the image
+static void testTruncated() {
+	int len;
+	uint8_t *data = readVector("firmware.bin.hs.short", &len);
+	testBuf_t out = {};
+
+	esp_err_t err = decompress(data, len, 512, &out);
+	CHECK((err != ESP_OK) || (out.len < targetLen));
+	CHECK(memcmp(out.data, target, out.len) == 0);
+	testBufFree(&out);
+	free(data);
+}
+
+// a literal cut in its 8 bits
+static void testCutSymbol() {
+	const uint8_t literal[] = {0xFF};
+	testBuf_t out = {};
+
+	CHECK_ERR(ESP_ERR_INVALID_SIZE, decompress(literal, sizeof(literal), 1, &out));
+	CHECK(out.len == 0);
+	testBufFree(&out);
+}
+
+int main() {
+	target = readVector("firmware.bin", &targetLen);
+	if (target == NULL)
+		return 1;
+
+	TEST(testFind);
+	TEST(testGoodImage);
+	TEST(testTruncated);
+	TEST(testCutSymbol);
+
+	free(target);
+	return testFailures;
+}
@@ -0,0 +1,125 @@
+/*
+ * testDeltaPatch.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: dig
+ *
+ *  delta_1.0_1.1.bin (makeDelta.py) applied to firmware_1.0.bin in the running partition gives firmware.bin
+ */
+
+#include <string.h>
+
+#include "deltaPatch.h"
+#include "test.h"
+
+static uint8_t *target;
+static int targetLen;
+static esp_partition_t *running;
+
+static esp_err_t patchWrite(void *ctx, const uint8_t *data, int len) {
+	return deltaPatchWrite((deltaPatch_t *)ctx, data, len);
+}
+
+// applies the patch in blocks of chunk bytes, the error of write or end
+static esp_err_t applyPatch(const uint8_t *patchData, int len, int chunk, testBuf_t *out) {
+	static deltaPatch_t patch;
+
+	deltaPatchBegin(&patch, running, testBufWrite, out);
+	esp_err_t err = testFeed(patchWrite, &patch, patchData, len, chunk);
+	return (err == ESP_OK) ? deltaPatchEnd(&patch) : err;
+}
+
+static void testGoodPatch() {
+	int len;
+	uint8_t *data = readVector("delta_1.0_1.1.bin", &len);
+	const int chunks[] = {1, 7, 256, 4096, len};
+
+	for (int chunk : chunks) {
+		testBuf_t out = {};
+		CHECK_ERR(ESP_OK, applyPatch(data, len, chunk, &out));
+		CHECK((out.len == targetLen) && (memcmp(out.data, target, targetLen) == 0));
+		testBufFree(&out);
+	}
+	free(data);
+}
+
+// a patch made for another version is refused before anything is written
+static void testWrongSource() {
+	int len;
+	uint8_t *data = readVector("delta_1.0_1.1.bin", &len);
+	testBuf_t out = {};
+
+	fakePartitionLoad(running, target, targetLen);
+	CHECK_ERR(ESP_ERR_INVALID_VERSION, applyPatch(data, len, 512, &out));
+	CHECK(out.len == 0);
+	testBufFree(&out);
+	free(data);
+}
+
+static void testTruncated() {
+	int len;
+	uint8_t *data = readVector("delta_1.0_1.1.bin.short", &len);
+	testBuf_t out = {};
+
+	CHECK_ERR(ESP_ERR_INVALID_SIZE, applyPatch(data, len, 512, &out));
+	CHECK(out.len < targetLen);
+	testBufFree(&out);
+	free(data);
+}
+
+static void testCorrupt() {
+	int len;
+	uint8_t *data = readVector("delta_1.0_1.1.bin.corrupt", &len);
+	testBuf_t out = {};
+
+	CHECK_ERR(ESP_ERR_INVALID_RESPONSE, applyPatch(data, len, 512, &out));
+	data[0] = 'X'; // magic
+	CHECK_ERR(ESP_ERR_INVALID_RESPONSE, applyPatch(data, len, 512, &out));
+	CHECK(out.len == 0);
+	testBufFree(&out);
+	free(data);
+}
+
+// sizes beyond the source or the target, data after the end
+static void testOutOfRange() {
+	int len;
+	uint8_t *data = readVector("delta_1.0_1.1.bin", &len);
+	uint8_t *longer = (uint8_t *)malloc(len + 1);
+	testBuf_t out = {};
+
+	memcpy(longer, data, len);
+	longer[len] = DELTA_OP_ADD;
+	CHECK_ERR(ESP_ERR_INVALID_SIZE, applyPatch(longer, len + 1, 512, &out));
+	testBufFree(&out);
+
+	data[5] = 0xFF; // source size, 3 byte varint, now larger than the partition
+	data[6] = 0xFF;
+	data[7] = 0x7F;
+	CHECK_ERR(ESP_ERR_INVALID_SIZE, applyPatch(data, len, 512, &out));
+	CHECK(out.len == 0);
+	testBufFree(&out);
+	free(longer);
+	free(data);
+}
+
+int main() {
+	int sourceLen;
+	uint8_t *source = readVector("firmware_1.0.bin", &sourceLen);
+
+	target = readVector("firmware.bin", &targetLen);
+	if ((source == NULL) || (target == NULL))
+		return 1;
+	running = fakePartition("ota_0", 64 * 1024);
+	fakePartitionLoad(running, source, sourceLen);
+
+	TEST(testGoodPatch);
+	TEST(testTruncated);
+	TEST(testCorrupt);
+	TEST(testOutOfRange);
+	TEST(testWrongSource);
+
+	fakePartitionFree(running);
+	free(source);
+	free(target);
+	return testFailures;
+}
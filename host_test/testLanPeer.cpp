@@ -0,0 +1,172 @@
+/*
+ * testLanPeer.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: dig
+ *
+ *  lanPeerFind on mdns answers made by the test, and updateFirmwareTask with CONFIG_OTA_LAN_PEERS against a local http server
+ *  (testServer.cpp) that is both the peer and the update server: a peer image that does not match the manifest is not used
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "fakeOta.h"
+#include "lanPeer.h"
+#include "mdns.h"
+#include "test.h"
+#include "testServer.h"
+#include "updateFirmWareTask.h"
+#include "wifiConnect.h"
+
+#define FOLDER "lanPeer"
+#define PARTITION_SIZE (256 * 1024)
+#define TIMEOUT_MS 20000
+
+typedef struct {
+	mdns_result_t result;
+	mdns_txt_item_t txt[2];
+	mdns_ip_addr_t addr[2];
+} peer_t;
+
+static mdns_result_t *answer;
+static esp_err_t answerErr;
+static int queries;
+
+esp_err_t mdns_query_ptr(const char *service_type, const char *proto, uint32_t timeout, size_t max_results, mdns_result_t **results) {
+	queries++;
+	CHECK(strcmp(service_type, LAN_PEER_SERVICE) == 0);
+	CHECK(strcmp(proto, LAN_PEER_PROTO) == 0);
+	*results = answer;
+	return answerErr;
+}
+
+void mdns_query_results_free(mdns_result_t *results) {
+	CHECK(results == answer); // the peers are static
+}
+
+// as IP2STR prints it
+static uint32_t ip4(int a, int b, int c, int d) {
+	return a | (b << 8) | (c << 16) | ((uint32_t)d << 24);
+}
+
+// fw NULL: no txt fw, path NULL: the default path, ip 0: IPv6 only
+static mdns_result_t *makePeer(peer_t *peer, const char *fw, const char *path, uint32_t ip, uint16_t port, mdns_result_t *next) {
+	memset(peer, 0, sizeof(*peer));
+	if (fw)
+		peer->txt[peer->result.txt_count++] = {"fw", fw};
+	if (path)
+		peer->txt[peer->result.txt_count++] = {"path", path};
+	peer->addr[0].addr.type = ESP_IPADDR_TYPE_V6;
+	if (ip) {
+		peer->addr[0].next = &peer->addr[1]; // IPv6 first, as mdns often answers
+		peer->addr[1].addr.type = ESP_IPADDR_TYPE_V4;
+		peer->addr[1].addr.u_addr.ip4.addr = ip;
+	}
+	peer->result.txt = peer->txt;
+	peer->result.addr = peer->addr;
+	peer->result.port = port;
+	peer->result.next = next;
+	return &peer->result;
+}
+
+static void testSelect(void) {
+	peer_t peers[5];
+	char url[128];
+
+	answer = NULL;
+	answerErr = ESP_OK;
+	CHECK(!lanPeerFind("1.1", url, sizeof(url))); // nobody answers
+	answer = makePeer(&peers[0], "1.1", NULL, ip4(10, 0, 0, 1), 80, NULL);
+	answerErr = ESP_ERR_TIMEOUT;
+	CHECK(!lanPeerFind("1.1", url, sizeof(url)));
+	answerErr = ESP_OK;
+
+	answer = makePeer(&peers[0], "1.0", NULL, ip4(10, 0, 0, 1), 80,	  // other version
+					  makePeer(&peers[1], "1.1", NULL, 0, 80,		  // IPv6 only
+							   makePeer(&peers[2], NULL, NULL, ip4(10, 0, 0, 3), 80, // no version
+										makePeer(&peers[3], "1.1", NULL, ip4(10, 0, 0, 4), 8080,
+												 makePeer(&peers[4], "1.1", "/x", ip4(10, 0, 0, 5), 80, NULL)))));
+	CHECK(lanPeerFind("1.1", url, sizeof(url)));
+	CHECK(strcmp(url, "http://10.0.0.4:8080" LAN_PEER_FIRMWARE_PATH) == 0);
+	CHECK(!lanPeerFind("1.2", url, sizeof(url)));
+
+	answer = &peers[4].result; // path from the txt record
+	CHECK(lanPeerFind("1.1", url, sizeof(url)));
+	CHECK(strcmp(url, "http://10.0.0.5:80/x") == 0);
+}
+
+// the update with peer as the only answer, returns the requests of the image on the server
+static int runUpdate(manifestEntry_t *entry, mdns_result_t *peer) {
+	int before = testServerRequests("/firmware.bin");
+
+	answer = peer;
+	answerErr = ESP_OK;
+	fakeOtaBoot = NULL;
+	memset(fakePartitionData(fakeOtaUpdate), 0xFF, PARTITION_SIZE);
+	CHECK(fakeOtaRun(&updateFirmwareTask, entry, TIMEOUT_MS));
+	return testServerRequests("/firmware.bin") - before;
+}
+
+static void checkUpdated(const uint8_t *image, int len) {
+	CHECK(updateStatus == UPDATE_RDY);
+	CHECK(fakeOtaBoot == fakeOtaUpdate);
+	CHECK(memcmp(fakePartitionData(fakeOtaUpdate), image, len) == 0);
+}
+
+int main() {
+	manifestEntry_t entry;
+	peer_t peer;
+	int len;
+
+	printf("-- select\n");
+	testSelect();
+
+	uint8_t *image = readVector("firmware.bin", &len);
+	CHECK(image != NULL);
+	if (image == NULL)
+		return testFailures;
+	fakeOtaImage(FOLDER, "firmware.bin", image, len, &entry);
+	strcpy(entry.version, "1.1");
+	fakeOtaImage(FOLDER, "good.bin", image, len, NULL); // a peer serving the same image
+	image[len / 2] ^= 0x01;
+	fakeOtaImage(FOLDER, "bad.bin", image, len, NULL);
+	image[len / 2] ^= 0x01;
+	int port = testServerStart(FOLDER, false);
+	CHECK(port != 0);
+	if (port == 0)
+		return testFailures;
+	snprintf(wifiSettings.upgradeURL, sizeof(wifiSettings.upgradeURL), "http://127.0.0.1:%d", port);
+	fakeOtaBegin(PARTITION_SIZE);
+
+	printf("-- peer\n");
+	CHECK(runUpdate(&entry, makePeer(&peer, "1.1", "/good.bin", ip4(127, 0, 0, 1), port, NULL)) == 0);
+	checkUpdated(image, len);
+	CHECK(testServerRequests("/good.bin") == 1);
+
+	printf("-- peer image does not match the manifest\n");
+	CHECK(runUpdate(&entry, makePeer(&peer, "1.1", "/bad.bin", ip4(127, 0, 0, 1), port, NULL)) == 1);
+	checkUpdated(image, len);
+	CHECK(testServerRequests("/bad.bin") == 1);
+
+	printf("-- peer without the image\n");
+	CHECK(runUpdate(&entry, makePeer(&peer, "1.1", "/missing.bin", ip4(127, 0, 0, 1), port, NULL)) == 1);
+	checkUpdated(image, len);
+
+	printf("-- no peer\n");
+	CHECK(runUpdate(&entry, NULL) == 1);
+	checkUpdated(image, len);
+
+	printf("-- manifest without sha256\n");
+	entry.hasSha256 = false;
+	int before = queries;
+	CHECK(runUpdate(&entry, makePeer(&peer, "1.1", "/good.bin", ip4(127, 0, 0, 1), port, NULL)) == 1);
+	checkUpdated(image, len);
+	CHECK(queries == before); // a peer is not asked
+	CHECK(testServerRequests("/good.bin") == 1);
+
+	testServerStop();
+	fakeOtaEnd();
+	free(image);
+	return testFailures;
+}
@@ -0,0 +1,129 @@
+/*
+ * testManifest.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: dig
+ *
+ *  manifest.txt (makeManifest.py --tree) read from the fake server, and the version files of a server without manifest
+ */
+
+#include <string.h>
+
+#include "fakeServer.h"
+#include "manifest.h"
+#include "mbedtls/sha256.h"
+#include "test.h"
+#include "wifiConnect.h"
+
+static updateManifest_t manifest;
+
+static bool hashOf(const char *vector, const uint8_t *hash) {
+	uint8_t sha256[32];
+	int len;
+	uint8_t *data = readVector(vector, &len);
+
+	mbedtls_sha256(data, len, sha256, 0);
+	free(data);
+	return memcmp(sha256, hash, sizeof(sha256)) == 0;
+}
+
+static void testParseHex() {
+	uint8_t buf[4];
+
+	CHECK(manifestParseHex("00ff7A", buf, sizeof(buf)) == 3);
+	CHECK((buf[0] == 0x00) && (buf[1] == 0xFF) && (buf[2] == 0x7A));
+	CHECK(manifestParseHex("", buf, sizeof(buf)) == 0);
+	CHECK(manifestParseHex("123", buf, sizeof(buf)) == -1);
+	CHECK(manifestParseHex("zz", buf, sizeof(buf)) == -1);
+	CHECK(manifestParseHex("0-", buf, sizeof(buf)) == -1);
+	CHECK(manifestParseHex("0011223344", buf, sizeof(buf)) == -1);
+}
+
+static void testManifest() {
+	fakeServerBegin("");
+	CHECK_ERR(ESP_OK, getManifest(&manifest));
+	CHECK(fakeServerRequests(MANIFEST_FILENAME) == 1);
+	CHECK(fakeServerRequests(BINARY_INFO_FILENAME) == 0);
+
+	CHECK(strcmp(manifest.firmware.version, "1.1") == 0);
+	CHECK(strcmp(manifest.firmware.fileName, "firmware.bin.hs") == 0);
+	CHECK(manifest.firmware.size == 45700);
+	CHECK(manifest.firmware.hasSha256 && hashOf("firmware.bin", manifest.firmware.sha256));
+	CHECK(manifest.firmware.hasTree);
+	CHECK(manifest.firmware.signatureLen == 0);
+	CHECK(strcmp(manifest.firmware.deltaFrom, "1.0") == 0);
+
+	CHECK(strcmp(manifest.storage.version, "1.1") == 0);
+	CHECK(strcmp(manifest.storage.fileName, "storage.bin") == 0);
+	CHECK(manifest.storage.size == 22990);
+	CHECK(manifest.storage.hasSha256 && hashOf("storage.bin", manifest.storage.sha256));
+	CHECK(manifest.storage.hasTree);
+	CHECK(!manifest.storage.hasFiles);
+}
+
+// the next poll gets 304, the manifest is left as it is
+static void testNotModified() {
+	strcpy(manifest.firmware.version, "kept");
+	CHECK_ERR(ESP_OK, getManifest(&manifest));
+	CHECK(fakeServerRequests(MANIFEST_FILENAME) == 2);
+	CHECK(strcmp(manifest.firmware.version, "kept") == 0);
+}
+
+// invalid hex is not used, the file names are the defaults
+static void testBadManifest() {
+	fakeServerBegin("bad");
+	CHECK_ERR(ESP_OK, getManifest(&manifest));
+	CHECK(strcmp(manifest.firmware.version, "1.1") == 0);
+	CHECK(!manifest.firmware.hasSha256);
+	CHECK(strcmp(manifest.firmware.fileName, wifiSettings.upgradeFileName) == 0);
+	CHECK(strcmp(manifest.storage.version, "1.2") == 0);
+	CHECK(!manifest.storage.hasTree);
+	CHECK(strcmp(manifest.storage.fileName, CONFIG_SPIFFS_UPGRADE_FILENAME) == 0);
+}
+
+static void testHasDelta() {
+	manifestEntry_t entry = {};
+
+	strcpy(entry.deltaFrom, "1.0 0.9,0.8");
+	CHECK(manifestHasDelta(&entry, "1.0"));
+	CHECK(manifestHasDelta(&entry, "0.8"));
+	CHECK(!manifestHasDelta(&entry, "1.1"));
+	CHECK(!manifestHasDelta(&entry, "1"));
+	strcpy(entry.deltaFrom, "*");
+	CHECK(manifestHasDelta(&entry, "1.1"));
+	entry.deltaFrom[0] = 0;
+	CHECK(!manifestHasDelta(&entry, "1.1"));
+}
+
+// 404: the version files are read, the manifest is not asked for again
+// the versions are kept while the version files are not modified
+static void testNoManifest() {
+	fakeServerBegin("noManifest");
+	for (int poll = 1; poll <= 3; poll++) {
+		CHECK_ERR(ESP_OK, getManifest(&manifest));
+		CHECK(strcmp(manifest.firmware.version, "1.1") == 0);
+		CHECK(strcmp(manifest.storage.version, "1.2") == 0);
+		CHECK(strcmp(manifest.firmware.deltaFrom, "*") == 0);
+		CHECK(fakeServerRequests(MANIFEST_FILENAME) == 1);
+		CHECK(fakeServerRequests(BINARY_INFO_FILENAME) == poll);
+		CHECK(fakeServerRequests(SPIFFS_INFO_FILENAME) == poll);
+	}
+}
+
+static void testNoServer() {
+	fakeServerBegin("missing");
+	CHECK_ERR(ESP_FAIL, getManifest(&manifest));
+	CHECK(fakeServerRequests(MANIFEST_FILENAME) == 0);
+	CHECK(manifest.firmware.version[0] == 0);
+}
+
+int main() {
+	TEST(testParseHex);
+	TEST(testManifest);
+	TEST(testNotModified);
+	TEST(testBadManifest);
+	TEST(testHasDelta);
+	TEST(testNoManifest);
+	TEST(testNoServer);
+	return testFailures;
+}
@@ -0,0 +1,187 @@
+/*
+ * testMerkle.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: dig
+ *
+ *  the chunks of storage.bin and firmware.bin checked against their .tree (makeManifest.py --tree)
+ */
+
+#include <string.h>
+
+#include "decompress.h"
+#include "fakeServer.h"
+#include "merkle.h"
+#include "test.h"
+
+static updateManifest_t manifest;
+static uint8_t *storage;
+static int storageLen;
+static merkle_t merkle;
+
+// as in verify.cpp
+void verifyUpdate(imageVerify_t *verify, const uint8_t *data, int len) {
+	if (verify->active)
+		mbedtls_sha256_update(&verify->ctx, data, len);
+}
+
+static esp_err_t check(const uint8_t *data, int len, int chunk, size_t offset, testBuf_t *out) {
+	merkleBegin(&merkle, offset, testBufWrite, out);
+	esp_err_t err = testFeed(merkleWrite, &merkle, data, len, chunk);
+	return (err == ESP_OK) ? merkleEnd(&merkle) : err;
+}
+
+static void testLoad() {
+	CHECK_ERR(ESP_OK, merkleLoad(&merkle, &manifest.storage));
+	CHECK(merkle.nrLeaves == (storageLen + MERKLE_CHUNKSIZE - 1) / MERKLE_CHUNKSIZE);
+	CHECK(fakeServerRequests("storage.bin.tree") == 1);
+	merkleFree(&merkle);
+}
+
+static void testGoodImage() {
+	const int chunks[] = {1000, MERKLE_CHUNKSIZE, 5000, storageLen};
+
+	CHECK_ERR(ESP_OK, merkleLoad(&merkle, &manifest.storage));
+	for (int chunk : chunks) {
+		testBuf_t out = {};
+		CHECK_ERR(ESP_OK, check(storage, storageLen, chunk, 0, &out));
+		CHECK((out.len == storageLen) && (memcmp(out.data, storage, storageLen) == 0));
+		CHECK(!merkle.failed);
+		testBufFree(&out);
+	}
+	// resumed after two chunks
+	testBuf_t out = {};
+	CHECK_ERR(ESP_OK, check(storage + 2 * MERKLE_CHUNKSIZE, storageLen - 2 * MERKLE_CHUNKSIZE, 512, 2 * MERKLE_CHUNKSIZE, &out));
+	CHECK(out.len == storageLen - 2 * MERKLE_CHUNKSIZE);
+	testBufFree(&out);
+	merkleFree(&merkle);
+}
+
+// stops at the bad chunk, the chunks before it are passed on
+static void testCorruptChunk() {
+	uint8_t *data = (uint8_t *)malloc(storageLen);
+	testBuf_t out = {};
+
+	memcpy(data, storage, storageLen);
+	data[3 * MERKLE_CHUNKSIZE + 10] ^= 1;
+	CHECK_ERR(ESP_OK, merkleLoad(&merkle, &manifest.storage));
+	CHECK_ERR(ESP_ERR_INVALID_CRC, check(data, storageLen, 1024, 0, &out));
+	CHECK(merkle.failed);
+	CHECK(merkle.chunk == 3);
+	CHECK(out.len == 3 * MERKLE_CHUNKSIZE);
+	testBufFree(&out);
+	merkleFree(&merkle);
+	free(data);
+}
+
+// cut in a chunk: that chunk does not match, cut between chunks: chunks missing
+static void testTruncated() {
+	testBuf_t out = {};
+
+	CHECK_ERR(ESP_OK, merkleLoad(&merkle, &manifest.storage));
+	CHECK_ERR(ESP_ERR_INVALID_CRC, check(storage, storageLen - 100, 1024, 0, &out));
+	testBufFree(&out);
+	CHECK_ERR(ESP_ERR_INVALID_SIZE, check(storage, 4 * MERKLE_CHUNKSIZE, 1024, 0, &out));
+	CHECK(!merkle.failed);
+	testBufFree(&out);
+	merkleFree(&merkle);
+}
+
+static void testBadTree() {
+	manifestEntry_t entry = manifest.storage;
+
+	strcpy(entry.fileName, "corrupt.bin");
+	CHECK_ERR(ESP_ERR_INVALID_CRC, merkleLoad(&merkle, &entry));
+	CHECK(merkle.leaves == NULL);
+	strcpy(entry.fileName, "short.bin");
+	CHECK_ERR(ESP_FAIL, merkleLoad(&merkle, &entry));
+	CHECK(merkle.leaves == NULL);
+	strcpy(entry.fileName, "missing.bin");
+	CHECK_ERR(ESP_FAIL, merkleLoad(&merkle, &entry));
+	entry.size = 0;
+	CHECK_ERR(ESP_ERR_INVALID_SIZE, merkleLoad(&merkle, &entry));
+	entry.hasTree = false;
+	CHECK_ERR(ESP_OK, merkleLoad(&merkle, &entry));
+	CHECK(merkle.leaves == NULL);
+}
+
+// a resumed download continues from the first bad chunk in flash
+static void testCheckFlash() {
+	esp_partition_t *partition = fakePartition("storage", 64 * 1024);
+	size_t len = 5 * MERKLE_CHUNKSIZE;
+	imageVerify_t verify = {};
+	uint8_t hash[32], expected[32];
+
+	fakePartitionLoad(partition, storage, storageLen);
+	CHECK_ERR(ESP_OK, merkleLoad(&merkle, &manifest.storage));
+	verify.active = true;
+	mbedtls_sha256_init(&verify.ctx);
+	mbedtls_sha256_starts(&verify.ctx, 0);
+	CHECK(merkleCheckFlash(&merkle, partition, len, &verify) == len);
+	CHECK(merkleCheckFlash(&merkle, partition, storageLen, &verify) == (size_t)storageLen);
+
+	fakePartitionData(partition)[2 * MERKLE_CHUNKSIZE + 100] ^= 0x80;
+	mbedtls_sha256_starts(&verify.ctx, 0);
+	CHECK(merkleCheckFlash(&merkle, partition, len, &verify) == 2 * MERKLE_CHUNKSIZE);
+	mbedtls_sha256_finish(&verify.ctx, hash);
+	mbedtls_sha256(storage, 2 * MERKLE_CHUNKSIZE, expected, 0);
+	CHECK(memcmp(hash, expected, sizeof(hash)) == 0);
+
+	merkleFree(&merkle);
+	fakePartitionFree(partition);
+}
+
+// firmware.bin.hs through decompress and merkle, as in the update tasks
+static void testCompressedChain() {
+	int len, targetLen;
+	uint8_t *data = readVector("firmware.bin.hs", &len);
+	uint8_t *target = readVector("firmware.bin", &targetLen);
+	decompress_t dec;
+
+	CHECK_ERR(ESP_OK, merkleLoad(&merkle, &manifest.firmware));
+	for (int corrupt = 0; corrupt < 2; corrupt++) {
+		testBuf_t out = {};
+		if (corrupt)
+			data[len / 2] ^= 0x10;
+		merkleBegin(&merkle, 0, testBufWrite, &out);
+		decompressBegin(&dec, decompressFind(manifest.firmware.fileName), merkleWrite, &merkle);
+		esp_err_t err = testFeed(decompressWrite, &dec, data, len, 1460);
+		if (err == ESP_OK)
+			err = decompressEnd(&dec);
+		else
+			decompressAbort(&dec);
+		if (err == ESP_OK)
+			err = merkleEnd(&merkle);
+		if (corrupt) {
+			CHECK_ERR(ESP_ERR_INVALID_CRC, err);
+			CHECK(out.len < targetLen);
+		} else {
+			CHECK_ERR(ESP_OK, err);
+			CHECK((out.len == targetLen) && (memcmp(out.data, target, targetLen) == 0));
+		}
+		testBufFree(&out);
+	}
+	merkleFree(&merkle);
+	free(data);
+	free(target);
+}
+
+int main() {
+	storage = readVector("storage.bin", &storageLen);
+	if (storage == NULL)
+		return 1;
+	fakeServerBegin("");
+	if (getManifest(&manifest) != ESP_OK)
+		return 1;
+
+	TEST(testLoad);
+	TEST(testGoodImage);
+	TEST(testCorruptChunk);
+	TEST(testTruncated);
+	TEST(testBadTree);
+	TEST(testCheckFlash);
+	TEST(testCompressedChain);
+
+	free(storage);
+	return testFailures;
+}
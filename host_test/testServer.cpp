@@ -0,0 +1,227 @@
+/*
+ * testServer.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: dig
+ */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <openssl/evp.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "testServer.h"
+
+#define MAX_PATHS 16
+
+static char root[256];
+static int listenSock = -1;
+static SSL_CTX *ctx; // NULL: http
+static pthread_mutex_t logLock = PTHREAD_MUTEX_INITIALIZER;
+static struct {
+	char path[64];
+	int requests;
+} requestLog[MAX_PATHS];
+
+typedef struct {
+	int sock;
+	SSL *ssl;
+	char in[2048];
+	int inLen;
+} connection_t;
+
+static void logRequest(const char *path) {
+	pthread_mutex_lock(&logLock);
+	for (int n = 0; n < MAX_PATHS; n++) {
+		if ((requestLog[n].path[0] == 0) || (strcmp(requestLog[n].path, path) == 0)) {
+			strncpy(requestLog[n].path, path, sizeof(requestLog[n].path) - 1);
+			requestLog[n].requests++;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&logLock);
+}
+
+int testServerRequests(const char *path) {
+	int requests = 0;
+	pthread_mutex_lock(&logLock);
+	for (int n = 0; n < MAX_PATHS; n++) {
+		if (strcmp(requestLog[n].path, path) == 0)
+			requests = requestLog[n].requests;
+	}
+	pthread_mutex_unlock(&logLock);
+	return requests;
+}
+
+static bool sendAll(connection_t *conn, const void *data, int len) {
+	for (int sent = 0; sent < len;) {
+		int n = conn->ssl ? SSL_write(conn->ssl, (const char *)data + sent, len - sent)
+						  : send(conn->sock, (const char *)data + sent, len - sent, MSG_NOSIGNAL);
+		if (n <= 0)
+			return false;
+		sent += n;
+	}
+	return true;
+}
+
+// the header of the next request into conn->in, false when the client closed the connection
+static bool receiveRequest(connection_t *conn) {
+	conn->inLen = 0;
+	conn->in[0] = 0;
+	while (!strstr(conn->in, "\r\n\r\n")) {
+		if (conn->inLen == sizeof(conn->in) - 1)
+			return false;
+		int n = conn->ssl ? SSL_read(conn->ssl, conn->in + conn->inLen, sizeof(conn->in) - 1 - conn->inLen)
+						  : recv(conn->sock, conn->in + conn->inLen, sizeof(conn->in) - 1 - conn->inLen, 0);
+		if (n <= 0)
+			return false;
+		conn->inLen += n;
+		conn->in[conn->inLen] = 0;
+	}
+	return true;
+}
+
+static bool respond(connection_t *conn) {
+	char path[128], filePath[512], header[256];
+	long rangeStart = 0;
+
+	if (sscanf(conn->in, "GET %127s HTTP/1.1", path) != 1)
+		return false;
+	for (char *line = strstr(conn->in, "\r\n"); line; line = strstr(line + 2, "\r\n")) {
+		if (strncasecmp(line + 2, "Range: bytes=", 13) == 0)
+			rangeStart = strtol(line + 2 + 13, NULL, 10);
+	}
+	logRequest(path);
+	snprintf(filePath, sizeof(filePath), "%s%s", root, path);
+	FILE *f = strstr(path, "..") ? NULL : fopen(filePath, "rb");
+	if (f == NULL) {
+		int len = snprintf(header, sizeof(header), "HTTP/1.1 404 Not Found\r\nContent-Length: 9\r\n\r\nnot found");
+		return sendAll(conn, header, len);
+	}
+	fseek(f, 0, SEEK_END);
+	long size = ftell(f);
+	if (rangeStart > size)
+		rangeStart = size;
+	fseek(f, rangeStart, SEEK_SET);
+	int len;
+	if (rangeStart > 0)
+		len = snprintf(header, sizeof(header), "HTTP/1.1 206 Partial Content\r\nContent-Length: %ld\r\nContent-Range: bytes %ld-%ld/%ld\r\n\r\n",
+					   size - rangeStart, rangeStart, size - 1, size);
+	else
+		len = snprintf(header, sizeof(header), "HTTP/1.1 200 OK\r\nContent-Length: %ld\r\nETag: \"%ld\"\r\n\r\n", size, size);
+	bool ok = sendAll(conn, header, len);
+	char buf[4096];
+	size_t n;
+	while (ok && ((n = fread(buf, 1, sizeof(buf), f)) > 0))
+		ok = sendAll(conn, buf, n);
+	fclose(f);
+	return ok;
+}
+
+static void *connectionThread(void *arg) {
+	connection_t *conn = (connection_t *)arg;
+	int on = 1;
+
+	setsockopt(conn->sock, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on)); // header and body go out at once
+	if (ctx) {
+		conn->ssl = SSL_new(ctx);
+		SSL_set_fd(conn->ssl, conn->sock);
+		if (SSL_accept(conn->ssl) != 1) { // eg a tcp connect probe
+			SSL_free(conn->ssl);
+			conn->ssl = NULL;
+			close(conn->sock);
+			free(conn);
+			return NULL;
+		}
+	}
+	while (receiveRequest(conn) && respond(conn))
+		;
+	if (conn->ssl) {
+		SSL_shutdown(conn->ssl);
+		SSL_free(conn->ssl);
+	}
+	close(conn->sock);
+	free(conn);
+	return NULL;
+}
+
+static void *acceptThread(void *arg) {
+	int sock;
+	pthread_t thread;
+
+	while ((sock = accept(listenSock, NULL, NULL)) >= 0) {
+		connection_t *conn = (connection_t *)calloc(1, sizeof(connection_t));
+		conn->sock = sock;
+		pthread_create(&thread, NULL, connectionThread, conn);
+		pthread_detach(thread);
+	}
+	return NULL;
+}
+
+// a self-signed certificate for 127.0.0.1
+static SSL_CTX *serverContext(void) {
+	SSL_CTX *ctx = SSL_CTX_new(TLS_server_method());
+	EVP_PKEY *key = EVP_EC_gen("P-256");
+	X509 *cert = X509_new();
+
+	X509_set_version(cert, 2);
+	ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+	X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+	X509_gmtime_adj(X509_getm_notAfter(cert), 24 * 3600);
+	X509_set_pubkey(cert, key);
+	X509_NAME *name = X509_get_subject_name(cert);
+	X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, (const unsigned char *)"127.0.0.1", -1, -1, 0);
+	X509_set_issuer_name(cert, name);
+	X509_sign(cert, key, EVP_sha256());
+	bool ok = (SSL_CTX_use_certificate(ctx, cert) == 1) && (SSL_CTX_use_PrivateKey(ctx, key) == 1);
+	X509_free(cert);
+	EVP_PKEY_free(key);
+	if (!ok) {
+		SSL_CTX_free(ctx);
+		return NULL;
+	}
+	return ctx;
+}
+
+int testServerStart(const char *folder, bool tls) {
+	struct sockaddr_in addr = {};
+	socklen_t len = sizeof(addr);
+	pthread_t thread;
+	int on = 1;
+
+	signal(SIGPIPE, SIG_IGN);
+	strncpy(root, folder, sizeof(root) - 1);
+	memset(requestLog, 0, sizeof(requestLog));
+	ctx = tls ? serverContext() : NULL;
+	if (tls && (ctx == NULL))
+		return 0;
+	listenSock = socket(AF_INET, SOCK_STREAM, 0);
+	setsockopt(listenSock, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if ((bind(listenSock, (struct sockaddr *)&addr, sizeof(addr)) != 0) || (listen(listenSock, 8) != 0) ||
+		(getsockname(listenSock, (struct sockaddr *)&addr, &len) != 0)) {
+		close(listenSock);
+		return 0;
+	}
+	pthread_create(&thread, NULL, acceptThread, NULL);
+	pthread_detach(thread);
+	return ntohs(addr.sin_port);
+}
+
+// no new connections, open ones end with their client
+void testServerStop(void) {
+	shutdown(listenSock, SHUT_RDWR);
+	close(listenSock);
+	listenSock = -1;
+}
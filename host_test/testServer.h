@@ -0,0 +1,20 @@
+/*
+ * testServer.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: dig
+ *
+ *  local http / https server for the host tests, serves the files of a folder with Range (206) and keep-alive
+ *  https uses a self-signed certificate made at start
+ */
+
+#ifndef HOST_TEST_TESTSERVER_H_
+#define HOST_TEST_TESTSERVER_H_
+
+// returns the port on 127.0.0.1, 0 on error
+int testServerStart(const char *folder, bool tls);
+// requests for path (eg "/firmware.bin") since testServerStart
+int testServerRequests(const char *path);
+void testServerStop(void);
+
+#endif /* HOST_TEST_TESTSERVER_H_ */
@@ -0,0 +1,211 @@
+/*
+ * testThroughput.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: dig
+ *
+ *  streams a local image into the sha256 and the sector writer of a partition in RAM and reports MB/s
+ *  serial: one task reads, erases and writes (httpsReaderSink into the chain)
+ *  overlapped: as downloadImage, the chain in the writeBehind task and the erase ahead task
+ *  with the link and the flash slowed down the overlapped download must take clearly less time than the serial one
+ *
+ *  usage: testThroughput [image], without image a 1.5 MB image is made from firmware.bin
+ */
+
+#include <string.h>
+
+#include "eraseAhead.h"
+#include "esp_timer.h"
+#include "fakeHttpClient.h"
+#include "httpsReadFile.h"
+#include "mbedtls/sha256.h"
+#include "sectorWriter.h"
+#include "test.h"
+#include "writeBehind.h"
+
+#define PARTITION_SIZE (2 * 1024 * 1024)
+#define IMAGE_SIZE (1536 * 1024)
+#define RUNS 5
+
+// a slow link and flash, the ESP32 takes about 1 ms to erase or write a sector
+#define LINK_US 1000  // per block read
+#define ERASE_US 1000 // per sector
+#define WRITE_US 1000 // per sector
+#define SLOW_SIZE (512 * 1024)
+#define MAX_RATIO 0.8 // overlapped / serial
+
+typedef struct {
+	mbedtls_sha256_context sha;
+	sectorWriter_t writer;
+	eraseAhead_t erase;
+	int64_t bytes;
+} chain_t;
+
+// httpsSink_t, the write chain of a plain image: verify and sector writer
+static esp_err_t chainWrite(void *ctx, const uint8_t *data, int len) {
+	chain_t *chain = (chain_t *)ctx;
+
+	mbedtls_sha256_update(&chain->sha, data, len);
+	chain->bytes += len;
+	return sectorWriterWrite(&chain->writer, data, len);
+}
+
+// firmware.bin, changed a little in each copy so no sector repeats
+static bool makeImage(const char *path) {
+	int len;
+	uint8_t *firmware = readVector("firmware.bin", &len);
+	FILE *f = fopen(path, "wb");
+
+	if ((firmware == NULL) || (f == NULL))
+		return false;
+	for (int n = 0; n < IMAGE_SIZE; n += len) {
+		firmware[n % len] ^= 0x55;
+		fwrite(firmware, 1, (IMAGE_SIZE - n > len) ? len : IMAGE_SIZE - n, f);
+	}
+	fclose(f);
+	free(firmware);
+	return true;
+}
+
+static uint8_t *readFile(const char *path, int *len) {
+	FILE *f = fopen(path, "rb");
+	if (f == NULL)
+		return NULL;
+	fseek(f, 0, SEEK_END);
+	*len = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	uint8_t *data = (uint8_t *)malloc(*len);
+	*len = fread(data, 1, *len, f);
+	fclose(f);
+	return data;
+}
+
+// one download into partition, returns the time in us, < 0 on error
+// serial: read and write in this task, the sector writer compares and erases itself
+static int64_t download(char *url, int rangeStart, esp_partition_t *partition, chain_t *chain, bool serial) {
+	static uint8_t buf[CONFIG_HTTPS_READ_BUFSIZE];
+	httpsReader_t reader;
+	writeBehind_t behind;
+
+	memset(chain, 0, sizeof(chain_t));
+	mbedtls_sha256_init(&chain->sha);
+	mbedtls_sha256_starts(&chain->sha, 0);
+	int64_t start = esp_timer_get_time();
+	esp_err_t err = ESP_OK;
+	if (!serial)
+		err = eraseAheadBegin(&chain->erase, partition, rangeStart);
+	if (err == ESP_OK)
+		err = sectorWriterBegin(&chain->writer, partition, rangeStart, serial ? NULL : &chain->erase);
+	if (err == ESP_OK)
+		err = httpsReaderOpen(&reader, url, rangeStart);
+	if (serial && (err == ESP_OK))
+		err = httpsReaderSink(&reader, buf, sizeof(buf), chainWrite, chain);
+	if (!serial && (err == ESP_OK)) { // the loop of downloadImage
+		err = writeBehindBegin(&behind, chainWrite, chain);
+		while (err == ESP_OK) {
+			uint8_t *block = writeBehindGet(&behind);
+			if (!block)
+				break;
+			int len = httpsReaderRead(&reader, block, CONFIG_HTTPS_READ_BUFSIZE);
+			if (len <= 0) {
+				writeBehindPut(&behind, block, 0);
+				if (len < 0)
+					err = ESP_FAIL;
+				break;
+			}
+			writeBehindPut(&behind, block, len);
+		}
+		esp_err_t writeErr = writeBehindEnd(&behind);
+		if (err == ESP_OK)
+			err = writeErr;
+	}
+	if (err == ESP_OK)
+		err = sectorWriterEnd(&chain->writer);
+	else
+		sectorWriterAbort(&chain->writer);
+	httpsReaderClose(&reader);
+	if (!serial)
+		eraseAheadEnd(&chain->erase);
+	int64_t us = esp_timer_get_time() - start;
+	CHECK_ERR(ESP_OK, err);
+	CHECK(reader.complete);
+	return (err == ESP_OK) ? us : -1;
+}
+
+static void report(const char *what, int64_t bytes, int64_t us) {
+	printf("%-22s %8lld bytes %8.1f ms %8.1f MB/s\n", what, (long long)bytes, us / 1000.0, (us > 0) ? (double)bytes / us : 0.0);
+}
+
+int main(int argc, char *argv[]) {
+	const char *path = (argc > 1) ? argv[1] : "throughput.bin";
+	char url[SERVER_URL_MAX_SZ];
+	uint8_t hash[32], expected[32];
+	chain_t chain;
+	int len;
+
+	if ((argc == 1) && !makeImage(path))
+		return 1;
+	uint8_t *image = readFile(path, &len);
+	if ((image == NULL) || (len > PARTITION_SIZE))
+		return 1;
+	mbedtls_sha256(image, len, expected, 0);
+	snprintf(url, sizeof(url), "file://%s", path);
+	esp_partition_t *partition = fakePartition("ota_1", PARTITION_SIZE);
+	int sectors = (len + SPI_FLASH_SEC_SIZE - 1) / SPI_FLASH_SEC_SIZE;
+	printf("%s: %d bytes in blocks of %d\n", path, len, CONFIG_HTTPS_READ_BUFSIZE);
+
+	// erased partition: every sector written
+	for (int serial = 1; serial >= 0; serial--) {
+		memset(fakePartitionData(partition), 0xFF, PARTITION_SIZE);
+		int64_t us = download(url, 0, partition, &chain, serial);
+		mbedtls_sha256_finish(&chain.sha, hash);
+		CHECK(chain.bytes == len);
+		CHECK(memcmp(hash, expected, sizeof(hash)) == 0);
+		CHECK(memcmp(fakePartitionData(partition), image, len) == 0);
+		CHECK(chain.writer.written == sectors);
+		report(serial ? "write serial" : "write overlapped", chain.bytes, us);
+	}
+
+	// same image again: every sector compared and left, as the storage image
+	int64_t best = -1;
+	for (int run = 0; run < RUNS; run++) {
+		int64_t us = download(url, 0, partition, &chain, true);
+		if ((us >= 0) && ((best < 0) || (us < best)))
+			best = us;
+	}
+	CHECK(chain.writer.skipped == sectors);
+	CHECK(chain.writer.written == 0);
+	report("unchanged", chain.bytes, best);
+
+	// resumed after half the image
+	int rangeStart = (sectors / 2) * SPI_FLASH_SEC_SIZE;
+	memset(fakePartitionData(partition) + rangeStart, 0xFF, PARTITION_SIZE - rangeStart);
+	int64_t us = download(url, rangeStart, partition, &chain, false);
+	CHECK(chain.bytes == len - rangeStart);
+	CHECK(memcmp(fakePartitionData(partition), image, len) == 0);
+	report("resumed overlapped", chain.bytes, us);
+
+	// slow link and flash: the overlapped download waits for the slower of the two, the serial one for both
+	int slowLen = (len < SLOW_SIZE) ? len : SLOW_SIZE;
+	FILE *f = fopen("throughput_slow.bin", "wb");
+	fwrite(image, 1, slowLen, f);
+	fclose(f);
+	snprintf(url, sizeof(url), "file://throughput_slow.bin");
+	fakeHttpClientDelay(LINK_US);
+	fakePartitionDelay(partition, ERASE_US, WRITE_US);
+	int64_t slow[2];
+	for (int serial = 1; serial >= 0; serial--) {
+		memset(fakePartitionData(partition), 0xFF, PARTITION_SIZE);
+		slow[serial] = download(url, 0, partition, &chain, serial);
+		CHECK(chain.bytes == slowLen);
+		CHECK(memcmp(fakePartitionData(partition), image, slowLen) == 0);
+		report(serial ? "slow serial" : "slow overlapped", chain.bytes, slow[serial]);
+	}
+	printf("overlapped / serial %.2f\n", (double)slow[0] / slow[1]);
+	CHECK(slow[0] < slow[1] * MAX_RATIO);
+	fakeHttpClientDelay(0);
+
+	fakePartitionFree(partition);
+	free(image);
+	return testFailures;
+}
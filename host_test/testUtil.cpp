@@ -0,0 +1,147 @@
+/*
+ * testUtil.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: dig
+ */
+
+#include <string.h>
+#include <unistd.h>
+
+#include "test.h"
+
+int testFailures;
+
+const char *esp_err_to_name(esp_err_t code) {
+	switch (code) {
+	case ESP_OK:
+		return "ESP_OK";
+	case ESP_FAIL:
+		return "ESP_FAIL";
+	case ESP_ERR_NO_MEM:
+		return "ESP_ERR_NO_MEM";
+	case ESP_ERR_INVALID_SIZE:
+		return "ESP_ERR_INVALID_SIZE";
+	case ESP_ERR_INVALID_RESPONSE:
+		return "ESP_ERR_INVALID_RESPONSE";
+	case ESP_ERR_INVALID_CRC:
+		return "ESP_ERR_INVALID_CRC";
+	case ESP_ERR_INVALID_VERSION:
+		return "ESP_ERR_INVALID_VERSION";
+	default:
+		return "ERROR";
+	}
+}
+
+// a file of host_test/vectors, NULL if missing
+uint8_t *readVector(const char *name, int *len) {
+	char path[256];
+
+	snprintf(path, sizeof(path), "%s/%s", VECTOR_DIR, name);
+	FILE *f = fopen(path, "rb");
+	if (f == NULL) {
+		printf("Vector %s missing\n", path);
+		return NULL;
+	}
+	fseek(f, 0, SEEK_END);
+	*len = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	uint8_t *data = (uint8_t *)malloc(*len > 0 ? *len : 1);
+	if (fread(data, 1, *len, f) != (size_t)*len) {
+		free(data);
+		data = NULL;
+	}
+	fclose(f);
+	return data;
+}
+
+// updateWriteFunc_t, ctx is the testBuf_t
+esp_err_t testBufWrite(void *ctx, const uint8_t *data, int len) {
+	testBuf_t *buf = (testBuf_t *)ctx;
+
+	if (buf->len + len > buf->size) {
+		buf->size = (buf->len + len) * 2;
+		buf->data = (uint8_t *)realloc(buf->data, buf->size);
+	}
+	memcpy(buf->data + buf->len, data, len);
+	buf->len += len;
+	return ESP_OK;
+}
+
+void testBufFree(testBuf_t *buf) {
+	free(buf->data);
+	memset(buf, 0, sizeof(testBuf_t));
+}
+
+// passes data to write in blocks of chunk bytes, as they come from the download
+esp_err_t testFeed(updateWriteFunc_t write, void *ctx, const uint8_t *data, int len, int chunk) {
+	esp_err_t err = ESP_OK;
+
+	for (int n = 0; (n < len) && (err == ESP_OK); n += chunk)
+		err = write(ctx, data + n, (len - n > chunk) ? chunk : len - n);
+	return err;
+}
+
+typedef struct {
+	esp_partition_t partition;
+	uint8_t *data;
+	int eraseUs; // per sector
+	int writeUs; // per sector written
+} fakePartition_t;
+
+esp_partition_t *fakePartition(const char *label, uint32_t size) {
+	fakePartition_t *fake = (fakePartition_t *)calloc(1, sizeof(fakePartition_t));
+
+	strncpy(fake->partition.label, label, sizeof(fake->partition.label) - 1);
+	fake->partition.size = size;
+	fake->data = (uint8_t *)malloc(size);
+	memset(fake->data, 0xFF, size);
+	return &fake->partition;
+}
+
+// as if flashed
+void fakePartitionLoad(esp_partition_t *partition, const uint8_t *data, int len) {
+	memcpy(fakePartitionData(partition), data, len);
+}
+
+// slows erase and write down to the speed of a flash chip
+void fakePartitionDelay(esp_partition_t *partition, int eraseUs, int writeUs) {
+	((fakePartition_t *)partition)->eraseUs = eraseUs;
+	((fakePartition_t *)partition)->writeUs = writeUs;
+}
+
+uint8_t *fakePartitionData(const esp_partition_t *partition) {
+	return ((fakePartition_t *)partition)->data;
+}
+
+void fakePartitionFree(esp_partition_t *partition) {
+	free(fakePartitionData(partition));
+	free(partition);
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t src_offset, void *dst, size_t size) {
+	if (src_offset + size > partition->size)
+		return ESP_ERR_INVALID_SIZE;
+	memcpy(dst, fakePartitionData(partition) + src_offset, size);
+	return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t dst_offset, const void *src, size_t size) {
+	if (dst_offset + size > partition->size)
+		return ESP_ERR_INVALID_SIZE;
+	uint8_t *data = fakePartitionData(partition) + dst_offset;
+	for (size_t n = 0; n < size; n++)
+		data[n] &= ((const uint8_t *)src)[n];
+	if (((fakePartition_t *)partition)->writeUs)
+		usleep((int64_t)((fakePartition_t *)partition)->writeUs * size / SPI_FLASH_SEC_SIZE);
+	return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset, size_t size) {
+	if ((offset % SPI_FLASH_SEC_SIZE) || (size % SPI_FLASH_SEC_SIZE) || (offset + size > partition->size))
+		return ESP_ERR_INVALID_ARG;
+	memset(fakePartitionData(partition) + offset, 0xFF, size);
+	if (((fakePartition_t *)partition)->eraseUs)
+		usleep(((fakePartition_t *)partition)->eraseUs * (size / SPI_FLASH_SEC_SIZE));
+	return ESP_OK;
+}
@@ -0,0 +1,80 @@
+#!/usr/bin/env python3
+# makes the test vectors of host_test with the scripts used for the server folder
+# the images are generated from a fixed seed, running it again gives the same files
+#
+# usage: python host_test/vectors/makeVectors.py
+
+import os
+import random
+import subprocess
+import sys
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+ROOT = os.path.join(HERE, '..', '..')
+
+
+def script(name: str, *args: str) -> None:
+    subprocess.run([sys.executable, os.path.join(ROOT, name)] + list(args), cwd=HERE, check=True, stdout=subprocess.DEVNULL)
+
+
+def write(name: str, data: bytes) -> None:
+    with open(os.path.join(HERE, name), 'wb') as f:
+        f.write(data)
+
+
+def read(name: str) -> bytes:
+    with open(os.path.join(HERE, name), 'rb') as f:
+        return f.read()
+
+
+def firmware(rnd: random.Random, size: int) -> bytearray:
+    # code like: random blocks with repeated strings and tables in between
+    words = [b'httpsReadFile', b'updateTask', b'esp_partition_write', b'\x00\x00\x00\x00', b'\xff' * 12]
+    data = bytearray()
+    while len(data) < size:
+        if rnd.random() < 0.5:
+            data += bytes(rnd.getrandbits(8) for _ in range(rnd.randrange(8, 64)))
+        else:
+            data += rnd.choice(words) * rnd.randrange(1, 4)
+    return data[:size]
+
+
+def main() -> None:
+    rnd = random.Random(20261017)
+    old = firmware(rnd, 45000)
+    new = bytearray(old)
+    for _ in range(20):  # changed bytes
+        pos = rnd.randrange(len(new))
+        new[pos] ^= 0x5A
+    new[10000:10000] = firmware(rnd, 1500)  # inserted code
+    del new[30000:30800]
+    storage = b''.join(b'<p>page %d of the web pages</p>\n' % n for n in range(700))
+
+    write('firmware_1.0.bin', old)
+    write('firmware.bin', new)
+    write('storage.bin', storage)
+    script('makeDelta.py', 'firmware_1.0.bin', 'firmware.bin', 'delta_1.0_1.1.bin')
+    script('compressImage.py', 'firmware.bin', 'firmware.bin.hs')
+    script('makeManifest.py', '--tree', '1.1', 'firmware.bin', '1.1', 'storage.bin', '.')
+
+    # truncated and corrupt versions
+    delta = read('delta_1.0_1.1.bin')
+    write('delta_1.0_1.1.bin.short', delta[:len(delta) // 2])
+    corrupt = bytearray(delta)
+    corrupt[4 + 1 + 3 + 3 + 32] = 7  # first op after the header (two 3 byte varints), not a valid op
+    write('delta_1.0_1.1.bin.corrupt', corrupt)
+    hs = read('firmware.bin.hs')
+    write('firmware.bin.hs.short', hs[:len(hs) // 2])
+    tree = read('storage.bin.tree')
+    write('short.bin.tree', tree[:len(tree) - 32])
+    write('corrupt.bin.tree', tree[:40] + bytes([tree[40] ^ 1]) + tree[41:])
+
+    # a server without manifest
+    write('noManifest/firmWareVersion.txt', b'1.1')
+    write('noManifest/storageVersion.txt', b'1.2')
+    # a manifest with invalid hex
+    write('bad/manifest.txt', b'firmware.version=1.1\nfirmware.sha256=12345\nstorage.version=1.2\nstorage.tree=zz\n')
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,37 @@
+/*
+ * storageIndex.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: dig
+ *
+ *  the files on /spiffs in RAM: a request finds size, time, type and the precompressed versions of a file
+ *  with one hash lookup instead of stat() calls that scan the SPIFFS lookup pages
+ *  built when the partition is mounted, whatever writes or deletes a file on /spiffs updates it,
+ *  this also drops the file from the asset cache
+ */
+
+#ifndef MAIN_INCLUDE_STORAGEINDEX_H_
+#define MAIN_INCLUDE_STORAGEINDEX_H_
+
+#include <stdint.h>
+#include <time.h>
+#include "esp_err.h"
+
+#define STORAGE_ENC_BR 0x01 // <file>.br exists
+#define STORAGE_ENC_GZ 0x02 // <file>.gz exists
+
+typedef struct {
+	uint32_t size;
+	time_t mtime;
+	const char *contentType;
+	uint8_t encodings; // STORAGE_ENC_xx
+} storageFileInfo_t;
+
+esp_err_t storageIndexBuild(void);
+bool storageIndexFind(const char *path, storageFileInfo_t *info);
+void storageIndexUpdate(const char *path);
+void storageIndexRemove(const char *path);
+int storageIndexPaths(char *buf, int size);
+const char *storageContentType(const char *filename);
+
+#endif /* MAIN_INCLUDE_STORAGEINDEX_H_ */
@@ -0,0 +1,32 @@
+/*
+ * storagePartition.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: dig
+ *
+ *  the SPIFFS partition mounted at /spiffs
+ *  with a second storage partition (STORAGE_LABEL_B, see partitionsOTA_4M_AB.csv) an update is written to the one not mounted,
+ *  after it is verified that one is selected in nvs and mounted instead, the file server keeps serving the old one meanwhile
+ *  requests of the file server share the storage (storageShare), a switch or a replaced file locks it alone (storageLock)
+ */
+
+#ifndef MAIN_INCLUDE_STORAGEPARTITION_H_
+#define MAIN_INCLUDE_STORAGEPARTITION_H_
+
+#include "esp_err.h"
+#include "esp_partition.h"
+
+#define STORAGE_BASE_PATH "/spiffs"
+#define STORAGE_LABEL "storage"
+#define STORAGE_LABEL_B "storage_b"
+
+esp_err_t init_spiffs(void);
+const esp_partition_t *storageMounted(void);
+const esp_partition_t *storageInactive(void);
+esp_err_t storageSwitch(const esp_partition_t *partition);
+void storageLock(void);
+void storageUnlock(void);
+void storageShare(void);
+void storageUnshare(void);
+
+#endif /* MAIN_INCLUDE_STORAGEPARTITION_H_ */
@@ -21,11 +21,13 @@
 #include "driver/gpio.h"
 #include "wifiConnect.h"
 #include "settings.h"
+#include "storagePartition.h"
+#include "caStore.h"
+#include "dnsCache.h"
 #include "updateTask.h"
 #include "clockTask.h"
 #include <esp_err.h>
 
-esp_err_t init_spiffs(void);
 TaskHandle_t connectTaskh;
 
 #define BLINK_GPIO	GPIO_NUM_4
@@ -55,13 +57,15 @@ extern "C" void app_main(void) {
 
 	ESP_LOGI(TAG, "OTA template started\n\n");
 
-	ESP_ERROR_CHECK(init_spiffs());
 	err = nvs_flash_init();
 	if (err == ESP_ERR_NVS_NO_FREE_PAGES || err == ESP_ERR_NVS_NEW_VERSION_FOUND) {
 		ESP_ERROR_CHECK(nvs_flash_erase());
 		ESP_ERROR_CHECK(nvs_flash_init());
 	}
+	ESP_ERROR_CHECK(init_spiffs()); // after nvs, it holds the storage partition to mount
 	ESP_ERROR_CHECK(esp_event_loop_create_default());
+	caStoreInit(); // parsed once for all https requests
+	dnsCacheInit();
 
 	loadSettings();
 
@@ -1,20 +1,68 @@
 
 /* Function to initialize SPIFFS */
 
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 #include "esp_spiffs.h"
 #include "esp_log.h"
+#include "nvs.h"
+
+#include "storageIndex.h"
+#include "storagePartition.h"
 
 #define TAG "spiffs:"
 
-esp_err_t init_spiffs(void)
-{
-	ESP_LOGI(TAG, "Initializing SPIFFS");
+#define SELECTOR_NAMESPACE "storage"
+#define SELECTOR_KEY "active" // 1: STORAGE_LABEL_B mounted
+#define STORAGE_SHARES 8 // requests using files at the same time, storageLock takes them all
+
+static const esp_partition_t *mounted;
+static SemaphoreHandle_t mountLock;
+static SemaphoreHandle_t shares;
+
+static const esp_partition_t *findStorage(const char *label) {
+	return esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_SPIFFS, label);
+}
+
+static const esp_partition_t *selectedStorage(void) {
+	const esp_partition_t *partitionB = findStorage(STORAGE_LABEL_B);
+	nvs_handle_t handle;
+	uint8_t active = 0;
+
+	if (partitionB && (nvs_open(SELECTOR_NAMESPACE, NVS_READONLY, &handle) == ESP_OK)) {
+		nvs_get_u8(handle, SELECTOR_KEY, &active);
+		nvs_close(handle);
+	}
+	if (partitionB && (active == 1))
+		return partitionB;
+	const esp_partition_t *partition = findStorage(STORAGE_LABEL);
+	return partition ? partition : findStorage(NULL);
+}
+
+static esp_err_t saveSelector(const esp_partition_t *partition) {
+	nvs_handle_t handle;
+	esp_err_t err = nvs_open(SELECTOR_NAMESPACE, NVS_READWRITE, &handle);
+
+	if (err == ESP_OK) {
+		err = nvs_set_u8(handle, SELECTOR_KEY, (strcmp(partition->label, STORAGE_LABEL_B) == 0) ? 1 : 0);
+		if (err == ESP_OK)
+			err = nvs_commit(handle);
+		nvs_close(handle);
+	}
+	if (err != ESP_OK)
+		ESP_LOGE(TAG, "Saving storage selector failed (%s)", esp_err_to_name(err));
+	return err;
+}
 
+// format: an empty file system when the partition holds none
+static esp_err_t mount(const esp_partition_t *partition, bool format) {
 	esp_vfs_spiffs_conf_t conf = {
-			.base_path = "/spiffs",
-			.partition_label = NULL,
+			.base_path = STORAGE_BASE_PATH,
+			.partition_label = partition->label,
 			.max_files = 25,   // This decides the maximum number of files that can be created on the storage
-			.format_if_mount_failed = true
+			.format_if_mount_failed = format
 	};
 
 	esp_err_t ret = esp_vfs_spiffs_register(&conf);
@@ -30,12 +78,93 @@ esp_err_t init_spiffs(void)
 	}
 
 	size_t total = 0, used = 0;
-	ret = esp_spiffs_info(NULL, &total, &used);
+	ret = esp_spiffs_info(partition->label, &total, &used);
 	if (ret != ESP_OK) {
 		ESP_LOGE(TAG, "Failed to get SPIFFS partition information (%s)", esp_err_to_name(ret));
+		esp_vfs_spiffs_unregister(partition->label);
 		return ESP_FAIL;
 	}
 
-	ESP_LOGI(TAG, "Partition size: total: %d, used: %d", total, used);
+	ESP_LOGI(TAG, "Partition %s size: total: %d, used: %d", partition->label, total, used);
+	storageIndexBuild();
 	return ESP_OK;
 }
+
+// nvs must be initialized, it holds the partition to mount
+esp_err_t init_spiffs(void)
+{
+	ESP_LOGI(TAG, "Initializing SPIFFS");
+
+	mountLock = xSemaphoreCreateMutex();
+	shares = xSemaphoreCreateCounting(STORAGE_SHARES, STORAGE_SHARES);
+	mounted = selectedStorage();
+	if (mounted == NULL) {
+		ESP_LOGE(TAG, "Failed to find SPIFFS partition");
+		return ESP_FAIL;
+	}
+	return mount(mounted, true);
+}
+
+const esp_partition_t *storageMounted(void) {
+	return mounted;
+}
+
+// the partition to write an update to, NULL: there is only one, the mounted one
+const esp_partition_t *storageInactive(void) {
+	const esp_partition_t *partitionA = findStorage(STORAGE_LABEL);
+	const esp_partition_t *partitionB = findStorage(STORAGE_LABEL_B);
+
+	if (!partitionA || !partitionB)
+		return NULL;
+	return (mounted == partitionA) ? partitionB : partitionA;
+}
+
+// mounts the verified partition instead of the current one, waits until no file is in use
+// it stays mounted only when it mounts and is selected for the next boot, else the current one is mounted again
+esp_err_t storageSwitch(const esp_partition_t *partition) {
+	esp_err_t err;
+
+	storageLock();
+	esp_vfs_spiffs_unregister(mounted->label);
+	err = mount(partition, false); // a bad image is not replaced by an empty one
+	if (err == ESP_OK) {
+		err = saveSelector(partition);
+		if (err != ESP_OK)
+			esp_vfs_spiffs_unregister(partition->label);
+	}
+	if (err == ESP_OK) {
+		ESP_LOGI(TAG, "Switched to %s", partition->label);
+		mounted = partition;
+	} else
+		mount(mounted, false);
+	storageUnlock();
+	return err;
+}
+
+// held alone, to switch the partition or replace a file, waits until no file is in use
+void storageLock(void) {
+	if (mountLock) {
+		xSemaphoreTake(mountLock, portMAX_DELAY);
+		for (int n = 0; n < STORAGE_SHARES; n++)
+			xSemaphoreTake(shares, portMAX_DELAY);
+	}
+}
+
+void storageUnlock(void) {
+	if (mountLock) {
+		for (int n = 0; n < STORAGE_SHARES; n++)
+			xSemaphoreGive(shares);
+		xSemaphoreGive(mountLock);
+	}
+}
+
+// held while files are used, together with other users, so the partition is not switched under them
+void storageShare(void) {
+	if (shares)
+		xSemaphoreTake(shares, portMAX_DELAY);
+}
+
+void storageUnshare(void) {
+	if (shares)
+		xSemaphoreGive(shares);
+}
@@ -0,0 +1,236 @@
+/*
+ * storageIndex.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: dig
+ */
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+
+#include "assetCache.h"
+#include "storageIndex.h"
+#include "storagePartition.h"
+
+static const char *TAG = "storageIndex";
+
+#define INDEX_BUCKETS 32
+#define PATH_SZ 64
+
+typedef struct indexEntry {
+	struct indexEntry *next;
+	storageFileInfo_t info;
+	char *path; // full path, stored behind the entry
+} indexEntry_t;
+
+// precompressed versions, bit n: STORAGE_ENC_BR, STORAGE_ENC_GZ
+static const char *const encodingExt[] = { ".br", ".gz" };
+
+static indexEntry_t *buckets[INDEX_BUCKETS];
+static SemaphoreHandle_t indexLock;
+static int nrEntries;
+
+static uint32_t hash(const char *path) {
+	uint32_t h = 2166136261; // fnv-1a
+	while (*path)
+		h = (h ^ (uint8_t)*path++) * 16777619;
+	return h % INDEX_BUCKETS;
+}
+
+// indexLock must be held for these
+static indexEntry_t *find(const char *path) {
+	for (indexEntry_t *entry = buckets[hash(path)]; entry; entry = entry->next) {
+		if (strcmp(entry->path, path) == 0)
+			return entry;
+	}
+	return NULL;
+}
+
+static uint8_t encodingsOf(const char *path) {
+	char variant[PATH_SZ];
+	uint8_t encodings = 0;
+
+	for (int n = 0; n < sizeof(encodingExt) / sizeof(encodingExt[0]); n++) {
+		snprintf(variant, sizeof(variant), "%s%s", path, encodingExt[n]);
+		if (find(variant))
+			encodings |= 1 << n;
+	}
+	return encodings;
+}
+
+// after path came or went: the encodings of the file it is a version of
+static void updateBase(const char *path) {
+	char base[PATH_SZ];
+	size_t len = strlen(path);
+
+	for (int n = 0; n < sizeof(encodingExt) / sizeof(encodingExt[0]); n++) {
+		size_t extLen = strlen(encodingExt[n]);
+		if ((len > extLen) && (len - extLen < sizeof(base)) && (strcmp(path + len - extLen, encodingExt[n]) == 0)) {
+			memcpy(base, path, len - extLen);
+			base[len - extLen] = 0;
+			indexEntry_t *entry = find(base);
+			if (entry)
+				entry->info.encodings = encodingsOf(base);
+		}
+	}
+}
+
+static void add(const char *path, const struct stat *file_stat) {
+	indexEntry_t *entry = find(path);
+
+	if (!entry) {
+		size_t len = strlen(path);
+		entry = (indexEntry_t *)malloc(sizeof(indexEntry_t) + len + 1);
+		if (!entry) {
+			ESP_LOGE(TAG, "No memory for %s", path);
+			return;
+		}
+		entry->path = (char *)(entry + 1);
+		memcpy(entry->path, path, len + 1);
+		uint32_t h = hash(path);
+		entry->next = buckets[h];
+		buckets[h] = entry;
+		nrEntries++;
+	}
+	assetCacheInvalidate(path);
+	entry->info.size = file_stat->st_size;
+	entry->info.mtime = file_stat->st_mtime;
+	entry->info.contentType = storageContentType(path);
+	entry->info.encodings = encodingsOf(path);
+	updateBase(path);
+}
+
+static void clear(void) {
+	for (int n = 0; n < INDEX_BUCKETS; n++) {
+		while (buckets[n]) {
+			indexEntry_t *entry = buckets[n];
+			buckets[n] = entry->next;
+			free(entry);
+		}
+	}
+	nrEntries = 0;
+}
+
+// reads all files of the mounted partition, a stat per file once
+esp_err_t storageIndexBuild(void) {
+	char path[PATH_SZ];
+	struct stat file_stat;
+	struct dirent *dirEntry;
+
+	if (!indexLock)
+		indexLock = xSemaphoreCreateMutex();
+	assetCacheClear();
+	xSemaphoreTake(indexLock, portMAX_DELAY);
+	clear();
+	DIR *dir = opendir(STORAGE_BASE_PATH);
+	if (dir) {
+		while ((dirEntry = readdir(dir)) != NULL) { // SPIFFS is flat, names can hold '/'
+			snprintf(path, sizeof(path), STORAGE_BASE_PATH "/%s", dirEntry->d_name);
+			if ((stat(path, &file_stat) == 0) && S_ISREG(file_stat.st_mode))
+				add(path, &file_stat);
+		}
+		closedir(dir);
+		for (int n = 0; n < INDEX_BUCKETS; n++) { // versions found before their file
+			for (indexEntry_t *entry = buckets[n]; entry; entry = entry->next)
+				entry->info.encodings = encodingsOf(entry->path);
+		}
+	}
+	xSemaphoreGive(indexLock);
+	ESP_LOGI(TAG, "%d files", nrEntries);
+	return dir ? ESP_OK : ESP_FAIL;
+}
+
+// path: full path (STORAGE_BASE_PATH/...), false if there is no such file
+bool storageIndexFind(const char *path, storageFileInfo_t *info) {
+	if (!indexLock)
+		return false;
+	xSemaphoreTake(indexLock, portMAX_DELAY);
+	indexEntry_t *entry = find(path);
+	if (entry)
+		*info = entry->info;
+	xSemaphoreGive(indexLock);
+	return entry != NULL;
+}
+
+// after path is written
+void storageIndexUpdate(const char *path) {
+	struct stat file_stat;
+
+	if (!indexLock)
+		return;
+	if (stat(path, &file_stat) != 0) {
+		storageIndexRemove(path);
+		return;
+	}
+	xSemaphoreTake(indexLock, portMAX_DELAY);
+	add(path, &file_stat);
+	xSemaphoreGive(indexLock);
+}
+
+// after path is deleted
+void storageIndexRemove(const char *path) {
+	if (!indexLock)
+		return;
+	assetCacheInvalidate(path);
+	xSemaphoreTake(indexLock, portMAX_DELAY);
+	for (indexEntry_t **link = &buckets[hash(path)]; *link; link = &(*link)->next) {
+		if (strcmp((*link)->path, path) == 0) {
+			indexEntry_t *entry = *link;
+			*link = entry->next;
+			free(entry);
+			nrEntries--;
+			updateBase(path);
+			break;
+		}
+	}
+	xSemaphoreGive(indexLock);
+}
+
+// the full paths of the files, one after the other with their 0, as many as fit in buf
+// returns the number of paths
+int storageIndexPaths(char *buf, int size) {
+	int nr = 0, len = 0;
+
+	if (!indexLock)
+		return 0;
+	xSemaphoreTake(indexLock, portMAX_DELAY);
+	for (int n = 0; n < INDEX_BUCKETS; n++) {
+		for (indexEntry_t *entry = buckets[n]; entry; entry = entry->next) {
+			int pathLen = strlen(entry->path) + 1;
+			if (len + pathLen > size)
+				continue;
+			memcpy(buf + len, entry->path, pathLen);
+			len += pathLen;
+			nr++;
+		}
+	}
+	xSemaphoreGive(indexLock);
+	return nr;
+}
+
+#define IS_FILE_EXT(filename, ext) \
+		((strlen(filename) >= sizeof(ext) - 1) && (strcasecmp(&filename[strlen(filename) - sizeof(ext) + 1], ext) == 0))
+
+// content type by file extension, a limited set, others are plain text
+const char *storageContentType(const char *filename) {
+	if (IS_FILE_EXT(filename, ".pdf"))
+		return "application/pdf";
+	if (IS_FILE_EXT(filename, ".html"))
+		return "text/html";
+	if (IS_FILE_EXT(filename, ".jpeg"))
+		return "image/jpeg";
+	if (IS_FILE_EXT(filename, ".ico"))
+		return "image/x-icon";
+	if (IS_FILE_EXT(filename, ".css"))
+		return "text/css";
+	if (IS_FILE_EXT(filename, ".js"))
+		return "text/javaScript";
+	return "text/plain";
+}
@@ -0,0 +1,137 @@
+#!/usr/bin/env python3
+# makes a delta patch to update a device running old.bin to new.bin
+# the patch format is described in components/OTA/include/deltaPatch.h
+#
+# usage: makeDelta.py old.bin new.bin delta_<oldversion>_<newversion>.bin
+# copy the patch to the server next to firmWareVersion.txt
+
+import hashlib
+import sys
+
+MAGIC = b'DOTA'
+VERSION = 1
+OP_DIFF = 1
+OP_ADD = 2
+
+KEYLEN = 16  # bytes used to find a match in the old image
+MINMATCH = 32  # shorter matches are sent as literal data
+
+
+def varint(value: int) -> bytes:
+    out = bytearray()
+    while True:
+        b = value & 0x7F
+        value >>= 7
+        if value:
+            out.append(b | 0x80)
+        else:
+            out.append(b)
+            return bytes(out)
+
+
+def index_source(src: bytes) -> dict:
+    index = {}
+    for pos in range(0, len(src) - KEYLEN + 1, 4):
+        index.setdefault(src[pos:pos + KEYLEN], pos)
+    return index
+
+
+def extend(src: bytes, spos: int, tgt: bytes, tpos: int) -> int:
+    # bsdiff style: extend while at least half of the bytes match, end on the best score
+    best_len = 0
+    best_score = 0
+    score = 0
+    n = 0
+    limit = min(len(src) - spos, len(tgt) - tpos)
+    while n < limit:
+        if src[spos + n] == tgt[tpos + n]:
+            score += 1
+            if score > best_score:
+                best_score = score
+                best_len = n + 1
+        else:
+            score -= 1
+            if score < best_score - 64:
+                break
+        n += 1
+    return best_len
+
+
+def encode_diff(src: bytes, spos: int, tgt: bytes, tpos: int, length: int) -> bytes:
+    out = bytearray([OP_DIFF])
+    out += varint(spos)
+    out += varint(length)
+    n = 0
+    while n < length:
+        equal = 0
+        while n + equal < length and src[spos + n + equal] == tgt[tpos + n + equal]:
+            equal += 1
+        out += varint(equal)
+        n += equal
+        if n == length:
+            break
+        changed = 0
+        while n + changed < length and src[spos + n + changed] != tgt[tpos + n + changed]:
+            changed += 1
+        out += varint(changed)
+        out += bytes((tgt[tpos + n + k] - src[spos + n + k]) & 0xFF for k in range(changed))
+        n += changed
+    return bytes(out)
+
+
+def encode_add(data: bytes) -> bytes:
+    return bytes([OP_ADD]) + varint(len(data)) + data
+
+
+def make_patch(src: bytes, tgt: bytes) -> bytes:
+    index = index_source(src)
+    out = bytearray(MAGIC)
+    out.append(VERSION)
+    out += varint(len(src))
+    out += varint(len(tgt))
+    out += hashlib.sha256(src).digest()
+
+    literal_start = 0
+    tpos = 0
+    offset = None  # src - tgt position of the last match, code moved by a change keeps this offset
+    while tpos < len(tgt):
+        length = 0
+        spos = None
+        if offset is not None and 0 <= tpos + offset < len(src):
+            spos = tpos + offset
+            length = extend(src, spos, tgt, tpos)
+        if length < MINMATCH:
+            cand = index.get(tgt[tpos:tpos + KEYLEN])
+            if cand is not None:
+                spos = cand
+                length = extend(src, spos, tgt, tpos)
+        if length < MINMATCH:
+            tpos += 1
+            continue
+        if literal_start < tpos:
+            out += encode_add(tgt[literal_start:tpos])
+        out += encode_diff(src, spos, tgt, tpos, length)
+        offset = spos - tpos
+        tpos += length
+        literal_start = tpos
+    if literal_start < len(tgt):
+        out += encode_add(tgt[literal_start:])
+    return bytes(out)
+
+
+def main() -> None:
+    if len(sys.argv) != 4:
+        print('usage: makeDelta.py old.bin new.bin patch.bin')
+        sys.exit(1)
+    with open(sys.argv[1], 'rb') as f:
+        src = f.read()
+    with open(sys.argv[2], 'rb') as f:
+        tgt = f.read()
+    patch = make_patch(src, tgt)
+    with open(sys.argv[3], 'wb') as f:
+        f.write(patch)
+    print('{}: {} bytes, new image {} bytes ({:.1f}%)'.format(sys.argv[3], len(patch), len(tgt), 100.0 * len(patch) / max(len(tgt), 1)))
+
+
+if __name__ == '__main__':
+    main()
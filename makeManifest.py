@@ -0,0 +1,102 @@
+#!/usr/bin/env python3
+# makes manifest.txt, the update manifest read by the device, see components/OTA/include/manifest.h
+# size and sha256 are of the image as flashed, delta patches next to the firmware are listed by their source version
+#
+# usage: makeManifest.py [--key update_key.pem] [--tree] [--files spiffs_image] firmwareversion build/ESP32_OTAtemplate.bin storageversion build/storage.bin [dir]
+#  dir: server folder contents, used to find delta_<old>_<new>.bin patches and compressed (.hs) images
+#  key: private key to sign the images with (CONFIG_OTA_SIGNED_MANIFEST), the device holds server_certs/update_key_pub.pem
+#       openssl ecparam -name prime256v1 -genkey -noout -out update_key.pem
+#       openssl ec -in update_key.pem -pubout -out server_certs/update_key_pub.pem
+#  tree: also writes <file>.tree, the sha256 of each 4 kB chunk of the image, put it on the server next to the image
+#  files: folder the storage image is made of, writes files.txt (sha256, size and path of each file) for an update per file,
+#         put it on the server next to the manifest and the folder contents in files/ (components/OTA/include/storageFiles.h)
+
+import argparse
+import hashlib
+import os
+import re
+import subprocess
+
+CHUNK_SIZE = 4096  # MERKLE_CHUNKSIZE in components/OTA/include/merkle.h
+FILES_LIST = 'files.txt'  # STORAGE_FILES_LIST in components/OTA/include/storageFiles.h
+
+
+def sign(version: str, file_name: str, digest: bytes, key: str) -> str:
+    # signature of '<version>\n<file>\n' + sha256 of the image, as checked by verifySignature on the device,
+    # so an older signed image can not be offered under a new version
+    message = '{}\n{}\n'.format(version, file_name).encode() + digest
+    sig = subprocess.run(['openssl', 'dgst', '-sha256', '-sign', key], input=message, check=True, capture_output=True).stdout
+    return sig.hex()
+
+
+def merkle_tree(data: bytes, tree_file: str) -> str:
+    # writes the leaves, returns the root: a node is sha256(left + right), an odd node moves up unchanged
+    level = [hashlib.sha256(data[i:i + CHUNK_SIZE]).digest() for i in range(0, len(data), CHUNK_SIZE)]
+    with open(tree_file, 'wb') as f:
+        f.write(b''.join(level))
+    while len(level) > 1:
+        level = [hashlib.sha256(level[i] + level[i + 1]).digest() if i + 1 < len(level) else level[i]
+                 for i in range(0, len(level), 2)]
+    return level[0].hex()
+
+
+def file_list(folder: str) -> str:
+    # writes files.txt, returns its sha256
+    lines = []
+    for root, _, names in sorted(os.walk(folder)):
+        for name in sorted(names):
+            path = os.path.join(root, name)
+            with open(path, 'rb') as f:
+                data = f.read()
+            lines.append('{} {} {}'.format(hashlib.sha256(data).hexdigest(), len(data), os.path.relpath(path, folder).replace(os.sep, '/')))
+    text = ('\n'.join(lines) + '\n').encode()
+    with open(FILES_LIST, 'wb') as f:
+        f.write(text)
+    return hashlib.sha256(text).hexdigest()
+
+
+def entry(name: str, version: str, image: str, folder: str, key: str, tree: bool) -> list:
+    with open(image, 'rb') as f:
+        data = f.read()
+    file_name = os.path.basename(image)
+    if folder and os.path.exists(os.path.join(folder, file_name + '.hs')):
+        file_name += '.hs'
+    lines = [
+        '{}.version={}'.format(name, version),
+        '{}.file={}'.format(name, file_name),
+        '{}.size={}'.format(name, len(data)),
+        '{}.sha256={}'.format(name, hashlib.sha256(data).hexdigest()),
+    ]
+    if key:
+        lines.append('{}.signature={}'.format(name, sign(version, file_name, hashlib.sha256(data).digest(), key)))
+    if tree:
+        lines.append('{}.tree={}'.format(name, merkle_tree(data, file_name + '.tree')))
+    if name == 'firmware' and folder:
+        pattern = re.compile(r'delta_(.+)_{}\.bin(\.hs)?$'.format(re.escape(version)))
+        sources = sorted({m.group(1) for m in map(pattern.match, os.listdir(folder)) if m})
+        lines.append('firmware.delta={}'.format(' '.join(sources)))
+    return lines
+
+
+def main() -> None:
+    parser = argparse.ArgumentParser(description='make the update manifest')
+    parser.add_argument('--key', help='private key to sign the images with')
+    parser.add_argument('--tree', action='store_true', help='write chunk hashes for early verification')
+    parser.add_argument('--files', help='folder of the storage image, for an update per file')
+    parser.add_argument('firmwareversion')
+    parser.add_argument('firmware')
+    parser.add_argument('storageversion')
+    parser.add_argument('storage')
+    parser.add_argument('dir', nargs='?', help='server folder with patches and compressed images')
+    args = parser.parse_args()
+    lines = entry('firmware', args.firmwareversion, args.firmware, args.dir, args.key, args.tree) + \
+        entry('storage', args.storageversion, args.storage, args.dir, args.key, args.tree)
+    if args.files:
+        lines.append('storage.files={}'.format(file_list(args.files)))
+    with open('manifest.txt', 'w') as f:
+        f.write('\n'.join(lines) + '\n')
+    print('\n'.join(lines))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,69 @@
+#!/usr/bin/env python3
+# sends a firmware image to all devices on the lan at once, see components/OTA/include/multicastOta.h
+# the image is sent as numbered blocks, after each group of blocks a repair packet (xor of the group), round after round
+# devices with CONFIG_OTA_MULTICAST that update to this image listen before they download,
+# the image must be the one in the manifest (same sha256), as flashed: not compressed
+#
+# usage: multicastImage.py [--group 239.255.0.77] [--port 5077] [--rate 100] [--rounds 3] build/ESP32_OTAtemplate.bin
+#  rate: kB/s, multicast on wifi goes out at a low basic rate, too fast only loses packets
+#  rounds: 0 sends until stopped
+
+import argparse
+import hashlib
+import socket
+import struct
+import time
+
+MAGIC = 0x4D41544F  # MCAST_MAGIC
+BLOCK_SIZE = 1024  # MCAST_BLOCKSIZE
+HEADER = struct.Struct('<I8sIIBBH')  # mcastHeader_t
+DATA = 0
+REPAIR = 1
+
+
+def packets(image: bytes, group_size: int):
+    image_id = hashlib.sha256(image).digest()[:8]
+    blocks = [image[i:i + BLOCK_SIZE] for i in range(0, len(image), BLOCK_SIZE)]
+    for group in range(0, len(blocks), group_size):
+        repair = bytearray(BLOCK_SIZE)
+        for index in range(group, min(group + group_size, len(blocks))):
+            block = blocks[index]
+            for i, b in enumerate(block):
+                repair[i] ^= b
+            yield HEADER.pack(MAGIC, image_id, len(image), index, DATA, group_size, 0) + block
+        yield HEADER.pack(MAGIC, image_id, len(image), group // group_size, REPAIR, group_size, 0) + bytes(repair)
+
+
+def main() -> None:
+    parser = argparse.ArgumentParser(description='send a firmware image to a multicast group')
+    parser.add_argument('--group', default='239.255.0.77', help='CONFIG_OTA_MULTICAST_GROUP')
+    parser.add_argument('--port', type=int, default=5077, help='CONFIG_OTA_MULTICAST_PORT')
+    parser.add_argument('--rate', type=int, default=100, help='kB/s')
+    parser.add_argument('--rounds', type=int, default=3, help='times the image is sent, 0: until stopped')
+    parser.add_argument('--group-size', type=int, default=8, help='blocks per repair packet')
+    parser.add_argument('--ttl', type=int, default=1)
+    parser.add_argument('image')
+    args = parser.parse_args()
+
+    with open(args.image, 'rb') as f:
+        image = f.read()
+    round_packets = list(packets(image, args.group_size))
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM, socket.IPPROTO_UDP)
+    sock.setsockopt(socket.IPPROTO_IP, socket.IP_MULTICAST_TTL, args.ttl)
+    interval = (HEADER.size + BLOCK_SIZE) / (args.rate * 1024)
+
+    print('{} bytes, {} packets a round to {}:{}'.format(len(image), len(round_packets), args.group, args.port))
+    nr = 0
+    while args.rounds == 0 or nr < args.rounds:
+        nr += 1
+        start = time.monotonic()
+        for n, packet in enumerate(round_packets):
+            sock.sendto(packet, (args.group, args.port))
+            delay = start + (n + 1) * interval - time.monotonic()
+            if delay > 0:
+                time.sleep(delay)
+        print('round {} sent in {:.1f} s'.format(nr, time.monotonic() - start))
+
+
+if __name__ == '__main__':
+    main()
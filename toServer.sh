@@ -1 +1 @@
-scp  firmWareVersion.txt  build/ESP32_OTAtemplate.bin storageVersion.txt  build/storage.bin root@digkleppe.nl:/home/firmware/OTA/
+scp  manifest.txt firmWareVersion.txt  build/ESP32_OTAtemplate.bin storageVersion.txt  build/storage.bin root@digkleppe.nl:/home/firmware/OTA/